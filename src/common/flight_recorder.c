@@ -0,0 +1,244 @@
+#include "flight_recorder.h"
+#include "profiler.h"
+#include "tracer.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define FLIGHT_RECORDER_PREFIX "FLIGHT"
+
+typedef struct {
+  uint32_t frame;
+  uint64_t phases[ProfilerPhase_Count];
+} FrameRecord;
+
+typedef struct {
+  uint32_t frame;
+  uint64_t start;
+  uint64_t duration;
+  const char *category;
+  const char *argName;
+  int64_t argValue;
+  char name[TRACER_NAME_SIZE];
+} EventRecord;
+
+static struct {
+  int enabled;
+  uint64_t frameBudgetNs;
+  pthread_t thread;
+  Logger *streamSink;
+
+  uint32_t frameIndex;
+  uint32_t framesSinceDump;
+
+  FrameRecord frames[FLIGHT_RECORDER_FRAMES];
+  uint32_t numFrames;
+
+  EventRecord events[FLIGHT_RECORDER_EVENTS];
+  uint32_t numEvents;
+} _recorder = {0};
+
+void FlightRecorderInit(uint32_t frameBudgetMs) {
+  memset(&_recorder, 0, sizeof(_recorder));
+  _recorder.enabled = frameBudgetMs > 0;
+  _recorder.frameBudgetNs = frameBudgetMs * 1000000ULL;
+  _recorder.thread = pthread_self();
+  _recorder.framesSinceDump = FLIGHT_RECORDER_FRAMES;
+}
+
+int FlightRecorderIsEnabled(void) { return _recorder.enabled; }
+
+void FlightRecorderSetStreamSink(Logger *sink) { _recorder.streamSink = sink; }
+
+void FlightRecorderAddEvent(const char *category, const char *name,
+                            uint64_t start, uint64_t duration,
+                            const char *argName, int64_t argValue) {
+  if (!_recorder.enabled || !pthread_equal(pthread_self(), _recorder.thread)) {
+    return;
+  }
+  EventRecord *ev =
+      _recorder.events + (_recorder.numEvents++ % FLIGHT_RECORDER_EVENTS);
+  ev->frame = _recorder.frameIndex;
+  ev->start = start;
+  ev->duration = duration;
+  ev->category = category;
+  ev->argName = argName;
+  ev->argValue = argValue;
+  strncpy(ev->name, name, TRACER_NAME_SIZE - 1);
+  ev->name[TRACER_NAME_SIZE - 1] = 0;
+}
+
+void FlightRecorderFrameEnd(void) {
+  if (!_recorder.enabled) {
+    return;
+  }
+  FrameRecord *rec =
+      _recorder.frames + (_recorder.numFrames++ % FLIGHT_RECORDER_FRAMES);
+  rec->frame = _recorder.frameIndex++;
+  for (int i = 0; i < ProfilerPhase_Count; i++) {
+    rec->phases[i] = ProfilerGetLastFrameNs(i);
+  }
+  _recorder.framesSinceDump++;
+
+  uint64_t frameNs = rec->phases[ProfilerPhase_Frame];
+  // don't dump several times the same history when a slow phase lasts
+  if (frameNs > _recorder.frameBudgetNs &&
+      _recorder.framesSinceDump >= FLIGHT_RECORDER_FRAMES) {
+    char reason[96];
+    snprintf(reason, sizeof(reason), "frame %u took %.2f ms (budget %.2f ms)",
+             rec->frame, frameNs / 1000000.,
+             _recorder.frameBudgetNs / 1000000.);
+    FlightRecorderDump(reason);
+    _recorder.framesSinceDump = 0;
+  }
+}
+
+// copy of the history written by a background thread, one dump at a time
+static struct {
+  pthread_t thread;
+  int joinable;
+  atomic_int writing;
+
+  char reason[96];
+  Logger *sink;
+  uint32_t lastFrame;
+
+  FrameRecord frames[FLIGHT_RECORDER_FRAMES];
+  uint32_t numFrames;
+
+  EventRecord events[FLIGHT_RECORDER_EVENTS];
+  uint32_t numEvents;
+} _dump = {0};
+
+static FILE *_dumpFile = NULL;
+
+static void fileLogFunc(const char *prefix, const char *fmt, va_list args) {
+  vfprintf(_dumpFile, fmt, args);
+  fprintf(_dumpFile, "\n");
+}
+
+static Logger _fileLogger = {.func = fileLogFunc};
+
+static void emit(const char *fmt, ...) PRINTFLIKE(1, 2);
+static void emit(const char *fmt, ...) {
+  va_list args;
+  if (_dumpFile) {
+    va_start(args, fmt);
+    _fileLogger.func(FLIGHT_RECORDER_PREFIX, fmt, args);
+    va_end(args);
+  }
+  if (_dump.sink) {
+    va_start(args, fmt);
+    _dump.sink->func(FLIGHT_RECORDER_PREFIX, fmt, args);
+    va_end(args);
+  }
+}
+
+static void *writeDump(void *arg) {
+  char path[64];
+  char date[32];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y%m%d_%H%M%S", localtime(&now));
+  snprintf(path, sizeof(path), "slowframe_%s_%u.txt", date, _dump.lastFrame);
+  _dumpFile = fopen(path, "w");
+  if (!_dumpFile) {
+    perror("FlightRecorderDump");
+  } else {
+    printf("%s, flight recorder dumped to '%s'\n", _dump.reason, path);
+  }
+
+  emit("%s", _dump.reason);
+  emit("last %u frames, times in ms:", _dump.numFrames);
+  char line[256];
+  int len = snprintf(line, sizeof(line), "%8s", "frame#");
+  for (int p = 0; p < ProfilerPhase_Count; p++) {
+    len += snprintf(line + len, sizeof(line) - len, " %9s",
+                    ProfilerPhaseName(p));
+  }
+  emit("%s", line);
+  for (uint32_t i = 0; i < _dump.numFrames; i++) {
+    const FrameRecord *rec = _dump.frames + i;
+    len = snprintf(line, sizeof(line), "%8u", rec->frame);
+    for (int p = 0; p < ProfilerPhase_Count; p++) {
+      len += snprintf(line + len, sizeof(line) - len, " %9.3f",
+                      rec->phases[p] / 1000000.);
+    }
+    emit("%s", line);
+  }
+
+  emit("events:");
+  for (uint32_t i = 0; i < _dump.numEvents; i++) {
+    const EventRecord *ev = _dump.events + i;
+    if (ev->argName) {
+      emit("%8u %-8s %-31s %9.3f %s=%lld", ev->frame, ev->category, ev->name,
+           ev->duration / 1000000., ev->argName, (long long)ev->argValue);
+    } else {
+      emit("%8u %-8s %-31s %9.3f", ev->frame, ev->category, ev->name,
+           ev->duration / 1000000.);
+    }
+  }
+
+  if (_dumpFile) {
+    fclose(_dumpFile);
+    _dumpFile = NULL;
+  }
+  atomic_store(&_dump.writing, 0);
+  return NULL;
+}
+
+void FlightRecorderDump(const char *reason) {
+  uint32_t numFrames = _recorder.numFrames < FLIGHT_RECORDER_FRAMES
+                           ? _recorder.numFrames
+                           : FLIGHT_RECORDER_FRAMES;
+  if (numFrames == 0) {
+    return;
+  }
+  if (atomic_load(&_dump.writing)) {
+    printf("%s, previous flight recorder dump still being written\n", reason);
+    return;
+  }
+  FlightRecorderStop();
+
+  // only the copy is done on the game thread
+  snprintf(_dump.reason, sizeof(_dump.reason), "%s", reason);
+  _dump.sink = _recorder.streamSink;
+  _dump.lastFrame = _recorder.frameIndex - 1;
+  for (uint32_t i = 0; i < numFrames; i++) {
+    _dump.frames[i] =
+        _recorder.frames[(_recorder.numFrames - numFrames + i) %
+                         FLIGHT_RECORDER_FRAMES];
+  }
+  _dump.numFrames = numFrames;
+
+  uint32_t numEvents = _recorder.numEvents < FLIGHT_RECORDER_EVENTS
+                           ? _recorder.numEvents
+                           : FLIGHT_RECORDER_EVENTS;
+  _dump.numEvents = 0;
+  for (uint32_t i = 0; i < numEvents; i++) {
+    const EventRecord *ev =
+        _recorder.events +
+        ((_recorder.numEvents - numEvents + i) % FLIGHT_RECORDER_EVENTS);
+    if (ev->frame >= _dump.frames[0].frame) {
+      _dump.events[_dump.numEvents++] = *ev;
+    }
+  }
+
+  atomic_store(&_dump.writing, 1);
+  if (pthread_create(&_dump.thread, NULL, writeDump, NULL) != 0) {
+    perror("FlightRecorderDump");
+    atomic_store(&_dump.writing, 0);
+    return;
+  }
+  _dump.joinable = 1;
+}
+
+void FlightRecorderStop(void) {
+  if (_dump.joinable) {
+    pthread_join(_dump.thread, NULL);
+    _dump.joinable = 0;
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "logger.h"
+#include <stdint.h>
+
+// Keeps the phase timings of the last frames and the traced events (asset
+// fetches, script runs, TIM instructions) that happened during them. When a
+// frame goes over budget, the whole history is copied and a background thread
+// writes it to a slowframe_<date>_<frame>.txt file and to the stream sink, if
+// any.
+
+#define FLIGHT_RECORDER_FRAMES 120
+#define FLIGHT_RECORDER_EVENTS 2048
+
+// frameBudgetMs = 0 disables the recorder
+void FlightRecorderInit(uint32_t frameBudgetMs);
+int FlightRecorderIsEnabled(void);
+
+// additional output for the dumps, eg. the debug server. Can be NULL, it is
+// called from the writer thread.
+void FlightRecorderSetStreamSink(Logger *sink);
+
+// only events from the thread that called FlightRecorderInit are kept
+void FlightRecorderAddEvent(const char *category, const char *name,
+                            uint64_t start, uint64_t duration,
+                            const char *argName, int64_t argValue);
+
+// to be called after ProfilerFrameEnd
+void FlightRecorderFrameEnd(void);
+
+// skipped while the previous dump is still being written
+void FlightRecorderDump(const char *reason);
+// waits for the dump being written, if any
+void FlightRecorderStop(void);
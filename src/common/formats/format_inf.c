@@ -1,5 +1,6 @@
 #include "format_inf.h"
 #include "bytes.h"
+#include "script_verifier.h"
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -11,6 +12,52 @@
 
 void INFScriptInit(INFScript *script) { memset(script, 0, sizeof(INFScript)); }
 
+void INFScriptRelease(INFScript *script) {
+  free(script->instructions);
+  script->instructions = NULL;
+  free(script->maxStackDepths);
+  script->maxStackDepths = NULL;
+}
+
+// Decodes an instruction at every word, so that a jump or a return can land on
+// any offset, as with the original step by step decoding.
+static void decodeInstructions(INFScript *script) {
+  const uint32_t numWords = script->scriptDataSize / 2;
+  script->instructions = malloc((numWords + 1) * sizeof(INFInstruction));
+  assert(script->instructions);
+  for (uint32_t i = 0; i < numWords; i++) {
+    INFInstruction *inst = script->instructions + i;
+    uint16_t code = swap_uint16(script->scriptData[i]);
+    inst->opcode = (code >> 8) & 0x1F;
+    inst->size = 1;
+    inst->param = 0;
+    if (code & 0x8000) {
+      inst->opcode = 0;
+      inst->param = code & 0x7FFF;
+    } else if (code & 0x4000) {
+      inst->param = (int8_t)(code);
+    } else if (code & 0x2000) {
+      if (i + 1 < numWords) {
+        inst->param = swap_uint16(script->scriptData[i + 1]);
+        inst->size = 2;
+      } else {
+        inst->opcode = INF_OPCODE_END; // truncated
+      }
+    }
+  }
+  script->instructions[numWords] =
+      (INFInstruction){.opcode = INF_OPCODE_END, .size = 1};
+}
+
+static uint32_t hashScriptData(const INFScript *script) {
+  const uint8_t *data = (const uint8_t *)script->scriptData;
+  uint32_t hash = 2166136261U;
+  for (uint32_t i = 0; i < script->scriptDataSize; i++) {
+    hash = (hash ^ data[i]) * 16777619U;
+  }
+  return hash;
+}
+
 int INFScriptFromBuffer(INFScript *script, uint8_t *buffer, size_t bufferSize) {
   assert(buffer);
 
@@ -78,6 +125,17 @@ int INFScriptFromBuffer(INFScript *script, uint8_t *buffer, size_t bufferSize) {
     }
     script->numTextStrings = i;
   }
+  if (script->scriptData) {
+    decodeInstructions(script);
+    script->hash = hashScriptData(script);
+    EMCVerifierResult result;
+    if (!EMCVerifierRun(script, &result)) {
+      printf("invalid script, offset 0X%04X: %s\n", result.offset,
+             result.error);
+      INFScriptRelease(script);
+      return 0;
+    }
+  }
   return 1;
 }
 
@@ -7,6 +7,17 @@ typedef struct {
   uint16_t end;
 } ScriptSegment;
 
+// opcodes 0 to 31 come from the bytecode, END marks the end of scriptData
+#define INF_NUM_OPCODES 32
+#define INF_OPCODE_END INF_NUM_OPCODES
+
+// an EMC instruction decoded at load time
+typedef struct {
+  uint16_t param;
+  uint8_t opcode;
+  uint8_t size; // in words, 1 or 2
+} INFInstruction;
+
 typedef struct {
   uint8_t *text;
   size_t textSize;
@@ -18,11 +29,18 @@ typedef struct {
 
   uint16_t *scriptData;
   uint32_t scriptDataSize;
+
+  // the instruction starting at each word of scriptData, followed by an END.
+  INFInstruction *instructions;
+  uint32_t hash; // FNV-1a of scriptData, identifies compiled scripts
+  // per function, computed by the verifier (see script_verifier.h)
+  uint16_t *maxStackDepths;
 } INFScript;
 
 void INFScriptInit(INFScript *script);
 
 int INFScriptFromBuffer(INFScript *script, uint8_t *buffer, size_t bufferSize);
+void INFScriptRelease(INFScript *script);
 
 // returns -1 if no offset exists for functionNum
 int INFScriptGetFunctionOffset(const INFScript *script, uint16_t functionNum);
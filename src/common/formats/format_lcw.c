@@ -1,4 +1,5 @@
 #include "format_lcw.h"
+#include "tracer.h"
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -7,8 +8,8 @@
 #include <string.h>
 
 // from https://github.com/OpenDUNE/OpenDUNE/blob/master/src/codec/format80.c
-ssize_t LCWDecompress(const uint8_t *source, size_t sourceSize, uint8_t *outBuf,
-                      size_t outSize) {
+static ssize_t lcwDecompress(const uint8_t *source, size_t sourceSize,
+                             uint8_t *outBuf, size_t outSize) {
   assert(source[sourceSize - 1] == 0X80);
   const uint8_t *start = outBuf;
   uint8_t *end = outBuf + outSize;
@@ -100,6 +101,16 @@ ssize_t LCWDecompress(const uint8_t *source, size_t sourceSize, uint8_t *outBuf,
   return (uint16_t)(outBuf - start);
 }
 
+ssize_t LCWDecompress(const uint8_t *source, size_t sourceSize, uint8_t *outBuf,
+                      size_t outSize) {
+  uint64_t start = TracerBegin();
+  ssize_t ret = lcwDecompress(source, sourceSize, outBuf, outSize);
+  if (start) {
+    TracerComplete("lcw", "LCWDecompress", start, "bytes", ret);
+  }
+  return ret;
+}
+
 // from https://moddingwiki.shikadi.net/wiki/Westwood_LCW
 ssize_t LCWCompress(void const *input, void *output, unsigned long size) {
   // Decide if we are going to do relative offsets for 3 and 5 byte commands
@@ -7,8 +7,57 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define TIM_AVTL_START_OFFSET 1
+#define TIM_INSTRUCTION_MIN_SIZE 3 // len, duration, code
+
 void TIMHandleInit(TIMHandle *handle) { memset(handle, 0, sizeof(TIMHandle)); }
 
+void TIMHandleRelease(TIMHandle *handle) {
+  free(handle->events);
+  TIMHandleInit(handle);
+}
+
+// returns the number of instructions, a truncated one ends the list
+static size_t walkInstructions(const TIMHandle *handle, TIMEvent *events) {
+  size_t count = 0;
+  size_t pos = TIM_AVTL_START_OFFSET;
+  while (pos < handle->avtlSize) {
+    const uint16_t *instr = handle->avtl + pos;
+    uint16_t len = instr[0];
+    if (len < TIM_INSTRUCTION_MIN_SIZE || pos + len > handle->avtlSize) {
+      if (!events) {
+        printf("TIM: invalid instruction size %i at 0X%zX\n", len, pos);
+      }
+      break;
+    }
+    if (events) {
+      TIMEvent *event = events + count;
+      event->pos = pos;
+      event->duration = instr[1];
+      event->instrCode = instr[2] & 0XFF;
+      event->numParams = len - TIM_INSTRUCTION_MIN_SIZE;
+      event->params = instr + TIM_INSTRUCTION_MIN_SIZE;
+    }
+    count++;
+    pos += len;
+  }
+  return count;
+}
+
+static int decodeInstructions(TIMHandle *handle) {
+  handle->numEvents = walkInstructions(handle, NULL);
+  if (handle->numEvents == 0) {
+    return 1;
+  }
+  handle->events = malloc(handle->numEvents * sizeof(TIMEvent));
+  if (!handle->events) {
+    handle->numEvents = 0;
+    return 0;
+  }
+  walkInstructions(handle, handle->events);
+  return 1;
+}
+
 int TIMHandleFromBuffer(TIMHandle *handle, const uint8_t *buffer,
                         size_t bufferSize) {
   size_t readSize = 0;
@@ -29,6 +78,10 @@ int TIMHandleFromBuffer(TIMHandle *handle, const uint8_t *buffer,
       uint32_t textSize = swap_uint32(*(uint32_t *)buff);
       buff += 4;
       readSize += 4;
+      if (readSize > bufferSize || textSize > bufferSize - readSize) {
+        printf("TIM: truncated TEXT chunk\n");
+        return 0;
+      }
       handle->text = buff;
       handle->textSize = textSize;
       buff += textSize;
@@ -37,6 +90,10 @@ int TIMHandleFromBuffer(TIMHandle *handle, const uint8_t *buffer,
       uint32_t dataSize = swap_uint32(*(uint32_t *)buff); // size in bytes!
       buff += 4;
       readSize += 4;
+      if (readSize > bufferSize || dataSize > bufferSize - readSize) {
+        printf("TIM: truncated AVTL chunk\n");
+        return 0;
+      }
       handle->avtlSize = dataSize / 2;
       handle->avtl = (uint16_t *)buff;
 
@@ -46,7 +103,7 @@ int TIMHandleFromBuffer(TIMHandle *handle, const uint8_t *buffer,
       // nothing to do, the chunk is here but empty
     } else {
       printf("unknown chunk '%s'\n", chunkName);
-      assert(0);
+      return 0;
     }
   }
   if (handle->textSize > 0) {
@@ -61,7 +118,7 @@ int TIMHandleFromBuffer(TIMHandle *handle, const uint8_t *buffer,
     }
     handle->numTextStrings = i;
   }
-  return 1;
+  return decodeInstructions(handle);
 }
 
 const char *TIMHandleGetText(const TIMHandle *handle, int index) {
@@ -11,6 +11,15 @@ typedef struct {
   uint16_t *avtl;
 } TimFunction;
 
+// an instruction of the AVTL chunk, decoded once by TIMHandleFromBuffer
+typedef struct {
+  uint32_t pos;       // in avtl, in sizeof(uint16_t)
+  uint16_t duration;
+  uint16_t numParams;
+  const uint16_t *params;
+  uint8_t instrCode;
+} TIMEvent;
+
 typedef struct {
   uint8_t *text;
   size_t textSize;
@@ -19,9 +28,13 @@ typedef struct {
 
   uint16_t *avtl;
   size_t avtlSize; // size in sizeof(uint16_t)!
+
+  TIMEvent *events;
+  size_t numEvents;
 } TIMHandle;
 
 void TIMHandleInit(TIMHandle *handle);
+void TIMHandleRelease(TIMHandle *handle);
 
 int TIMHandleFromBuffer(TIMHandle *handle, const uint8_t *buffer,
                         size_t bufferSize);
@@ -1,5 +1,6 @@
 #include "format_tlc.h"
 #include <assert.h>
+#include <stddef.h>
 
 int TLCHandleFromBuffer(TLCHandle *handle, uint8_t *buffer, size_t bufferSize) {
   assert(bufferSize == TABLE_1_SIZE + TABLE_2_SIZE);
@@ -7,3 +8,13 @@ int TLCHandleFromBuffer(TLCHandle *handle, uint8_t *buffer, size_t bufferSize) {
   handle->table2 = buffer + TABLE_1_SIZE;
   return 1;
 }
+
+const uint8_t *TLCHandleGetFadeTable(const TLCHandle *handle, int level) {
+  if (level <= 0 || handle->table2 == NULL) {
+    return NULL;
+  }
+  if (level > TLC_NUM_FADE_TABLES) {
+    level = TLC_NUM_FADE_TABLES;
+  }
+  return handle->table2 + (level - 1) * TLC_FADE_TABLE_SIZE;
+}
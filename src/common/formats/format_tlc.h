@@ -5,9 +5,17 @@
 #define TABLE_1_SIZE 256
 #define TABLE_2_SIZE 5120
 
+// table2 is a list of 256 bytes palette index remap tables, from light to dark
+#define TLC_FADE_TABLE_SIZE 256
+#define TLC_NUM_FADE_TABLES (TABLE_2_SIZE / TLC_FADE_TABLE_SIZE)
+
 typedef struct {
   uint8_t *table1;
   uint8_t *table2;
 } TLCHandle;
 
 int TLCHandleFromBuffer(TLCHandle *handle, uint8_t *buffer, size_t bufferSize);
+
+// level 0 means no fading and returns NULL, levels above TLC_NUM_FADE_TABLES
+// are clamped to the darkest table.
+const uint8_t *TLCHandleGetFadeTable(const TLCHandle *handle, int level);
@@ -1,10 +1,12 @@
 #include "format_vcn.h"
 #include "format_lcw.h"
+#include "vga.h"
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 // https://web.archive.org/web/20180313235313/http://eob.wikispaces.com/eob.vcn#LoL
 
 #define VCNHEADER_SIZE 10
@@ -14,7 +16,70 @@ typedef struct {
   uint32_t uncompressedSize;
 } VCNCompressionHeader;
 
-void VCNHandleRelease(VCNHandle *handle) { free(handle->originalBuffer); }
+void VCNHandleRelease(VCNHandle *handle) {
+  free(handle->atlas.pixels);
+  free(handle->atlas.rowMasks);
+  free(handle->originalBuffer);
+  memset(handle, 0, sizeof(VCNHandle));
+}
+
+static int buildAtlas(VCNHandle *handle) {
+  VCNAtlas *atlas = &handle->atlas;
+  atlas->pixels =
+      malloc(handle->nbBlocks * 2 * VCN_BLOCK_PIXELS * sizeof(uint32_t));
+  atlas->rowMasks = malloc(handle->nbBlocks * 2 * VCN_BLOCK_SIZE);
+  if (!atlas->pixels || !atlas->rowMasks) {
+    free(atlas->pixels);
+    free(atlas->rowMasks);
+    memset(atlas, 0, sizeof(VCNAtlas));
+    return 0;
+  }
+
+  for (int blockId = 0; blockId < handle->nbBlocks; blockId++) {
+    uint8_t numPalette = handle->blocksPalettePosTable[blockId] / 16;
+    if (numPalette >= VCN_PALETTE_TABLE_SIZE) {
+      printf("numPalette %i > VCN_PALETTE_TABLE_SIZE %i\n", numPalette,
+             VCN_PALETTE_TABLE_SIZE);
+    }
+    assert(numPalette < VCN_PALETTE_TABLE_SIZE);
+    const uint8_t *table =
+        handle->posPaletteTables[numPalette].backdropWallPalettes;
+    const VCNBlock *block = handle->blocks + blockId;
+
+    uint32_t *pixels = atlas->pixels + blockId * 2 * VCN_BLOCK_PIXELS;
+    uint32_t *flipped = pixels + VCN_BLOCK_PIXELS;
+    uint8_t *masks = atlas->rowMasks + blockId * 2 * VCN_BLOCK_SIZE;
+    uint8_t *flippedMasks = masks + VCN_BLOCK_SIZE;
+
+    for (int y = 0; y < VCN_BLOCK_SIZE; y++) {
+      uint8_t mask = 0;
+      uint8_t flippedMask = 0;
+      for (int x = 0; x < VCN_BLOCK_SIZE; x++) {
+        uint8_t word = block->rawData[x / 2 + y * 4];
+        uint8_t p = (x & 1) ? word & 0x0f : (word & 0xf0) >> 4;
+        uint8_t idx = table[p];
+        assert(idx < 128);
+
+        uint8_t r = VGA6To8(handle->palette[0 + idx * 3]);
+        uint8_t g = VGA6To8(handle->palette[1 + idx * 3]);
+        uint8_t b = VGA6To8(handle->palette[2 + idx * 3]);
+
+        // same rule as the original blitter: any black channel is transparent
+        uint32_t color = 0;
+        if (r && g && b) {
+          color = 0XFF000000 + (r << 0X10) + (g << 0X8) + b;
+          mask |= 1 << x;
+          flippedMask |= 1 << (VCN_BLOCK_SIZE - 1 - x);
+        }
+        pixels[y * VCN_BLOCK_SIZE + x] = color;
+        flipped[y * VCN_BLOCK_SIZE + VCN_BLOCK_SIZE - 1 - x] = color;
+      }
+      masks[y] = mask;
+      flippedMasks[y] = flippedMask;
+    }
+  }
+  return 1;
+}
 
 int VCNHandleFromLCWBuffer(VCNHandle *handle, const uint8_t *buffer,
                            size_t size) {
@@ -44,8 +109,8 @@ int VCNHandleFromLCWBuffer(VCNHandle *handle, const uint8_t *buffer,
   dest += 3 * 128;
 
   VCNBlock *blocks = (VCNBlock *)dest;
-  
+
   handle->palette = palette;
   handle->blocks = blocks;
-  return 1;
+  return buildAtlas(handle);
 }
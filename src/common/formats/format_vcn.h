@@ -13,6 +13,17 @@ typedef struct {
 
 #define VCN_PALETTE_TABLE_SIZE 8
 #define VCN_PALETTE_BUFFER_SIZE 384
+
+#define VCN_BLOCK_SIZE 8
+#define VCN_BLOCK_PIXELS (VCN_BLOCK_SIZE * VCN_BLOCK_SIZE)
+
+// Blocks expanded to XRGB8888 with their palette table resolved. Each block
+// has 2 variants: index (blockId * 2) is normal, (blockId * 2 + 1) is x-flipped.
+// A pixel value of 0 is transparent, rowMasks has one bit per opaque pixel.
+typedef struct {
+  uint32_t *pixels;  // array size = nbBlocks * 2 * VCN_BLOCK_PIXELS
+  uint8_t *rowMasks; // array size = nbBlocks * 2 * VCN_BLOCK_SIZE
+} VCNAtlas;
 typedef struct {
   uint16_t nbBlocks;
 
@@ -23,6 +34,8 @@ typedef struct {
 
   VCNBlock *blocks; // array size = nbBlocks
 
+  VCNAtlas atlas; // built by VCNHandleFromLCWBuffer
+
   // freed by VCNDataRelease
   uint8_t *originalBuffer;
 } VCNHandle;
@@ -30,3 +43,13 @@ typedef struct {
 void VCNHandleRelease(VCNHandle *handle);
 int VCNHandleFromLCWBuffer(VCNHandle *handle, const uint8_t *buffer,
                            size_t size);
+
+static inline const uint32_t *VCNHandleGetBlockPixels(const VCNHandle *handle,
+                                                      int blockId, int flip) {
+  return handle->atlas.pixels + (blockId * 2 + (flip != 0)) * VCN_BLOCK_PIXELS;
+}
+
+static inline const uint8_t *VCNHandleGetBlockMasks(const VCNHandle *handle,
+                                                    int blockId, int flip) {
+  return handle->atlas.rowMasks + (blockId * 2 + (flip != 0)) * VCN_BLOCK_SIZE;
+}
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define VCNHEADER_SIZE 10
 typedef struct {
@@ -12,7 +13,10 @@ typedef struct {
   uint32_t uncompressedSize;
 } VMPCompressionHeader;
 
-void VMPHandleRelease(VMPHandle *handle) { free(handle->originalBuffer); }
+void VMPHandleRelease(VMPHandle *handle) {
+  free(handle->originalBuffer);
+  memset(handle, 0, sizeof(VMPHandle));
+}
 
 int VMPHandleFromLCWBuffer(VMPHandle *handle, const uint8_t *buffer,
                            size_t size) {
@@ -2,6 +2,8 @@
 #include "formats/format_lang.h"
 #include "logger.h"
 #include "pak_file.h"
+#include "profiler.h"
+#include "tracer.h"
 #include <assert.h>
 #include <ctype.h>
 #include <stddef.h>
@@ -9,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 static const char *pakFiles[] = {
     "CATWALK.PAK", "CAVE1.PAK", "CIMMERIA.PAK", "DRIVERS.PAK", "FOREST1.PAK",
@@ -167,6 +170,15 @@ static char *strtoupper(char *dest, const char *src) {
   return result;
 }
 
+static int traceGetFile(uint64_t start, const char *name,
+                        const GameFile *file, int ret) {
+  if (start) {
+    TracerComplete("assets", name, start, "bytes",
+                   ret ? file->bufferSize : 0);
+  }
+  return ret;
+}
+
 static int getFile(PAKFile *pak, GameFile *file, const char *name) {
   int index = PakFileGetEntryIndex(pak, name);
   if (index == -1) {
@@ -183,7 +195,7 @@ static int getFile(PAKFile *pak, GameFile *file, const char *name) {
   }
   size_t size = pak->entries[index].fileSize;
   if (size) {
-    Log("GAME_ENVIR", "get file %s", name);
+    Log(LogCategory_GameEnvir, "get file %s", name);
     file->buffer = PakFileGetEntryData(pak, index);
     file->bufferSize = PakFileGetEntrySize(pak, index);
     return 1;
@@ -204,7 +216,10 @@ int GameEnvironmentGetStartupFileWithExt(GameFile *file, const char *name,
 }
 
 int GameEnvironmentGetStartupFile(GameFile *file, const char *name) {
-  return getFile(&_envir.pakStartup, file, name);
+  PROFILER_SCOPE(ProfilerPhase_AssetLoad);
+  uint64_t start = TracerBegin();
+  return traceGetFile(start, name, file,
+                      getFile(&_envir.pakStartup, file, name));
 }
 
 int GameEnvironmentLoadLocalizedPak(PAKFile *file, const char *name) {
@@ -222,7 +237,10 @@ int GameEnvironmentLoadLocalizedPak(PAKFile *file, const char *name) {
 }
 
 int GameEnvironmentGetGeneralFile(GameFile *file, const char *name) {
-  return getFile(&_envir.pakGeneral, file, name);
+  PROFILER_SCOPE(ProfilerPhase_AssetLoad);
+  uint64_t start = TracerBegin();
+  return traceGetFile(start, name, file,
+                      getFile(&_envir.pakGeneral, file, name));
 }
 
 static int doLoadPak(const char *pakFileName) {
@@ -248,7 +266,7 @@ static int doLoadPak(const char *pakFileName) {
   return 1;
 }
 
-int GameEnvironmentGetFile(GameFile *file, const char *name) {
+static int findFile(GameFile *file, const char *name) {
   assert(file);
   assert(name);
   if (_envir.currentLevelPak) {
@@ -273,11 +291,17 @@ int GameEnvironmentGetFile(GameFile *file, const char *name) {
   int pakIndex = GameEnvironmentFindPak(name);
   if (pakIndex != -1) {
     doLoadPak(pakFiles[pakIndex]);
-    return GameEnvironmentGetFile(file, name);
+    return findFile(file, name);
   }
   return 0;
 }
 
+int GameEnvironmentGetFile(GameFile *file, const char *name) {
+  PROFILER_SCOPE(ProfilerPhase_AssetLoad);
+  uint64_t start = TracerBegin();
+  return traceGetFile(start, name, file, findFile(file, name));
+}
+
 int GameEnvironmentFindPak(const char *filename) {
   int i = 0;
   const char *pakFile = pakFiles[0];
@@ -317,8 +341,8 @@ int GameEnvironmentGetLangFile(GameFile *file, const char *name) {
                                        LanguageGetExtension(_envir.lang));
 }
 
-int GameEnvironmentGetFileFromPak(GameFile *file, const char *filename,
-                                  const char *pakFileName) {
+static int getFileFromPak(GameFile *file, const char *filename,
+                          const char *pakFileName) {
   PAKFile *pak = NULL;
   int cacheIndex = GetCacheIndex(pakFileName);
   if (cacheIndex != -1) {
@@ -346,8 +370,54 @@ int GameEnvironmentGetFileFromPak(GameFile *file, const char *filename,
   if (fIndex == -1) {
     return 0;
   }
-  Log("GAME_ENVIR", "get file %s from pak %s", filename, pakFileName);
+  Log(LogCategory_GameEnvir, "get file %s from pak %s", filename, pakFileName);
   file->buffer = PakFileGetEntryData(pak, fIndex);
   file->bufferSize = PakFileGetEntrySize(pak, fIndex);
   return 1;
 }
+
+int GameEnvironmentGetFileFromPak(GameFile *file, const char *filename,
+                                  const char *pakFileName) {
+  PROFILER_SCOPE(ProfilerPhase_AssetLoad);
+  uint64_t start = TracerBegin();
+  return traceGetFile(start, filename, file,
+                      getFileFromPak(file, filename, pakFileName));
+}
+
+static PAKFile *getPak(const char *pakFileName) {
+  if (strcmp(pakFileName, generalPakName) == 0) {
+    return &_envir.pakGeneral;
+  } else if (strcmp(pakFileName, startupPakName) == 0) {
+    return &_envir.pakStartup;
+  }
+  if (!doLoadPak(pakFileName)) {
+    return NULL;
+  }
+  return &_envir.cache[GetCacheIndex(pakFileName)].file;
+}
+
+int GameEnvironmentForEachFile(const char *ext,
+                               GameEnvironmentFileCallback callback,
+                               void *ctx) {
+  int count = 0;
+  for (int i = 0; pakFiles[i] != NULL; i++) {
+    PAKFile *pak = getPak(pakFiles[i]);
+    if (!pak) {
+      continue;
+    }
+    for (int j = 0; j < pak->count; j++) {
+      const PAKEntry *entry = pak->entries + j;
+      if (strlen(entry->filename) < 3 || entry->fileSize == 0 ||
+          strcasecmp(PakFileEntryGetExtension(entry), ext) != 0) {
+        continue;
+      }
+      GameFile file = {.buffer = PakFileGetEntryData(pak, j),
+                       .bufferSize = entry->fileSize};
+      if (file.buffer) {
+        callback(ctx, pakFiles[i], entry->filename, &file);
+        count++;
+      }
+    }
+  }
+  return count;
+}
@@ -52,3 +52,12 @@ int GameEnvironmentGetFileWithExt(GameFile *file, const char *name,
                                   const char *ext);
 
 int GameEnvironmentGetLangFile(GameFile *file, const char *name);
+
+typedef void (*GameEnvironmentFileCallback)(void *ctx, const char *pakName,
+                                            const char *fileName,
+                                            const GameFile *file);
+// loads all the PAK files of the game and calls the callback for each file
+// with the extension, eg. "TIM". Returns the number of files found.
+int GameEnvironmentForEachFile(const char *ext,
+                               GameEnvironmentFileCallback callback,
+                               void *ctx);
@@ -1,8 +1,22 @@
 #include "logger.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#define LOG_ASYNC_RING_SIZE 4096 // must be a power of 2
+#define LOG_ASYNC_MSG_SIZE 256
+#define LOG_ASYNC_FLUSH_INTERVAL_MS 5
+
+static const char *categoryNames[LogCategory_Count] = {
+    "SCRIPT",
+    "GAME_ENVIR",
+    "CALLBCK",
+};
 
 static void stdoutLogFunc(const char *prefix, const char *fmt, va_list args) {
   printf("[%s] ", prefix);
@@ -15,79 +29,174 @@ static Logger _stdOutLog = {.func = stdoutLogFunc};
 Logger *LoggerStdOut = &_stdOutLog;
 
 typedef struct {
-  Logger *defaultLogger;
-
-  char **prefixes;
-  size_t numPrefixes;
+  _Atomic(Logger *) defaultLogger;
+  atomic_uint enabledCategories;
+  atomic_int filtered; // set by the first LogEnableCategory
 } LogSystem;
 
-static LogSystem _logSystem = {0};
+static LogSystem _logSystem = {.enabledCategories = LOG_CATEGORIES_ALL};
 
-static int prefixIndex(const char *prefix) {
-  for (int i = 0; i < _logSystem.numPrefixes; i++) {
-    if (_logSystem.prefixes[i] && strcmp(prefix, _logSystem.prefixes[i]) == 0) {
-      return i;
-    }
-  }
-  return -1;
+atomic_uint _logActiveCategories = 0;
+
+static void updateActiveCategories(void) {
+  atomic_store(&_logActiveCategories,
+               atomic_load(&_logSystem.defaultLogger)
+                   ? atomic_load(&_logSystem.enabledCategories)
+                   : 0);
 }
 
-static int filterPrefix(const char *prefix) {
-  if (_logSystem.prefixes == NULL) {
-    return 1;
+void LogWrite(LogCategory category, const char *fmt, ...) {
+  assert(category < LogCategory_Count);
+  Logger *logger = atomic_load(&_logSystem.defaultLogger);
+  if (logger) {
+    va_list args;
+    va_start(args, fmt);
+    logger->func(categoryNames[category], fmt, args);
+    va_end(args);
   }
-  return prefixIndex(prefix) != -1;
 }
 
-static void addPrefix(const char *prefix) {
-  for (int i = 0; i < _logSystem.numPrefixes; i++) {
-    if (_logSystem.prefixes[i] == NULL) {
-      _logSystem.prefixes[i] = strdup(prefix);
-      return;
+void LoggerSetOutput(Logger *log) {
+  atomic_store(&_logSystem.defaultLogger, log);
+  updateActiveCategories();
+}
+
+const Logger *LoggerGetOutput(void) {
+  return atomic_load(&_logSystem.defaultLogger);
+}
+
+const char *LogCategoryName(LogCategory category) {
+  assert(category < LogCategory_Count);
+  return categoryNames[category];
+}
+
+int LogCategoryFromName(const char *name) {
+  for (int i = 0; i < LogCategory_Count; i++) {
+    if (strcmp(name, categoryNames[i]) == 0) {
+      return i;
     }
   }
-  size_t prevSize = _logSystem.numPrefixes * sizeof(char *);
-  _logSystem.numPrefixes *= 2;
-  size_t newSize = _logSystem.numPrefixes * sizeof(char *);
-  _logSystem.prefixes = realloc(_logSystem.prefixes, newSize);
-  memset(_logSystem.prefixes + prevSize, 0, newSize - prevSize);
-  addPrefix(prefix);
+  return -1;
 }
 
-void Log(const char *prefix, const char *fmt, ...) {
-  if (_logSystem.defaultLogger && filterPrefix(prefix)) {
-    va_list args;
-    va_start(args, fmt);
-    _logSystem.defaultLogger->func(prefix, fmt, args);
-    va_end(args);
+void LogEnableCategory(LogCategory category) {
+  assert(category < LogCategory_Count);
+  if (!atomic_exchange(&_logSystem.filtered, 1)) {
+    atomic_store(&_logSystem.enabledCategories, 0);
   }
+  atomic_fetch_or(&_logSystem.enabledCategories, 1U << category);
+  updateActiveCategories();
+}
+
+void LogDisableCategory(LogCategory category) {
+  assert(category < LogCategory_Count);
+  atomic_fetch_and(&_logSystem.enabledCategories, ~(1U << category));
+  updateActiveCategories();
 }
 
-void LoggerSetOutput(Logger *log) { _logSystem.defaultLogger = log; }
+// bounded multi producer, single consumer queue. A slot is free for the
+// producer at position pos when seq == pos, readable when seq == pos + 1.
+typedef struct {
+  atomic_uint seq;
+  char msg[LOG_ASYNC_MSG_SIZE];
+} AsyncLogSlot;
+
+static struct {
+  AsyncLogSlot slots[LOG_ASYNC_RING_SIZE];
+  atomic_uint head;
+  unsigned tail; // only touched by the writer
+  atomic_uint dropped;
 
-const Logger *LoggerGetOutput(void) { return _logSystem.defaultLogger; }
+  pthread_once_t startOnce;
+  pthread_t writer;
+  atomic_int running;
+  int started;
+} _async = {.startOnce = PTHREAD_ONCE_INIT};
 
-void LogEnablePrefix(const char *prefix) {
-  if (_logSystem.prefixes == NULL) {
-    _logSystem.numPrefixes = 10;
-    size_t newSize = _logSystem.numPrefixes * sizeof(char *);
-    _logSystem.prefixes = malloc(newSize);
-    memset(_logSystem.prefixes, 0, newSize);
+static void asyncDrain(void) {
+  for (;;) {
+    AsyncLogSlot *slot =
+        _async.slots + (_async.tail & (LOG_ASYNC_RING_SIZE - 1));
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) !=
+        _async.tail + 1) {
+      break;
+    }
+    fputs(slot->msg, stdout);
+    atomic_store_explicit(&slot->seq, _async.tail + LOG_ASYNC_RING_SIZE,
+                          memory_order_release);
+    _async.tail++;
   }
-  if (prefixIndex(prefix) != -1) {
-    return;
+  unsigned dropped = atomic_exchange(&_async.dropped, 0);
+  if (dropped) {
+    printf("[LOG] %u messages dropped\n", dropped);
   }
+  fflush(stdout);
+}
 
-  addPrefix(prefix);
+static void *asyncWriterMain(void *arg) {
+  const struct timespec interval = {0,
+                                    LOG_ASYNC_FLUSH_INTERVAL_MS * 1000000L};
+  while (atomic_load(&_async.running)) {
+    asyncDrain();
+    nanosleep(&interval, NULL);
+  }
+  return NULL;
 }
 
-void LogDisablePrefix(const char *prefix) {
-  for (int i = 0; i < _logSystem.numPrefixes; i++) {
-    if (strcmp(prefix, _logSystem.prefixes[i]) == 0) {
-      free(_logSystem.prefixes[i]);
-      _logSystem.prefixes[i] = NULL;
+static void asyncStart(void) {
+  for (unsigned i = 0; i < LOG_ASYNC_RING_SIZE; i++) {
+    atomic_init(&_async.slots[i].seq, i);
+  }
+  atomic_store(&_async.running, 1);
+  _async.started =
+      pthread_create(&_async.writer, NULL, asyncWriterMain, NULL) == 0;
+}
+
+static void asyncLogFunc(const char *prefix, const char *fmt, va_list args) {
+  pthread_once(&_async.startOnce, asyncStart);
+  unsigned pos = atomic_load_explicit(&_async.head, memory_order_relaxed);
+  AsyncLogSlot *slot;
+  for (;;) {
+    slot = _async.slots + (pos & (LOG_ASYNC_RING_SIZE - 1));
+    int diff =
+        (int)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&_async.head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // writer is late, don't block the game
+      atomic_fetch_add_explicit(&_async.dropped, 1, memory_order_relaxed);
       return;
+    } else {
+      pos = atomic_load_explicit(&_async.head, memory_order_relaxed);
     }
   }
-  return;
+  int len = snprintf(slot->msg, LOG_ASYNC_MSG_SIZE, "[%s] ", prefix);
+  len += vsnprintf(slot->msg + len, LOG_ASYNC_MSG_SIZE - len, fmt, args);
+  if (len > LOG_ASYNC_MSG_SIZE - 2) {
+    len = LOG_ASYNC_MSG_SIZE - 2;
+  }
+  slot->msg[len] = '\n';
+  slot->msg[len + 1] = 0;
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+static Logger _asyncStdOutLog = {.func = asyncLogFunc};
+
+Logger *LoggerAsyncStdOut = &_asyncStdOutLog;
+
+void LoggerAsyncStop(void) {
+  if (!_async.started) {
+    return;
+  }
+  if (LoggerGetOutput() == LoggerAsyncStdOut) {
+    LoggerSetOutput(NULL);
+  }
+  atomic_store(&_async.running, 0);
+  pthread_join(_async.writer, NULL);
+  _async.started = 0;
+  asyncDrain();
 }
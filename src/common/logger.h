@@ -1,8 +1,26 @@
 #pragma once
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 #define PRINTFLIKE(n, m) __attribute__((format(printf, n, m)))
 
+typedef enum {
+  LogCategory_Script = 0,
+  LogCategory_GameEnvir,
+  LogCategory_Callbacks,
+
+  LogCategory_Count,
+} LogCategory;
+
+#define LOG_CATEGORIES_ALL ((1U << LogCategory_Count) - 1)
+
+// categories left out of this mask are compiled out, eg.
+// -DLOG_COMPILED_CATEGORIES=0 removes all the logs.
+#ifndef LOG_COMPILED_CATEGORIES
+#define LOG_COMPILED_CATEGORIES LOG_CATEGORIES_ALL
+#endif
+
 typedef void (*LOGFunction)(const char *prefix, const char *fmt, va_list args)
     PRINTFLIKE(2, 0);
 
@@ -13,8 +31,37 @@ typedef struct _Logger {
 
 extern Logger *LoggerStdOut;
 
+// formats in the calling thread, a background thread does the writing.
+// LoggerAsyncStop flushes the pending messages.
+extern Logger *LoggerAsyncStdOut;
+void LoggerAsyncStop(void);
+
 void LoggerSetOutput(Logger *log);
 const Logger *LoggerGetOutput(void);
-void Log(const char *prefix, const char *fmt, ...) PRINTFLIKE(2, 3);
-void LogEnablePrefix(const char *prefix);
-void LogDisablePrefix(const char *prefix);
+
+// bit n is set when category n is enabled and there is an output, the
+// debugger changes it from its own thread
+extern atomic_uint _logActiveCategories;
+
+#define LogIsActive(category)                                                  \
+  ((LOG_COMPILED_CATEGORIES & (1U << (category))) &&                           \
+   (atomic_load_explicit(&_logActiveCategories, memory_order_relaxed) &      \
+    (1U << (category))))
+
+// the arguments are only evaluated when the category is active
+#define Log(category, ...)                                                     \
+  do {                                                                         \
+    if (LogIsActive(category)) {                                               \
+      LogWrite((category), __VA_ARGS__);                                       \
+    }                                                                          \
+  } while (0)
+
+void LogWrite(LogCategory category, const char *fmt, ...) PRINTFLIKE(2, 3);
+
+const char *LogCategoryName(LogCategory category);
+// returns -1 if the name is unknown
+int LogCategoryFromName(const char *name);
+// All the categories are logged until one is enabled, only the enabled ones
+// are logged after that.
+void LogEnableCategory(LogCategory category);
+void LogDisableCategory(LogCategory category);
@@ -0,0 +1,108 @@
+#include "profiler.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  uint64_t frameAccum; // time spent in the current frame
+  uint32_t frameCalls;
+  uint32_t depth;
+  uint64_t lastFrame; // time spent during the last finished frame
+
+  uint64_t window[PROFILER_WINDOW_SIZE];
+  uint32_t windowPos;
+  uint32_t windowCount;
+  uint32_t lastCalls;
+} PhaseHistory;
+
+// per thread, so that a scope on another thread can't race with the game
+// thread. Only the game thread ends frames and reads the stats.
+static _Thread_local PhaseHistory _phases[ProfilerPhase_Count];
+
+static const char *phaseNames[ProfilerPhase_Count] = {
+    "frame",  "dbgServer", "inputs",  "scripts",
+    "render", "maze",      "present", "assets",
+};
+
+uint64_t ProfilerNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void ProfilerAddSample(ProfilerPhase phase, uint64_t durationNs) {
+  assert(phase < ProfilerPhase_Count);
+  _phases[phase].frameAccum += durationNs;
+  _phases[phase].frameCalls++;
+}
+
+uint64_t ProfilerEnter(ProfilerPhase phase) {
+  assert(phase < ProfilerPhase_Count);
+  _phases[phase].depth++;
+  return ProfilerNow();
+}
+
+void ProfilerLeave(ProfilerPhase phase, uint64_t start) {
+  assert(phase < ProfilerPhase_Count);
+  assert(_phases[phase].depth > 0);
+  if (--_phases[phase].depth == 0) {
+    ProfilerAddSample(phase, ProfilerNow() - start);
+  }
+}
+
+void ProfilerFrameEnd(void) {
+  for (int i = 0; i < ProfilerPhase_Count; i++) {
+    PhaseHistory *h = _phases + i;
+    h->lastCalls = h->frameCalls;
+    h->lastFrame = h->frameAccum;
+    if (h->frameCalls) {
+      h->window[h->windowPos] = h->frameAccum;
+      h->windowPos = (h->windowPos + 1) % PROFILER_WINDOW_SIZE;
+      if (h->windowCount < PROFILER_WINDOW_SIZE) {
+        h->windowCount++;
+      }
+    }
+    h->frameAccum = 0;
+    h->frameCalls = 0;
+  }
+}
+
+static int cmpSamples(const void *a, const void *b) {
+  uint64_t va = *(const uint64_t *)a;
+  uint64_t vb = *(const uint64_t *)b;
+  return va < vb ? -1 : va > vb;
+}
+
+void ProfilerGetStats(ProfilerPhase phase, ProfilerStats *stats) {
+  assert(phase < ProfilerPhase_Count);
+  memset(stats, 0, sizeof(ProfilerStats));
+  const PhaseHistory *h = _phases + phase;
+  stats->lastCalls = h->lastCalls;
+  stats->numSamples = h->windowCount;
+  if (h->windowCount == 0) {
+    return;
+  }
+  uint64_t sorted[PROFILER_WINDOW_SIZE];
+  memcpy(sorted, h->window, h->windowCount * sizeof(uint64_t));
+  qsort(sorted, h->windowCount, sizeof(uint64_t), cmpSamples);
+
+  uint64_t total = 0;
+  for (int i = 0; i < h->windowCount; i++) {
+    total += sorted[i];
+  }
+  stats->minNs = sorted[0];
+  stats->maxNs = sorted[h->windowCount - 1];
+  stats->avgNs = total / h->windowCount;
+  stats->p99Ns = sorted[(h->windowCount * 99) / 100];
+}
+
+uint64_t ProfilerGetLastFrameNs(ProfilerPhase phase) {
+  assert(phase < ProfilerPhase_Count);
+  return _phases[phase].lastFrame;
+}
+
+const char *ProfilerPhaseName(ProfilerPhase phase) {
+  assert(phase < ProfilerPhase_Count);
+  return phaseNames[phase];
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// number of frames kept for the rolling min/avg/p99 statistics
+#define PROFILER_WINDOW_SIZE 128
+
+typedef enum {
+  ProfilerPhase_Frame = 0,
+  ProfilerPhase_DebugServer,
+  ProfilerPhase_Inputs,
+  ProfilerPhase_Scripts,
+  ProfilerPhase_Render,
+  ProfilerPhase_RenderMaze,
+  ProfilerPhase_Present,
+  ProfilerPhase_AssetLoad,
+
+  ProfilerPhase_Count,
+} ProfilerPhase;
+
+typedef struct {
+  uint32_t numSamples; // frames in the window where the phase ran
+  uint64_t minNs;
+  uint64_t avgNs;
+  uint64_t p99Ns;
+  uint64_t maxNs;
+  uint32_t lastCalls; // number of times the phase ran during the last frame
+} ProfilerStats;
+
+// monotonic time in nanoseconds, can be called from any thread
+uint64_t ProfilerNow(void);
+
+// The phases below are only recorded for the game thread: the samples taken
+// on other threads (TIM checker workers, audio callback, music thread) are
+// kept apart and never reported, these threads time themselves with
+// ProfilerNow.
+
+void ProfilerAddSample(ProfilerPhase phase, uint64_t durationNs);
+
+// Enter returns the start time. Nested calls for the same phase (eg. a script
+// running another script) are only counted once, by the outermost Leave.
+uint64_t ProfilerEnter(ProfilerPhase phase);
+void ProfilerLeave(ProfilerPhase phase, uint64_t start);
+
+// pushes the time accumulated by each phase during the frame into its window.
+void ProfilerFrameEnd(void);
+
+void ProfilerGetStats(ProfilerPhase phase, ProfilerStats *stats);
+// time spent in the phase during the last finished frame
+uint64_t ProfilerGetLastFrameNs(ProfilerPhase phase);
+const char *ProfilerPhaseName(ProfilerPhase phase);
+
+typedef struct {
+  ProfilerPhase phase;
+  uint64_t start;
+} ProfilerScope;
+
+static inline void ProfilerScopeEnd(ProfilerScope *scope) {
+  ProfilerLeave(scope->phase, scope->start);
+}
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+// times the enclosing block until it goes out of scope.
+#define PROFILER_SCOPE(phase)                                                  \
+  ProfilerScope PROFILER_CONCAT(_profilerScope, __LINE__)                      \
+      __attribute__((cleanup(ProfilerScopeEnd))) = {(phase),                   \
+                                                    ProfilerEnter(phase)}
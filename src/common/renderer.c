@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 static void renderPalette(SDL_Renderer *renderer, const uint8_t *paletteBuffer,
@@ -114,57 +115,37 @@ static void drawMazePix(void *data, int pitch, uint8_t r, uint8_t g, uint8_t b,
   row[x] = 0XFF000000 + (r << 0X10) + (g << 0X8) + b;
 }
 
-void blitBlock(SDL_Texture *pixBuf, const VCNHandle *handle, int blockId, int x,
-               int y, int flip) {
-  const VCNBlock *block = handle->blocks + blockId;
+// copies one pre-expanded block into an already locked pixel buffer
+static void blitAtlasBlock(void *data, int pitch, const VCNHandle *handle,
+                           int blockId, int x, int y, int flip) {
+  assert(blockId < handle->nbBlocks);
+  const uint32_t *pixels = VCNHandleGetBlockPixels(handle, blockId, flip);
+  const uint8_t *masks = VCNHandleGetBlockMasks(handle, blockId, flip);
 
-  const int s = flip ? -1 : 1;
-  const int p = flip ? 7 : 0;
-
-  uint8_t numPalette = handle->blocksPalettePosTable[blockId] / 16;
-  if (numPalette >= VCN_PALETTE_TABLE_SIZE) {
-    printf("numPalette %i > VCN_PALETTE_TABLE_SIZE %i\n", numPalette,
-           VCN_PALETTE_TABLE_SIZE);
+  x += MAZE_COORDS_X;
+  y += MAZE_COORDS_Y;
+  for (int w = 0; w < VCN_BLOCK_SIZE; w++) {
+    uint32_t *row = (uint32_t *)((char *)data + pitch * (y + w)) + x;
+    const uint32_t *src = pixels + w * VCN_BLOCK_SIZE;
+    uint8_t mask = masks[w];
+    if (mask == 0XFF) {
+      memcpy(row, src, VCN_BLOCK_SIZE * sizeof(uint32_t));
+    } else if (mask) {
+      for (int v = 0; v < VCN_BLOCK_SIZE; v++) {
+        if (mask & (1 << v)) {
+          row[v] = src[v];
+        }
+      }
+    }
   }
-  assert(numPalette < VCN_PALETTE_TABLE_SIZE);
+}
 
+void blitBlock(SDL_Texture *pixBuf, const VCNHandle *handle, int blockId, int x,
+               int y, int flip) {
   void *data;
   int pitch;
   SDL_LockTexture(pixBuf, NULL, &data, &pitch);
-  for (int w = 0; w < 8; w++) {
-    for (int v = 0; v < 4; v++) {
-      uint8_t word = block->rawData[v + w * 4];
-      uint8_t p0 = (word & 0xf0) >> 4;
-      uint8_t p1 = word & 0x0f;
-
-      uint8_t idx0 =
-          handle->posPaletteTables[numPalette].backdropWallPalettes[p0];
-      assert(idx0 < 128);
-      uint8_t idx1 =
-          handle->posPaletteTables[numPalette].backdropWallPalettes[p1];
-      assert(idx1 < 128);
-
-      uint8_t r = VGA6To8(handle->palette[0 + idx0 * 3]);
-      uint8_t g = VGA6To8(handle->palette[1 + idx0 * 3]);
-      uint8_t b = VGA6To8(handle->palette[2 + idx0 * 3]);
-
-      uint8_t destX = x + p + s * 2 * v;
-      uint8_t destY = y + w;
-      if (r && g && b) {
-        drawMazePix(data, pitch, r, g, b, destX, destY);
-      }
-
-      r = VGA6To8(handle->palette[0 + idx1 * 3]);
-      g = VGA6To8(handle->palette[1 + idx1 * 3]);
-      b = VGA6To8(handle->palette[2 + idx1 * 3]);
-
-      destX = x + p + s + s * 2 * v;
-
-      if (r && g && b) {
-        drawMazePix(data, pitch, r, g, b, destX, destY);
-      }
-    }
-  }
+  blitAtlasBlock(data, pitch, handle, blockId, x, y, flip);
   SDL_UnlockTexture(pixBuf);
 }
 
@@ -307,7 +288,7 @@ void VCNImageToPng(const VCNHandle *handle, const char *savePngPath) {
 
 void drawSHPMazeFrame(SDL_Texture *pixBuf, const SHPFrame *frame, int xPos,
                       int yPos, const uint8_t *palette, uint8_t xFlip,
-                      float att) {
+                      const uint8_t *fadeTable) {
   void *data;
   int pitch;
   SDL_LockTexture(pixBuf, NULL, &data, &pitch);
@@ -318,6 +299,9 @@ void drawSHPMazeFrame(SDL_Texture *pixBuf, const SHPFrame *frame, int xPos,
       if (v == 0) {
         continue;
       }
+      if (fadeTable) {
+        v = fadeTable[v];
+      }
       uint8_t r = v;
       uint8_t g = v;
       uint8_t b = v;
@@ -326,12 +310,6 @@ void drawSHPMazeFrame(SDL_Texture *pixBuf, const SHPFrame *frame, int xPos,
         g = VGA6To8(palette[(v * 3) + 1]);
         b = VGA6To8(palette[(v * 3) + 2]);
       }
-      if (att != 1.0f) {
-        r /= att;
-        g /= att;
-        b /= att;
-      }
-
       int xx = x + xPos;
       int yy = y + yPos + MAZE_COORDS_Y;
 
@@ -483,51 +461,189 @@ WallRenderData wallRenderData[25] = /* 25 different wall positions exists */
         {-101, 19, 15, 3, 0, 1}, /* Q-west */
 };
 
-void drawWall(SDL_Texture *pixBuf, const VCNHandle *vcn, const VMPHandle *vmp,
-              int wallType, int wallPosition) {
+#define VIEWPORT_BLOCKS_W 22
+#define VIEWPORT_BLOCKS_H 15
+#define VMP_WALL_TYPE_STRIDE 431
+
+static int countWallBlocks(const WallRenderData *wallCfg) {
+  return wallCfg->visibleHeightInBlocks * wallCfg->visibleWidthInBlocks;
+}
+
+// returns the number of commands written, 0 if the wall type has no valid
+// tiles for this position.
+static int buildWallCommands(BlitCommand *commands, const VCNHandle *vcn,
+                             const VMPHandle *vmp, int wallType,
+                             int wallPosition) {
   const WallRenderData *wallCfg = &wallRenderData[wallPosition];
   int flipX = wallCfg->flipFlag;
-  int offset = wallCfg->baseOffset;
+  int offset = wallCfg->baseOffset + (VMP_WALL_TYPE_STRIDE * wallType);
+  int numCommands = 0;
 
   for (int y = 0; y < wallCfg->visibleHeightInBlocks; y++) {
     for (int x = 0; x < wallCfg->visibleWidthInBlocks; x++) {
+      if (offset < 0 || offset >= vmp->nbrOfBlocks) {
+        return 0;
+      }
       int blockIndex;
       if (flipX == 0) {
-        blockIndex = x + y * 22 + wallCfg->offsetInViewPort;
+        blockIndex = x + y * VIEWPORT_BLOCKS_W + wallCfg->offsetInViewPort;
       } else {
         blockIndex = wallCfg->offsetInViewPort + wallCfg->visibleWidthInBlocks -
-                     1 - x + y * 22;
+                     1 - x + y * VIEWPORT_BLOCKS_W;
       }
 
-      int xpos = blockIndex % 22;
-      int ypos = blockIndex / 22;
       VMPTile tile = {0};
-      VMPHandleGetTile(vmp, offset + (431 * wallType), &tile);
-      // int tile = vmp-> .wallTiles[wallType][offset];
-
+      VMPHandleGetTile(vmp, offset, &tile);
+      if (tile.blockIndex >= vcn->nbBlocks) {
+        return 0;
+      }
+      BlitCommand *cmd = commands + numCommands++;
+      cmd->x = (blockIndex % VIEWPORT_BLOCKS_W) * 8;
+      cmd->y = (blockIndex / VIEWPORT_BLOCKS_W) * 8;
+      cmd->blockId = tile.blockIndex;
       /* xor with wall flip-x to make block flip and wall flip cancel each other
        * out. */
-      int blockFlip = (tile.flipped) ^ flipX;
-      int destPostX = xpos * 8;
-      int destPostY = ypos * 8;
-      blitBlock(pixBuf, vcn, tile.blockIndex, destPostX, destPostY, blockFlip);
+      cmd->flip = (tile.flipped) ^ flipX;
 
       offset++;
     }
     offset += wallCfg->skipValue;
   }
+  return numCommands;
 }
 
-void drawCeilingAndFloor(SDL_Texture *pixBuf, const VCNHandle *vcn,
-                         const VMPHandle *vmp) {
-  for (int y = 0; y < 15; y++) {
-    for (int x = 0; x < 22; x++) {
-      int index = y * 22 + x;
+static int isBlockOpaque(const VCNHandle *vcn, int blockId) {
+  const uint8_t *masks = VCNHandleGetBlockMasks(vcn, blockId, 0);
+  for (int i = 0; i < VCN_BLOCK_SIZE; i++) {
+    if (masks[i] != 0XFF) {
+      return 0;
+    }
+  }
+  return 1;
+}
 
-      VMPTile tile = {0};
-      VMPHandleGetTile(vmp, index, &tile);
-      assert(tile.blockIndex < vcn->nbBlocks);
-      blitBlock(pixBuf, vcn, tile.blockIndex, x * 8, y * 8, tile.flipped);
+static uint32_t computeOpaqueColumns(const VCNHandle *vcn,
+                                     const BlitCommand *commands,
+                                     uint32_t count) {
+  uint32_t columns = 0;
+  uint32_t seeThrough = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t bit = 1U << (commands[i].x / 8);
+    columns |= bit;
+    if (!isBlockOpaque(vcn, commands[i].blockId)) {
+      seeThrough |= bit;
     }
   }
+  return columns & ~seeThrough;
+}
+
+uint32_t WallRenderIndexGetColumns(int wallPosition) {
+  assert(wallPosition < WALL_RENDER_POSITIONS);
+  const WallRenderData *wallCfg = &wallRenderData[wallPosition];
+  int first = wallCfg->offsetInViewPort % VIEWPORT_BLOCKS_W;
+  uint32_t columns = 0;
+  for (int x = 0; x < wallCfg->visibleWidthInBlocks; x++) {
+    columns |= 1U << (first + x);
+  }
+  return columns;
+}
+
+uint32_t WallBlitPlanGetOpaqueColumns(const WallBlitPlan *plan, int wallType,
+                                      int wallPosition) {
+  assert(wallType < plan->numWallTypes);
+  assert(wallPosition < WALL_RENDER_POSITIONS);
+  return plan->wallOpaqueColumns[wallType * WALL_RENDER_POSITIONS +
+                                 wallPosition];
+}
+
+void WallBlitPlanRelease(WallBlitPlan *plan) {
+  free(plan->commands);
+  free(plan->wallStarts);
+  free(plan->wallOpaqueColumns);
+  memset(plan, 0, sizeof(WallBlitPlan));
+}
+
+int WallBlitPlanBuild(WallBlitPlan *plan, const VCNHandle *vcn,
+                      const VMPHandle *vmp) {
+  WallBlitPlanRelease(plan);
+  plan->numWallTypes = vmp->nbrOfBlocks / VMP_WALL_TYPE_STRIDE + 1;
+
+  size_t maxCommands = CEILING_VARIANTS * VIEWPORT_BLOCKS_W * VIEWPORT_BLOCKS_H;
+  for (int i = 0; i < WALL_RENDER_POSITIONS; i++) {
+    maxCommands += plan->numWallTypes * countWallBlocks(&wallRenderData[i]);
+  }
+  plan->commands = malloc(maxCommands * sizeof(BlitCommand));
+  plan->wallStarts = malloc(
+      (plan->numWallTypes * WALL_RENDER_POSITIONS + 1) * sizeof(uint32_t));
+  plan->wallOpaqueColumns =
+      malloc(plan->numWallTypes * WALL_RENDER_POSITIONS * sizeof(uint32_t));
+  if (!plan->commands || !plan->wallStarts || !plan->wallOpaqueColumns) {
+    WallBlitPlanRelease(plan);
+    return 0;
+  }
+
+  uint32_t numCommands = 0;
+  for (int variant = 0; variant < CEILING_VARIANTS; variant++) {
+    plan->ceilingStarts[variant] = numCommands;
+    for (int y = 0; y < VIEWPORT_BLOCKS_H; y++) {
+      for (int x = 0; x < VIEWPORT_BLOCKS_W; x++) {
+        VMPTile tile = {0};
+        VMPHandleGetTile(vmp, y * VIEWPORT_BLOCKS_W + x, &tile);
+        assert(tile.blockIndex < vcn->nbBlocks);
+        BlitCommand *cmd = plan->commands + numCommands++;
+        // variant 1 is the mirrored ceiling/floor
+        int destX = variant ? VIEWPORT_BLOCKS_W - 1 - x : x;
+        cmd->x = destX * 8;
+        cmd->y = y * 8;
+        cmd->blockId = tile.blockIndex;
+        cmd->flip = variant ? !tile.flipped : tile.flipped;
+      }
+    }
+  }
+  plan->ceilingStarts[CEILING_VARIANTS] = numCommands;
+
+  for (int wallType = 0; wallType < plan->numWallTypes; wallType++) {
+    for (int pos = 0; pos < WALL_RENDER_POSITIONS; pos++) {
+      int slot = wallType * WALL_RENDER_POSITIONS + pos;
+      int count = buildWallCommands(plan->commands + numCommands, vcn, vmp,
+                                    wallType, pos);
+      plan->wallStarts[slot] = numCommands;
+      plan->wallOpaqueColumns[slot] =
+          computeOpaqueColumns(vcn, plan->commands + numCommands, count);
+      numCommands += count;
+    }
+  }
+  plan->wallStarts[plan->numWallTypes * WALL_RENDER_POSITIONS] = numCommands;
+  assert(numCommands <= maxCommands);
+  return 1;
+}
+
+static void runBlitCommands(SDL_Texture *pixBuf, const VCNHandle *vcn,
+                            const BlitCommand *commands, uint32_t count) {
+  void *data;
+  int pitch;
+  SDL_LockTexture(pixBuf, NULL, &data, &pitch);
+  for (uint32_t i = 0; i < count; i++) {
+    const BlitCommand *cmd = commands + i;
+    blitAtlasBlock(data, pitch, vcn, cmd->blockId, cmd->x, cmd->y, cmd->flip);
+  }
+  SDL_UnlockTexture(pixBuf);
+}
+
+void drawWall(SDL_Texture *pixBuf, const VCNHandle *vcn,
+              const WallBlitPlan *plan, int wallType, int wallPosition) {
+  assert(wallType < plan->numWallTypes);
+  assert(wallPosition < WALL_RENDER_POSITIONS);
+  const uint32_t *starts =
+      plan->wallStarts + wallType * WALL_RENDER_POSITIONS + wallPosition;
+  runBlitCommands(pixBuf, vcn, plan->commands + starts[0],
+                  starts[1] - starts[0]);
+}
+
+void drawCeilingAndFloor(SDL_Texture *pixBuf, const VCNHandle *vcn,
+                         const WallBlitPlan *plan, int variant) {
+  assert(variant < CEILING_VARIANTS);
+  const uint32_t *starts = plan->ceilingStarts + variant;
+  runBlitCommands(pixBuf, vcn, plan->commands + starts[0],
+                  starts[1] - starts[0]);
 }
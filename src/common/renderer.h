@@ -4,13 +4,11 @@
 #include "formats/format_shp.h"
 #include "formats/format_vcn.h"
 #include "formats/format_vmp.h"
+#include "vga.h"
 #include <SDL2/SDL.h>
 #include <stddef.h>
 #include <stdint.h>
 
-static inline uint8_t VGA6To8(uint8_t v) { return (v * 255) / 63; }
-#define VGA8To8(x) x
-
 /*
     Field of vision: the 17 map positions required to read for rendering a
    screen and the 25 possible wall configurations that these positions might
@@ -67,12 +65,45 @@ void drawPix(void *data, int pitch, uint8_t r, uint8_t g, uint8_t b, int x,
 void SHPFrameToPng(const SHPFrame *frame, const char *savePngPath,
                    const uint8_t *palette);
 
+#define WALL_RENDER_POSITIONS 25
+#define CEILING_VARIANTS 2
+
+typedef struct {
+  uint8_t x; // in pixels, relative to the maze viewport
+  uint8_t y;
+  uint8_t flip;
+  uint16_t blockId;
+} BlitCommand;
+
+// Every block blit needed to draw the ceiling/floor (normal and mirrored) and
+// each (wallType, WallRenderIndex) pair, resolved once from the level VMP.
+typedef struct {
+  BlitCommand *commands;
+  int numWallTypes;
+  // start index in commands for each variant/slot, the count is next - start.
+  uint32_t ceilingStarts[CEILING_VARIANTS + 1];
+  uint32_t *wallStarts; // array size = numWallTypes * WALL_RENDER_POSITIONS + 1
+  // one bit per 8 pixels maze column, set when the wall fully hides what is
+  // behind it in that column. array size = numWallTypes * WALL_RENDER_POSITIONS
+  uint32_t *wallOpaqueColumns;
+} WallBlitPlan;
+
+int WallBlitPlanBuild(WallBlitPlan *plan, const VCNHandle *vcn,
+                      const VMPHandle *vmp);
+void WallBlitPlanRelease(WallBlitPlan *plan);
+uint32_t WallBlitPlanGetOpaqueColumns(const WallBlitPlan *plan, int wallType,
+                                      int wallPosition);
+
+// columns touched by a wall position, same bit layout as wallOpaqueColumns.
+uint32_t WallRenderIndexGetColumns(int wallPosition);
+
 void drawCeilingAndFloor(SDL_Texture *pixBuf, const VCNHandle *vcn,
-                         const VMPHandle *vmp);
-void drawWall(SDL_Texture *pixBuf, const VCNHandle *vcn, const VMPHandle *vmp,
-              int wallType, int wallPosition);
+                         const WallBlitPlan *plan, int variant);
+void drawWall(SDL_Texture *pixBuf, const VCNHandle *vcn,
+              const WallBlitPlan *plan, int wallType, int wallPosition);
 
 void drawSHPMazeFrame(SDL_Texture *pixBuf, const SHPFrame *frame, int x, int y,
-                      const uint8_t *palette, uint8_t xFlip, float att);
+                      const uint8_t *palette, uint8_t xFlip,
+                      const uint8_t *fadeTable);
 void drawSHPFrameCursor(SDL_Renderer *renderer, const SHPFrame *frame, int xPos,
                         int yPos, const uint8_t *palette);
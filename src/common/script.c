@@ -3,7 +3,8 @@
 #include "formats/format_inf.h"
 #include "logger.h"
 #include "script_builtins.h"
-#include "script_disassembler.h"
+#include "script_native.h"
+#include "script_profiler.h"
 #include <assert.h>
 #include <stdarg.h>
 #include <stddef.h>
@@ -16,451 +17,12 @@ const char *EMCStateGetDataString(const EMCState *state, int16_t index) {
   return INFScriptGetDataString(state->dataPtr, index);
 }
 
-static void emitLineFunctionCall(EMCDisassembler *disasm, uint16_t funcCode,
-                                 uint32_t instOffset) {
-
-  if (funcCode >= getNumBuiltinFunctions()) {
-    EMCDisassemblerEmitLine(disasm, instOffset, "%s 0X%X", MNEMONIC_CALL,
-                            funcCode);
-    printf("func %X is outside builtins (size=%zx) at offset 0X%X\n", funcCode,
-           getNumBuiltinFunctions(), instOffset);
-    return;
-  }
-  assert(getBuiltinFunctions()[funcCode].name);
-  EMCDisassemblerEmitLine(disasm, instOffset, "%s %s", MNEMONIC_CALL,
-                          getBuiltinFunctions()[funcCode].name);
-}
-
 static void StackPush(EMCState *s, uint16_t val) { s->stack[--s->sp] = val; }
 static uint16_t StackPop(EMCState *s) { return s->stack[s->sp++]; }
 
 #define LOG_INST(fmt, ...)                                                     \
-  Log("SCRIPT", "0X%04X :" fmt, instOffset __VA_OPT__(, ) __VA_ARGS__)
-
-static void execOpCode(EMCInterpreter *interp, EMCState *script,
-                       uint16_t opCode, uint16_t parameter,
-                       uint32_t instOffset) {
-  if (interp->disassembler) {
-    int offsetIndex = INFScriptIsOffset(script->dataPtr, instOffset);
-    if (offsetIndex != -1) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_LABEL_OFFSET, offsetIndex);
-    }
-  }
-
-  switch ((ScriptCommand)opCode) {
-  case OP_JUMP:
-    LOG_INST("JUMP 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_JUMP, parameter);
-    } else {
-      script->ip = script->dataPtr->scriptData + parameter;
-#if 0
-      printf("After jump ip=%lX\n", script->ip - script->dataPtr->data);
-      if (script->ip - script->dataPtr->data == 0) {
-        printf("STOP \n");
-        script->ip = NULL;
-      }
-#endif
-    }
-    return;
-  case OP_SETRETURNVALUE:
-    LOG_INST("SETRET");
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_SETRET, parameter);
-    } else {
-      script->retValue = parameter;
-    }
-    return;
-  case OP_PUSH_RETURN_OR_LOCATION:
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_PUSH_RC, parameter);
-    } else {
-      switch (parameter) {
-      case 0:
-        LOG_INST("PUSHRET 0X%X", script->retValue);
-        StackPush(script, script->retValue);
-        return;
-      case 1:
-        LOG_INST("PUSHRETLOC");
-        StackPush(script, script->ip - script->dataPtr->scriptData + 1);
-        StackPush(script, script->bp);
-        script->bp = script->sp + 2;
-        return;
-
-      default:
-        assert(0);
-        script->ip = NULL;
-      }
-    }
-    return;
-  case OP_PUSH:
-  case OP_PUSH2:
-    LOG_INST("PUSH 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_PUSH, parameter);
-    } else {
-      StackPush(script, parameter);
-    }
-    return;
-  case OP_PUSH_VARIABLE:
-    LOG_INST("PUSHVAR 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_PUSH_VAR, parameter);
-    } else {
-      StackPush(script, script->regs[parameter]);
-    }
-    return;
-  case OP_PUSH_LOCAL_VARIABLE:
-    LOG_INST("PUSHLOCVAR 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_PUSH_LOC_VAR, parameter);
-    } else {
-      StackPush(script, script->stack[script->bp - parameter - 2]);
-    }
-    return;
-  case OP_PUSH_PARAMETER:
-    LOG_INST("PUSHPARAM 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_PUSH_ARG, parameter);
-    } else {
-      uint16_t val = script->stack[script->bp + parameter - 1];
-      StackPush(script, val);
-    }
-    return;
-  case OP_POP_RETURN_OR_LOCATION:
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_POP_RC, parameter);
-    } else {
-      switch (parameter) {
-      case 0:
-        LOG_INST("POPRET");
-        script->retValue = StackPop(script);
-        break;
-      case 1:
-        LOG_INST("POPLOC");
-        if (script->sp >= STACK_LAST_ENTRY) {
-          // assert(0);
-          script->ip = NULL;
-        } else {
-          script->bp = StackPop(script);
-          script->ip = script->dataPtr->scriptData + StackPop(script);
-        }
-        break;
-      default:
-        script->ip = NULL;
-      }
-    }
-    return;
-  case OP_POP_VARIABLE:
-    LOG_INST("POPVAR 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_POP, parameter);
-    } else {
-      script->regs[parameter] = StackPop(script);
-    }
-    return;
-  case OP_POP_LOCAL_VARIABLE:
-    LOG_INST("POPLOCVAR 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_POP_LOC_VAR, parameter);
-    } else {
-      script->stack[script->bp - parameter - 2] = StackPop(script);
-    }
-    return;
-  case OP_POP_PARAMETER:
-    LOG_INST("POPPARAM 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "POPPARAM %X",
-                              parameter);
-    } else {
-      script->stack[script->bp + parameter - 1] = StackPop(script);
-    }
-    return;
-  case OP_STACK_REWIND:
-    LOG_INST("OP_STACK_REWIND 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_STACK_REWIND, parameter);
-    } else {
-      script->sp += parameter;
-    }
-    return;
-  case OP_STACK_FORWARD:
-    LOG_INST("OP_STACK_FORWARD 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_STACK_FORWARD, parameter);
-    } else {
-      script->sp -= parameter;
-    }
-    return;
-  case OP_FUNCTION:
-    if (interp->disassembler) {
-      emitLineFunctionCall(interp->disassembler, parameter, instOffset);
-    } else {
-      EMCInterpreterExecFunction(interp, script, (uint8_t)parameter);
-    }
-    return;
-  case OP_JUMP_NE:
-    parameter &= 0x7FFF;
-    LOG_INST("JUMP_NE 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_JUMP_NE, parameter);
-    } else {
-      if (!StackPop(script)) {
-        script->ip = script->dataPtr->scriptData + parameter;
-      }
-    }
-    return;
-  case OP_UNARY: {
-    LOG_INST("UNARY 0X%X", parameter);
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, "%s 0X%X",
-                              MNEMONIC_UNARY, parameter);
-    } else {
-      int16_t value = script->stack[script->sp];
-      switch (parameter) {
-      case 0:
-        if (!value)
-          script->stack[script->sp] = 1;
-        else
-          script->stack[script->sp] = 0;
-        break;
-
-      case 1:
-        script->stack[script->sp] = -value;
-        break;
-
-      case 2:
-        script->stack[script->sp] = ~value;
-        break;
-      default:
-        printf("Unknown negation func: %d\n", parameter);
-        script->ip = NULL;
-        assert(0);
-      }
-    }
-  }
-    return;
-  case OP_BINARY: {
-    int16_t val1 = 0;
-    int16_t val2 = 0;
-    if (interp->disassembler == NULL) {
-      val1 = StackPop(script);
-      val2 = StackPop(script);
-    }
-    switch (parameter) {
-    case BinaryOp_LogicalAND:
-      LOG_INST("LogicalAND 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_LOGICAL_AND);
-      } else {
-        StackPush(script, (val2 && val1) ? 1 : 0);
-      }
-
-      return;
-
-    case BinaryOp_LogicalOR:
-      LOG_INST("LogicalOR 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_LOGICAL_OR);
-      } else {
-        StackPush(script, (val2 || val1) ? 1 : 0);
-      }
-      return;
-
-    case BinaryOp_EQUAL:
-      LOG_INST("EQUAL 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_EQUAL);
-      } else {
-        StackPush(script, (val1 == val2) ? 1 : 0);
-      }
-      return;
-
-    case BinaryOp_NotEQUAL:
-      LOG_INST("NOT EQUAL 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_NOT_EQUAL);
-      } else {
-        StackPush(script, (val1 != val2) ? 1 : 0);
-      }
-      return;
-
-    case BinaryOp_Inf:
-      LOG_INST("INF 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset, MNEMONIC_INF);
-      } else {
-        StackPush(script, (val1 > val2) ? 1 : 0);
-      }
-      return;
-
-    case BinaryOp_InfOrEq:
-      LOG_INST("INF_OR_EQ 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_INF_EQ);
-      } else {
-        StackPush(script, (val1 >= val2) ? 1 : 0);
-      }
-      return;
-    case BinaryOp_Greater:
-      LOG_INST("GREATER 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset, MNEMONIC_SUP);
-      } else {
-        StackPush(script, (val1 < val2) ? 1 : 0);
-      }
-      return;
-
-    case BinaryOp_GreaterOrEq:
-      LOG_INST("GREATER_OR_EQ 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_SUP_EQ);
-      } else {
-        StackPush(script, (val1 <= val2) ? 1 : 0);
-      }
-      return;
-
-    case BinaryOp_Add:
-      LOG_INST("ADD 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset, MNEMONIC_ADD);
-      } else {
-        StackPush(script, val1 + val2);
-      }
-      return;
-
-    case BinaryOp_Minus:
-      LOG_INST("MINUS 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_MINUS);
-      } else {
-        StackPush(script, val2 - val1);
-      }
-      return;
-
-    case BinaryOp_Multiply:
-      LOG_INST("MULT 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_MULTIPLY);
-      } else {
-        StackPush(script, val1 * val2);
-      }
-      return;
-
-    case BinaryOp_Divide:
-      LOG_INST("DIV 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_DIVIDE);
-      } else {
-        StackPush(script, val2 / val1);
-      }
-      return;
-
-    case BinaryOp_RShift:
-      LOG_INST("RShift 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_RIGHT_SHIFT);
-      } else {
-        StackPush(script, val2 >> val1);
-      }
-      return;
-
-    case BinaryOp_LShift:
-      LOG_INST("LShift 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset,
-                                MNEMONIC_LEFT_SHIFT);
-      } else {
-        StackPush(script, val2 << val1);
-      }
-      return;
-
-    case BinaryOp_AND:
-      LOG_INST("AND 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset, MNEMONIC_AND);
-      } else {
-        StackPush(script, val1 & val2);
-      }
-      return;
-
-    case BinaryOp_OR:
-      LOG_INST("OR 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset, MNEMONIC_OR);
-      } else {
-        StackPush(script, val1 | val2);
-      }
-      return;
-
-    case BinaryOp_MOD:
-      LOG_INST("MOD 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset, MNEMONIC_MOD);
-      } else {
-        StackPush(script, val1 % val2);
-      }
-      return;
-
-    case BinaryOp_XOR:
-      LOG_INST("XOR 0X%X 0X%X", val1, val2);
-      if (interp->disassembler) {
-        EMCDisassemblerEmitLine(interp->disassembler, instOffset, MNEMONIC_XOR);
-      } else {
-        StackPush(script, val1 ^ val2);
-      }
-      return;
-
-    default:
-      printf("Unknown evaluate func: %d\n", parameter);
-      assert(0);
-    }
-    return;
-  }
-  case OP_RETURN:
-    LOG_INST("RET");
-    if (interp->disassembler) {
-      EMCDisassemblerEmitLine(interp->disassembler, instOffset, MNEMONIC_RET);
-    } else {
-      if (script->sp >= STACK_LAST_ENTRY) {
-        script->ip = NULL;
-        assert(0);
-      } else {
-        script->retValue = StackPop(script);
-        uint16_t temp = StackPop(script);
-        script->stack[STACK_LAST_ENTRY] = 0;
-        script->ip = &script->dataPtr->scriptData[temp];
-      }
-    }
-    return;
-  case OP_LABEL_OFFSET:
-    assert(0); // Implement me :)
-  }
-}
+  Log(LogCategory_Script, "0X%04X :" fmt,                                      \
+      instOffset __VA_OPT__(, ) __VA_ARGS__)
 
 static int setOffset(EMCState *script, uint16_t offset) {
   script->ip = script->dataPtr->scriptData + offset;
@@ -471,6 +33,7 @@ void EMCStateInit(EMCState *scriptState, const INFScript *script) {
   memset(scriptState, 0, sizeof(EMCState));
   scriptState->dataPtr = script;
   scriptState->ip = NULL;
+  scriptState->function = -1;
   scriptState->stack[STACK_LAST_ENTRY] = 0;
   scriptState->bp = STACK_SIZE + 1;
   scriptState->sp = STACK_LAST_ENTRY;
@@ -497,47 +60,420 @@ int EMCStateStart(EMCState *state, int function) {
            (int)state->dataPtr->scriptDataSize / 2);
     return 0;
   }
+  state->function = function;
+  state->functionOffset = functionOffset;
+  // the profiler counts interpreted instructions
+  state->native =
+      EMCProfilerIsEnabled() ? NULL : EMCNativeFind(state->dataPtr);
   return setOffset(state, functionOffset);
 }
 
+size_t EMCStateSerialize(const EMCState *state, uint8_t *buffer, size_t size) {
+  EMCStateHeader header = {0};
+  header.scriptHash = state->dataPtr->hash;
+  header.ip = state->ip ? state->ip - state->dataPtr->scriptData : 0XFFFF;
+  header.function = state->function;
+  header.functionOffset = state->functionOffset;
+  header.retValue = state->retValue;
+  header.bp = state->bp;
+  header.sp = state->sp < STACK_SIZE ? state->sp : STACK_SIZE;
+  memcpy(header.regs, state->regs, sizeof(header.regs));
+
+  size_t stackSize = (STACK_SIZE - header.sp) * sizeof(int16_t);
+  if (size < sizeof(EMCStateHeader) + stackSize) {
+    return 0;
+  }
+  memcpy(buffer, &header, sizeof(EMCStateHeader));
+  memcpy(buffer + sizeof(EMCStateHeader), state->stack + header.sp, stackSize);
+  return sizeof(EMCStateHeader) + stackSize;
+}
+
+int EMCStateDeserialize(EMCState *state, const INFScript *script,
+                        const uint8_t *buffer, size_t size) {
+  EMCStateHeader header;
+  if (size < sizeof(EMCStateHeader)) {
+    return 0;
+  }
+  memcpy(&header, buffer, sizeof(EMCStateHeader));
+  size_t stackSize = (STACK_SIZE - header.sp) * sizeof(int16_t);
+  if (header.scriptHash != script->hash || header.sp > STACK_SIZE ||
+      size < sizeof(EMCStateHeader) + stackSize ||
+      // a yield on the last instruction leaves ip on the END, after it
+      (header.ip != 0XFFFF && header.ip > script->scriptDataSize / 2)) {
+    return 0;
+  }
+  EMCStateInit(state, script);
+  state->ip = header.ip == 0XFFFF ? NULL : script->scriptData + header.ip;
+  state->function = header.function;
+  state->functionOffset = header.functionOffset;
+  state->retValue = header.retValue;
+  state->bp = header.bp;
+  state->sp = header.sp;
+  memcpy(state->regs, header.regs, sizeof(header.regs));
+  memcpy(state->stack + header.sp, buffer + sizeof(EMCStateHeader), stackSize);
+  state->native = EMCProfilerIsEnabled() ? NULL : EMCNativeFind(script);
+  return 1;
+}
+
 int EMCInterpreterIsValid(EMCInterpreter *interp, EMCState *state) {
   if (!state->ip || !state->dataPtr)
     return 0;
   return 1;
 }
 
-int EMCInterpreterRun(EMCInterpreter *interp, EMCState *state) {
-  if (!state->ip) {
+// computed gotos and range initializers are GNU extensions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// Runs the pre-decoded instructions until the script ends, calls a builtin or
+// spends the interpreter's instruction budget, so that the caller can check the
+// game state (eg. a dialog starting) between two slices.
+static int runInstructions(EMCInterpreter *interp, EMCState *script) {
+  static const void *dispatch[INF_NUM_OPCODES + 1] = {
+      [0 ... INF_NUM_OPCODES - 1] = &&op_unknown,
+      [OP_JUMP] = &&op_jump,
+      [OP_SETRETURNVALUE] = &&op_setReturnValue,
+      [OP_PUSH_RETURN_OR_LOCATION] = &&op_pushReturnOrLocation,
+      [OP_PUSH] = &&op_push,
+      [OP_PUSH2] = &&op_push,
+      [OP_PUSH_VARIABLE] = &&op_pushVariable,
+      [OP_PUSH_LOCAL_VARIABLE] = &&op_pushLocalVariable,
+      [OP_PUSH_PARAMETER] = &&op_pushParameter,
+      [OP_POP_RETURN_OR_LOCATION] = &&op_popReturnOrLocation,
+      [OP_POP_VARIABLE] = &&op_popVariable,
+      [OP_POP_LOCAL_VARIABLE] = &&op_popLocalVariable,
+      [OP_POP_PARAMETER] = &&op_popParameter,
+      [OP_STACK_REWIND] = &&op_stackRewind,
+      [OP_STACK_FORWARD] = &&op_stackForward,
+      [OP_FUNCTION] = &&op_function,
+      [OP_JUMP_NE] = &&op_jumpNE,
+      [OP_UNARY] = &&op_unary,
+      [OP_BINARY] = &&op_binary,
+      [OP_RETURN] = &&op_return,
+      [OP_LABEL_OFFSET] = &&op_labelOffset,
+      [INF_OPCODE_END] = &&op_end,
+  };
+  // same handlers, going through op_profile first
+  static const void *profiledDispatch[INF_NUM_OPCODES + 1] = {
+      [0 ... INF_NUM_OPCODES] = &&op_profile,
+  };
+  const INFScript *data = script->dataPtr;
+  const INFInstruction *program = data->instructions;
+  const uint32_t numWords = data->scriptDataSize / 2;
+  const INFInstruction *inst;
+  uint32_t instOffset;
+  uint16_t parameter;
+  uint32_t budget =
+      interp->instructionBudget ? interp->instructionBudget : UINT32_MAX;
+
+  uint32_t target = script->ip - data->scriptData;
+  EMCProfileFunction *profile = EMCProfilerGetFunction(script);
+  const void **table = profile ? profiledDispatch : dispatch;
+
+#define JUMP_TO(offset)                                                        \
+  do {                                                                         \
+    target = (offset);                                                         \
+    goto jump;                                                                 \
+  } while (0)
+// constant targets were checked by the verifier
+#define JUMP_TO_VERIFIED(offset)                                               \
+  do {                                                                         \
+    inst = program + (offset);                                                 \
+    DISPATCH();                                                                \
+  } while (0)
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    if (budget-- == 0) {                                                       \
+      goto yield;                                                              \
+    }                                                                          \
+    instOffset = inst - program;                                               \
+    parameter = inst->param;                                                   \
+    goto *table[inst->opcode];                                                 \
+  } while (0)
+#define NEXT()                                                                 \
+  do {                                                                         \
+    inst += inst->size;                                                        \
+    DISPATCH();                                                                \
+  } while (0)
+
+jump:
+  if (target >= numWords) {
+    printf("Attempt to execute out of bounds: 0x%.08X out of 0x%.08X\n",
+           target, data->scriptDataSize);
+    script->ip = NULL;
     return 0;
   }
+  inst = program + target;
+  DISPATCH();
 
-  const uint32_t instOffset =
-      (ptrdiff_t)(state->ip - state->dataPtr->scriptData);
+yield:
+  // resumes on the next instruction during the next run
+  script->ip = data->scriptData + (inst - program);
+  return 1;
 
-  if ((int32_t)instOffset < 0 ||
-      instOffset >= state->dataPtr->scriptDataSize / 2) {
-    printf("Attempt to execute out of bounds: 0x%.08X out of 0x%.08X\n",
-           instOffset, state->dataPtr->scriptDataSize);
-    state->ip = NULL;
+op_profile:
+  profile->instructions++;
+  if (STACK_LAST_ENTRY - script->sp > (int)profile->maxStackDepth) {
+    profile->maxStackDepth = STACK_LAST_ENTRY - script->sp;
+  }
+  goto *dispatch[inst->opcode];
+
+op_jump:
+  LOG_INST("JUMP 0X%X", parameter);
+  JUMP_TO_VERIFIED(parameter);
+
+op_setReturnValue:
+  LOG_INST("SETRET");
+  script->retValue = parameter;
+  NEXT();
+
+op_pushReturnOrLocation:
+  switch (parameter) {
+  case 0:
+    LOG_INST("PUSHRET 0X%X", script->retValue);
+    StackPush(script, script->retValue);
+    NEXT();
+  case 1:
+    LOG_INST("PUSHRETLOC");
+    StackPush(script, instOffset + inst->size + 1);
+    StackPush(script, script->bp);
+    script->bp = script->sp + 2;
+    NEXT();
+  default:
+    assert(0);
+    script->ip = NULL;
     return 0;
   }
-  uint16_t code = swap_uint16(*state->ip++);
-  uint16_t opcode = (code >> 8) & 0x1F;
-
-  uint16_t parameter = 0;
-  if (code & 0x8000) {
-    opcode = 0;
-    parameter = code & 0x7FFF;
-  } else if (code & 0x4000) {
-    parameter = (int8_t)(code);
-  } else if (code & 0x2000) {
-    parameter = swap_uint16(*state->ip++);
+
+op_push:
+  LOG_INST("PUSH 0X%X", parameter);
+  StackPush(script, parameter);
+  NEXT();
+
+op_pushVariable:
+  LOG_INST("PUSHVAR 0X%X", parameter);
+  StackPush(script, script->regs[parameter]);
+  NEXT();
+
+op_pushLocalVariable:
+  LOG_INST("PUSHLOCVAR 0X%X", parameter);
+  StackPush(script, script->stack[script->bp - parameter - 2]);
+  NEXT();
+
+op_pushParameter:
+  LOG_INST("PUSHPARAM 0X%X", parameter);
+  StackPush(script, script->stack[script->bp + parameter - 1]);
+  NEXT();
+
+op_popReturnOrLocation:
+  switch (parameter) {
+  case 0:
+    LOG_INST("POPRET");
+    script->retValue = StackPop(script);
+    NEXT();
+  case 1:
+    LOG_INST("POPLOC");
+    if (script->sp >= STACK_LAST_ENTRY) {
+      script->ip = NULL;
+      return 0;
+    }
+    script->bp = StackPop(script);
+    JUMP_TO(StackPop(script));
+  default:
+    script->ip = NULL;
+    return 0;
   }
 
-  if (opcode > 18) {
-    printf("Unknown script opcode: %d at offset 0x%.08X\n", opcode, instOffset);
+op_popVariable:
+  LOG_INST("POPVAR 0X%X", parameter);
+  script->regs[parameter] = StackPop(script);
+  NEXT();
+
+op_popLocalVariable:
+  LOG_INST("POPLOCVAR 0X%X", parameter);
+  script->stack[script->bp - parameter - 2] = StackPop(script);
+  NEXT();
+
+op_popParameter:
+  LOG_INST("POPPARAM 0X%X", parameter);
+  script->stack[script->bp + parameter - 1] = StackPop(script);
+  NEXT();
+
+op_stackRewind:
+  LOG_INST("OP_STACK_REWIND 0X%X", parameter);
+  script->sp += parameter;
+  NEXT();
+
+op_stackForward:
+  LOG_INST("OP_STACK_FORWARD 0X%X", parameter);
+  script->sp -= parameter;
+  NEXT();
+
+op_function:
+  // yield point
+  script->ip = data->scriptData + instOffset + inst->size;
+  EMCInterpreterExecFunction(interp, script, (uint8_t)parameter);
+  return 1;
+
+op_jumpNE:
+  parameter &= 0x7FFF;
+  LOG_INST("JUMP_NE 0X%X", parameter);
+  if (!StackPop(script)) {
+    JUMP_TO_VERIFIED(parameter);
+  }
+  NEXT();
+
+op_unary: {
+  LOG_INST("UNARY 0X%X", parameter);
+  int16_t value = script->stack[script->sp];
+  switch (parameter) {
+  case 0:
+    script->stack[script->sp] = value ? 0 : 1;
+    NEXT();
+  case 1:
+    script->stack[script->sp] = -value;
+    NEXT();
+  case 2:
+    script->stack[script->sp] = ~value;
+    NEXT();
+  default:
+    printf("Unknown negation func: %d\n", parameter);
+    script->ip = NULL;
+    assert(0);
+    return 0;
+  }
+}
+
+op_binary: {
+  int16_t val1 = StackPop(script);
+  int16_t val2 = StackPop(script);
+  switch (parameter) {
+  case BinaryOp_LogicalAND:
+    LOG_INST("LogicalAND 0X%X 0X%X", val1, val2);
+    StackPush(script, (val2 && val1) ? 1 : 0);
+    NEXT();
+  case BinaryOp_LogicalOR:
+    LOG_INST("LogicalOR 0X%X 0X%X", val1, val2);
+    StackPush(script, (val2 || val1) ? 1 : 0);
+    NEXT();
+  case BinaryOp_EQUAL:
+    LOG_INST("EQUAL 0X%X 0X%X", val1, val2);
+    StackPush(script, (val1 == val2) ? 1 : 0);
+    NEXT();
+  case BinaryOp_NotEQUAL:
+    LOG_INST("NOT EQUAL 0X%X 0X%X", val1, val2);
+    StackPush(script, (val1 != val2) ? 1 : 0);
+    NEXT();
+  case BinaryOp_Inf:
+    LOG_INST("INF 0X%X 0X%X", val1, val2);
+    StackPush(script, (val1 > val2) ? 1 : 0);
+    NEXT();
+  case BinaryOp_InfOrEq:
+    LOG_INST("INF_OR_EQ 0X%X 0X%X", val1, val2);
+    StackPush(script, (val1 >= val2) ? 1 : 0);
+    NEXT();
+  case BinaryOp_Greater:
+    LOG_INST("GREATER 0X%X 0X%X", val1, val2);
+    StackPush(script, (val1 < val2) ? 1 : 0);
+    NEXT();
+  case BinaryOp_GreaterOrEq:
+    LOG_INST("GREATER_OR_EQ 0X%X 0X%X", val1, val2);
+    StackPush(script, (val1 <= val2) ? 1 : 0);
+    NEXT();
+  case BinaryOp_Add:
+    LOG_INST("ADD 0X%X 0X%X", val1, val2);
+    StackPush(script, val1 + val2);
+    NEXT();
+  case BinaryOp_Minus:
+    LOG_INST("MINUS 0X%X 0X%X", val1, val2);
+    StackPush(script, val2 - val1);
+    NEXT();
+  case BinaryOp_Multiply:
+    LOG_INST("MULT 0X%X 0X%X", val1, val2);
+    StackPush(script, val1 * val2);
+    NEXT();
+  case BinaryOp_Divide:
+    LOG_INST("DIV 0X%X 0X%X", val1, val2);
+    StackPush(script, val2 / val1);
+    NEXT();
+  case BinaryOp_RShift:
+    LOG_INST("RShift 0X%X 0X%X", val1, val2);
+    StackPush(script, val2 >> val1);
+    NEXT();
+  case BinaryOp_LShift:
+    LOG_INST("LShift 0X%X 0X%X", val1, val2);
+    StackPush(script, val2 << val1);
+    NEXT();
+  case BinaryOp_AND:
+    LOG_INST("AND 0X%X 0X%X", val1, val2);
+    StackPush(script, val1 & val2);
+    NEXT();
+  case BinaryOp_OR:
+    LOG_INST("OR 0X%X 0X%X", val1, val2);
+    StackPush(script, val1 | val2);
+    NEXT();
+  case BinaryOp_MOD:
+    LOG_INST("MOD 0X%X 0X%X", val1, val2);
+    StackPush(script, val1 % val2);
+    NEXT();
+  case BinaryOp_XOR:
+    LOG_INST("XOR 0X%X 0X%X", val1, val2);
+    StackPush(script, val1 ^ val2);
+    NEXT();
+  default:
+    printf("Unknown evaluate func: %d\n", parameter);
+    assert(0);
+    NEXT();
+  }
+}
+
+op_return:
+  LOG_INST("RET");
+  if (script->sp >= STACK_LAST_ENTRY) {
+    script->ip = NULL;
+    assert(0);
+    return 0;
   } else {
-    execOpCode(interp, state, opcode, parameter, instOffset);
+    script->retValue = StackPop(script);
+    uint16_t temp = StackPop(script);
+    script->stack[STACK_LAST_ENTRY] = 0;
+    JUMP_TO(temp);
+  }
+
+op_labelOffset:
+  assert(0); // Implement me :)
+  NEXT();
+
+op_unknown:
+  printf("Unknown script opcode: %d at offset 0x%.08X\n", inst->opcode,
+         instOffset);
+  NEXT();
+
+op_end:
+  printf("Attempt to execute out of bounds: 0x%.08X out of 0x%.08X\n",
+         instOffset, data->scriptDataSize);
+  script->ip = NULL;
+  return 0;
+
+#undef JUMP_TO
+#undef JUMP_TO_VERIFIED
+#undef DISPATCH
+#undef NEXT
+}
+
+#pragma GCC diagnostic pop
+
+int EMCInterpreterRun(EMCInterpreter *interp, EMCState *state) {
+  if (!state->ip) {
+    return 0;
+  }
+  if (state->native) {
+    int ret = state->native->run(interp, state);
+    if (ret != EMC_NATIVE_FALLBACK) {
+      return ret;
+    }
+    // the interpreter handles the rest of this function
+    state->native = NULL;
   }
-  return state->ip != NULL;
+  return runInstructions(interp, state);
 }
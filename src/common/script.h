@@ -1,6 +1,6 @@
 #pragma once
 #include "formats/format_inf.h"
-#include "script_disassembler.h"
+#include <stddef.h>
 #include <stdint.h>
 
 // from https://github.com/OpenDUNE/OpenDUNE/blob/master/src/script/script.h
@@ -100,9 +100,14 @@ typedef enum {
 #define STACK_SIZE 100
 #define STACK_LAST_ENTRY STACK_SIZE - 1
 
+typedef struct _EMCNativeScript EMCNativeScript;
+
 typedef struct _EMCState {
   const uint16_t *ip;
   const INFScript *dataPtr;
+  const EMCNativeScript *native; // set by EMCStateStart if compiled in
+  int16_t function; // set by EMCStateStart, -1 before
+  uint16_t functionOffset;
   int16_t retValue;
   uint16_t bp;
   uint16_t sp;
@@ -116,6 +121,28 @@ static inline int16_t EMCStateStackVal(const EMCState *state, uint8_t i) {
 
 const char *EMCStateGetDataString(const EMCState *state, int16_t index);
 
+// compact copy of a state, only the used part of the stack is kept. The script
+// is referenced by its hash.
+typedef struct {
+  uint32_t scriptHash;
+  uint16_t ip; // word offset in scriptData, 0XFFFF once the script is done
+  int16_t function;
+  uint16_t functionOffset;
+  int16_t retValue;
+  uint16_t bp;
+  uint16_t sp;
+  int16_t regs[30];
+} EMCStateHeader;
+
+#define EMC_STATE_SERIALIZED_MAX_SIZE                                          \
+  (sizeof(EMCStateHeader) + STACK_SIZE * sizeof(int16_t))
+
+// returns the number of bytes written, 0 if the buffer is too small
+size_t EMCStateSerialize(const EMCState *state, uint8_t *buffer, size_t size);
+// script must be the one the state was saved from
+int EMCStateDeserialize(EMCState *state, const INFScript *script,
+                        const uint8_t *buffer, size_t size);
+
 typedef enum {
   EMCGlobalVarID_CurrentBlock = 0,
   EMCGlobalVarID_CurrentDir = 1,
@@ -373,11 +400,13 @@ typedef struct _EMCInterpreterCallbacks {
 
 typedef struct _EMCInterpreter {
   INFScript *_scriptData;
-  EMCDisassembler *disassembler;
 
   EMCInterpreterCallbacks callbacks;
   void *callbackCtx;
 
+  // instructions run by EMCInterpreterRun before it returns (jumps taken by
+  // the compiled scripts), 0: no limit
+  uint32_t instructionBudget;
 } EMCInterpreter;
 
 void EMCStateInit(EMCState *scriptState, const INFScript *script);
@@ -1,7 +1,10 @@
 #include "script_builtins.h"
 #include "formats/format_sav.h"
 #include "logger.h"
+#include "profiler.h"
 #include "script.h"
+#include "script_profiler.h"
+#include "script_replay.h"
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -1180,6 +1183,12 @@ void EMCInterpreterExecFunction(EMCInterpreter *interp, EMCState *state,
     printf("unimplemented func %X\n", funcNum);
     assert(0);
   }
-  Log("SCRIPT", "CALL %s", desc.name);
+  Log(LogCategory_Script, "CALL %s", desc.name);
+  uint64_t start = EMCProfilerIsEnabled() ? ProfilerNow() : 0;
+  int replayCall = EMCReplayBeginCall(state, funcNum);
   state->retValue = desc.fun(interp, state);
+  EMCReplayEndCall(replayCall, state->retValue);
+  if (start) {
+    EMCProfilerAddBuiltinCall(funcNum, ProfilerNow() - start);
+  }
 }
@@ -0,0 +1,316 @@
+#include "script_compiler.h"
+#include "logger.h"
+#include "script.h"
+#include <assert.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDENT "      "
+
+typedef struct {
+  const INFScript *script;
+  FILE *out;
+  uint32_t numWords;
+  uint8_t *isInstruction; // instruction starts found by the linear sweep
+  uint8_t *isJumpTarget;  // constant jump targets, they get a C label
+} Compiler;
+
+static const char *binaryExpressions[] = {
+    [BinaryOp_LogicalAND] = "(b && a) ? 1 : 0",
+    [BinaryOp_LogicalOR] = "(b || a) ? 1 : 0",
+    [BinaryOp_EQUAL] = "(a == b) ? 1 : 0",
+    [BinaryOp_NotEQUAL] = "(a != b) ? 1 : 0",
+    [BinaryOp_Inf] = "(a > b) ? 1 : 0",
+    [BinaryOp_InfOrEq] = "(a >= b) ? 1 : 0",
+    [BinaryOp_Greater] = "(a < b) ? 1 : 0",
+    [BinaryOp_GreaterOrEq] = "(a <= b) ? 1 : 0",
+    [BinaryOp_Add] = "a + b",
+    [BinaryOp_Minus] = "b - a",
+    [BinaryOp_Multiply] = "a * b",
+    [BinaryOp_Divide] = "b / a",
+    [BinaryOp_RShift] = "b >> a",
+    [BinaryOp_LShift] = "b << a",
+    [BinaryOp_AND] = "a & b",
+    [BinaryOp_OR] = "a | b",
+    [BinaryOp_MOD] = "a % b",
+    [BinaryOp_XOR] = "a ^ b",
+};
+
+#define NUM_BINARY_OPS (sizeof(binaryExpressions) / sizeof(binaryExpressions[0]))
+
+static int isSet(const uint8_t *bitmap, uint32_t i) {
+  return bitmap[i >> 3] & (1 << (i & 7));
+}
+
+static void set(uint8_t *bitmap, uint32_t i) { bitmap[i >> 3] |= 1 << (i & 7); }
+
+static void sweep(Compiler *comp) {
+  const INFInstruction *program = comp->script->instructions;
+  for (uint32_t offset = 0; offset < comp->numWords;
+       offset += program[offset].size) {
+    const INFInstruction *inst = program + offset;
+    if (inst->opcode == INF_OPCODE_END) {
+      break;
+    }
+    set(comp->isInstruction, offset);
+  }
+  for (uint32_t offset = 0; offset < comp->numWords; offset++) {
+    if (!isSet(comp->isInstruction, offset)) {
+      continue;
+    }
+    const INFInstruction *inst = program + offset;
+    uint16_t target = inst->param;
+    if (inst->opcode == OP_JUMP_NE) {
+      target &= 0x7FFF;
+    } else if (inst->opcode != OP_JUMP) {
+      continue;
+    }
+    if (target < comp->numWords && isSet(comp->isInstruction, target)) {
+      set(comp->isJumpTarget, target);
+    }
+  }
+}
+
+static void emitLine(Compiler *comp, const char *fmt, ...) PRINTFLIKE(2, 3);
+static void emitLine(Compiler *comp, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  fprintf(comp->out, INDENT);
+  vfprintf(comp->out, fmt, args);
+  fprintf(comp->out, "\n");
+  va_end(args);
+}
+
+// leaves the instruction at offset to the interpreter
+static void emitFallback(Compiler *comp, uint32_t offset) {
+  emitLine(comp, "FALLBACK(0x%04X);", offset);
+}
+
+// every loop takes a jump, so the instruction budget is spent on the jumps
+static void emitJump(Compiler *comp, const char *condition, uint16_t target) {
+  emitLine(comp, "%s{", condition);
+  emitLine(comp, "  if (budget-- == 0) {");
+  emitLine(comp, "    YIELD(0x%04X);", target);
+  emitLine(comp, "  }");
+  if (target < comp->numWords && isSet(comp->isJumpTarget, target)) {
+    emitLine(comp, "  goto L_%04X;", target);
+  } else {
+    // the switch falls back to the interpreter for unknown offsets
+    emitLine(comp, "  pc = 0x%04X;", target);
+    emitLine(comp, "  continue;");
+  }
+  emitLine(comp, "}");
+}
+
+static void emitInstruction(Compiler *comp, uint32_t offset) {
+  const INFInstruction *inst = comp->script->instructions + offset;
+  const uint16_t param = inst->param;
+  const uint32_t next = offset + inst->size;
+
+  switch (inst->opcode) {
+  case OP_JUMP:
+    emitJump(comp, "", param);
+    return;
+  case OP_SETRETURNVALUE:
+    emitLine(comp, "s->retValue = (int16_t)0x%04X;", param);
+    return;
+  case OP_PUSH_RETURN_OR_LOCATION:
+    if (param == 0) {
+      emitLine(comp, "EMCNativePush(s, s->retValue);");
+    } else if (param == 1) {
+      emitLine(comp, "EMCNativePush(s, 0x%04X);", next + 1);
+      emitLine(comp, "EMCNativePush(s, s->bp);");
+      emitLine(comp, "s->bp = s->sp + 2;");
+    } else {
+      emitFallback(comp, offset);
+    }
+    return;
+  case OP_PUSH:
+  case OP_PUSH2:
+    emitLine(comp, "EMCNativePush(s, 0x%04X);", param);
+    return;
+  case OP_PUSH_VARIABLE:
+  case OP_POP_VARIABLE:
+    if (param >= sizeof(((EMCState *)0)->regs) / sizeof(int16_t)) {
+      emitFallback(comp, offset);
+    } else if (inst->opcode == OP_PUSH_VARIABLE) {
+      emitLine(comp, "EMCNativePush(s, s->regs[%u]);", param);
+    } else {
+      emitLine(comp, "s->regs[%u] = EMCNativePop(s);", param);
+    }
+    return;
+  case OP_PUSH_LOCAL_VARIABLE:
+    emitLine(comp, "EMCNativePush(s, s->stack[s->bp - %u - 2]);", param);
+    return;
+  case OP_PUSH_PARAMETER:
+    emitLine(comp, "EMCNativePush(s, s->stack[s->bp + %u - 1]);", param);
+    return;
+  case OP_POP_RETURN_OR_LOCATION:
+    if (param == 0) {
+      emitLine(comp, "s->retValue = EMCNativePop(s);");
+    } else if (param == 1) {
+      emitLine(comp, "if (s->sp >= STACK_LAST_ENTRY) {");
+      emitLine(comp, "  s->ip = NULL;");
+      emitLine(comp, "  return 0;");
+      emitLine(comp, "}");
+      emitLine(comp, "s->bp = EMCNativePop(s);");
+      emitLine(comp, "pc = EMCNativePop(s);");
+      emitLine(comp, "continue;");
+    } else {
+      emitFallback(comp, offset);
+    }
+    return;
+  case OP_POP_LOCAL_VARIABLE:
+    emitLine(comp, "s->stack[s->bp - %u - 2] = EMCNativePop(s);", param);
+    return;
+  case OP_POP_PARAMETER:
+    emitLine(comp, "s->stack[s->bp + %u - 1] = EMCNativePop(s);", param);
+    return;
+  case OP_STACK_REWIND:
+    emitLine(comp, "s->sp += %u;", param);
+    return;
+  case OP_STACK_FORWARD:
+    emitLine(comp, "s->sp -= %u;", param);
+    return;
+  case OP_FUNCTION:
+    // same yield point as the interpreter
+    emitLine(comp, "s->ip = s->dataPtr->scriptData + 0x%04X;", next);
+    emitLine(comp, "EMCInterpreterExecFunction(interp, s, 0x%02X);",
+             (uint8_t)param);
+    emitLine(comp, "return 1;");
+    return;
+  case OP_JUMP_NE:
+    emitJump(comp, "if (!EMCNativePop(s)) ", param & 0x7FFF);
+    return;
+  case OP_UNARY:
+    if (param == 0) {
+      emitLine(comp, "s->stack[s->sp] = s->stack[s->sp] ? 0 : 1;");
+    } else if (param == 1) {
+      emitLine(comp, "s->stack[s->sp] = -s->stack[s->sp];");
+    } else if (param == 2) {
+      emitLine(comp, "s->stack[s->sp] = ~s->stack[s->sp];");
+    } else {
+      emitFallback(comp, offset);
+    }
+    return;
+  case OP_BINARY:
+    if (param >= NUM_BINARY_OPS) {
+      emitFallback(comp, offset);
+      return;
+    }
+    emitLine(comp, "{");
+    emitLine(comp, "  int16_t a = EMCNativePop(s);");
+    emitLine(comp, "  int16_t b = EMCNativePop(s);");
+    emitLine(comp, "  EMCNativePush(s, %s);", binaryExpressions[param]);
+    emitLine(comp, "}");
+    return;
+  case OP_RETURN:
+    // let the interpreter deal with a broken stack
+    emitLine(comp, "if (s->sp >= STACK_LAST_ENTRY) {");
+    emitLine(comp, "  FALLBACK(0x%04X);", offset);
+    emitLine(comp, "}");
+    emitLine(comp, "s->retValue = EMCNativePop(s);");
+    emitLine(comp, "pc = EMCNativePop(s);");
+    emitLine(comp, "s->stack[STACK_LAST_ENTRY] = 0;");
+    emitLine(comp, "continue;");
+    return;
+  default:
+    // unknown opcodes, OP_LABEL_OFFSET
+    emitFallback(comp, offset);
+    return;
+  }
+}
+
+static const char *baseName(const char *path) {
+  const char *base = strrchr(path, '/');
+  return base ? base + 1 : path;
+}
+
+static void writeSymbolName(char *dst, size_t size, const char *name) {
+  const char *base = baseName(name);
+  size_t i = 0;
+  for (; base[i] && i < size - 1; i++) {
+    dst[i] = isalnum((unsigned char)base[i]) ? base[i] : '_';
+  }
+  dst[i] = 0;
+}
+
+int EMCCompilerWriteC(const INFScript *script, const char *name, FILE *out) {
+  if (!script->instructions) {
+    printf("EMCCompilerWriteC: no code in '%s'\n", name);
+    return 0;
+  }
+  Compiler comp = {.script = script,
+                   .out = out,
+                   .numWords = script->scriptDataSize / 2};
+  comp.isInstruction = calloc((comp.numWords + 7) / 8, 1);
+  comp.isJumpTarget = calloc((comp.numWords + 7) / 8, 1);
+  assert(comp.isInstruction && comp.isJumpTarget);
+  sweep(&comp);
+
+  char symbol[64];
+  writeSymbolName(symbol, sizeof(symbol), name);
+
+  fprintf(out, "// Generated by 'lol script compile' from %s, do not edit.\n",
+          name);
+  fprintf(out, "#include \"script_builtins.h\"\n");
+  fprintf(out, "#include \"script_native.h\"\n\n");
+  fprintf(out, "#define FALLBACK(offset)                         \\\n"
+               "  do {                                           \\\n"
+               "    s->ip = s->dataPtr->scriptData + (offset);   \\\n"
+               "    return EMC_NATIVE_FALLBACK;                  \\\n"
+               "  } while (0)\n");
+  fprintf(out, "#define YIELD(offset)                            \\\n"
+               "  do {                                           \\\n"
+               "    s->ip = s->dataPtr->scriptData + (offset);   \\\n"
+               "    return 1;                                    \\\n"
+               "  } while (0)\n\n");
+  fprintf(out, "static int run(EMCInterpreter *interp, EMCState *s) {\n");
+  fprintf(out, "  uint32_t pc = s->ip - s->dataPtr->scriptData;\n");
+  fprintf(out, "  uint32_t budget = interp->instructionBudget\n"
+               "                        ? interp->instructionBudget\n"
+               "                        : UINT32_MAX;\n");
+  fprintf(out, "  for (;;) {\n");
+  fprintf(out, "    switch (pc) {\n");
+  uint32_t end = 0; // after the last instruction
+  for (uint32_t offset = 0; offset < comp.numWords; offset++) {
+    if (!isSet(comp.isInstruction, offset)) {
+      continue;
+    }
+    end = offset + script->instructions[offset].size;
+    int function = INFScriptIsOffset(script, offset);
+    if (function != -1) {
+      fprintf(out, "    // function %i\n", function);
+    }
+    fprintf(out, "    case 0x%04X:\n", offset);
+    if (isSet(comp.isJumpTarget, offset)) {
+      fprintf(out, "    L_%04X:\n", offset);
+    }
+    emitInstruction(&comp, offset);
+  }
+  // the last instruction can fall through, to the END of the script
+  emitFallback(&comp, end);
+  fprintf(out, "    default:\n");
+  emitLine(&comp, "FALLBACK(pc);");
+  fprintf(out, "    }\n");
+  fprintf(out, "  }\n");
+  fprintf(out, "}\n\n");
+
+  fprintf(out, "static const EMCNativeScript script = {\n");
+  fprintf(out, "    .name = \"%s\",\n", baseName(name));
+  fprintf(out, "    .hash = 0x%08XU,\n", script->hash);
+  fprintf(out, "    .scriptDataSize = %u,\n", script->scriptDataSize);
+  fprintf(out, "    .run = run,\n");
+  fprintf(out, "};\n\n");
+  fprintf(out,
+          "__attribute__((constructor)) static void register_%s(void) {\n",
+          symbol);
+  fprintf(out, "  EMCNativeRegister(&script);\n");
+  fprintf(out, "}\n");
+
+  free(comp.isInstruction);
+  free(comp.isJumpTarget);
+  return 1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "formats/format_inf.h"
+#include <stdio.h>
+
+// Translates the script bytecode to C, to be linked in the executable (see
+// script_native.h). name is the script file name, eg. 'LEVEL1.INF'.
+int EMCCompilerWriteC(const INFScript *script, const char *name, FILE *out);
@@ -1,4 +1,6 @@
 #include "script_disassembler.h"
+#include "script.h"
+#include "script_builtins.h"
 #include <assert.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -56,3 +58,135 @@ void EMCDisassemblerEmitLine(EMCDisassembler *disasm, uint32_t instOffset,
     disasm->disasmBufferIndex += writtenSize;
   }
 }
+
+static const char *opMnemonics[OP_LABEL_OFFSET] = {
+    [OP_JUMP] = MNEMONIC_JUMP,
+    [OP_SETRETURNVALUE] = MNEMONIC_SETRET,
+    [OP_PUSH_RETURN_OR_LOCATION] = MNEMONIC_PUSH_RC,
+    [OP_PUSH] = MNEMONIC_PUSH,
+    [OP_PUSH2] = MNEMONIC_PUSH,
+    [OP_PUSH_VARIABLE] = MNEMONIC_PUSH_VAR,
+    [OP_PUSH_LOCAL_VARIABLE] = MNEMONIC_PUSH_LOC_VAR,
+    [OP_PUSH_PARAMETER] = MNEMONIC_PUSH_ARG,
+    [OP_POP_RETURN_OR_LOCATION] = MNEMONIC_POP_RC,
+    [OP_POP_VARIABLE] = MNEMONIC_POP,
+    [OP_POP_LOCAL_VARIABLE] = MNEMONIC_POP_LOC_VAR,
+    [OP_POP_PARAMETER] = "POPPARAM",
+    [OP_STACK_REWIND] = MNEMONIC_STACK_REWIND,
+    [OP_STACK_FORWARD] = MNEMONIC_STACK_FORWARD,
+    [OP_FUNCTION] = MNEMONIC_CALL,
+    [OP_JUMP_NE] = MNEMONIC_JUMP_NE,
+    [OP_UNARY] = MNEMONIC_UNARY,
+    [OP_RETURN] = MNEMONIC_RET,
+};
+
+static const char *binaryMnemonics[] = {
+    [BinaryOp_LogicalAND] = MNEMONIC_LOGICAL_AND,
+    [BinaryOp_LogicalOR] = MNEMONIC_LOGICAL_OR,
+    [BinaryOp_EQUAL] = MNEMONIC_EQUAL,
+    [BinaryOp_NotEQUAL] = MNEMONIC_NOT_EQUAL,
+    [BinaryOp_Inf] = MNEMONIC_INF,
+    [BinaryOp_InfOrEq] = MNEMONIC_INF_EQ,
+    [BinaryOp_Greater] = MNEMONIC_SUP,
+    [BinaryOp_GreaterOrEq] = MNEMONIC_SUP_EQ,
+    [BinaryOp_Add] = MNEMONIC_ADD,
+    [BinaryOp_Minus] = MNEMONIC_MINUS,
+    [BinaryOp_Multiply] = MNEMONIC_MULTIPLY,
+    [BinaryOp_Divide] = MNEMONIC_DIVIDE,
+    [BinaryOp_RShift] = MNEMONIC_RIGHT_SHIFT,
+    [BinaryOp_LShift] = MNEMONIC_LEFT_SHIFT,
+    [BinaryOp_AND] = MNEMONIC_AND,
+    [BinaryOp_OR] = MNEMONIC_OR,
+    [BinaryOp_MOD] = MNEMONIC_MOD,
+    [BinaryOp_XOR] = MNEMONIC_XOR,
+};
+
+static void emitLineFunctionCall(EMCDisassembler *disasm, uint16_t funcCode,
+                                 uint32_t instOffset) {
+
+  if (funcCode >= getNumBuiltinFunctions()) {
+    EMCDisassemblerEmitLine(disasm, instOffset, "%s 0X%X", MNEMONIC_CALL,
+                            funcCode);
+    printf("func %X is outside builtins (size=%zx) at offset 0X%X\n", funcCode,
+           getNumBuiltinFunctions(), instOffset);
+    return;
+  }
+  assert(getBuiltinFunctions()[funcCode].name);
+  EMCDisassemblerEmitLine(disasm, instOffset, "%s %s", MNEMONIC_CALL,
+                          getBuiltinFunctions()[funcCode].name);
+}
+
+static void emitInstruction(EMCDisassembler *disasm,
+                            const INFInstruction *inst, uint32_t instOffset) {
+  uint16_t parameter = inst->param;
+  switch (inst->opcode) {
+  case OP_FUNCTION:
+    emitLineFunctionCall(disasm, parameter, instOffset);
+    return;
+  case OP_JUMP_NE:
+    EMCDisassemblerEmitLine(disasm, instOffset, "%s 0X%X", MNEMONIC_JUMP_NE,
+                            parameter & 0x7FFF);
+    return;
+  case OP_RETURN:
+    EMCDisassemblerEmitLine(disasm, instOffset, MNEMONIC_RET);
+    return;
+  case OP_POP_PARAMETER:
+    EMCDisassemblerEmitLine(disasm, instOffset, "POPPARAM %X", parameter);
+    return;
+  case OP_BINARY:
+    if (parameter < sizeof(binaryMnemonics) / sizeof(binaryMnemonics[0])) {
+      EMCDisassemblerEmitLine(disasm, instOffset, "%s",
+                              binaryMnemonics[parameter]);
+    } else {
+      printf("Unknown evaluate func: %d at offset 0X%X\n", parameter,
+             instOffset);
+    }
+    return;
+  default:
+    if (inst->opcode < OP_LABEL_OFFSET) {
+      EMCDisassemblerEmitLine(disasm, instOffset, "%s 0X%X",
+                              opMnemonics[inst->opcode], parameter);
+    } else {
+      printf("Unknown script opcode: %d at offset 0x%.08X\n", inst->opcode,
+             instOffset);
+    }
+    return;
+  }
+}
+
+int EMCDisassemblerRun(EMCDisassembler *disasm, const INFScript *script) {
+  if (!script->instructions) {
+    return 0;
+  }
+  const uint32_t numWords = script->scriptDataSize / 2;
+
+  // function entry points, so that the sweep doesn't have to search the
+  // offset table at each instruction.
+  uint8_t *labels = calloc((numWords + 7) / 8, 1);
+  assert(labels);
+  for (int i = 0; i < INFScriptGetNumFunctions(script); i++) {
+    int offset = INFScriptGetFunctionOffset(script, i);
+    if (offset >= 0 && offset < numWords) {
+      labels[offset >> 3] |= 1 << (offset & 7);
+    }
+  }
+
+  int numInstructions = 0;
+  uint32_t instOffset = 0;
+  while (instOffset < numWords) {
+    const INFInstruction *inst = script->instructions + instOffset;
+    if (inst->opcode == INF_OPCODE_END) {
+      break;
+    }
+    if (labels[instOffset >> 3] & (1 << (instOffset & 7))) {
+      EMCDisassemblerEmitLine(disasm, instOffset, "%s 0X%X",
+                              MNEMONIC_LABEL_OFFSET,
+                              INFScriptIsOffset(script, instOffset));
+    }
+    emitInstruction(disasm, inst, instOffset);
+    instOffset += inst->size;
+    numInstructions++;
+  }
+  free(labels);
+  return numInstructions;
+}
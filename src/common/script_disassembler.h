@@ -1,4 +1,5 @@
 #pragma once
+#include "formats/format_inf.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -19,3 +20,7 @@ void EMCDisassemblerInit(EMCDisassembler *disassembler);
 void EMCDisassemblerRelease(EMCDisassembler *disassembler);
 void EMCDisassemblerEmitLine(EMCDisassembler *disasm, uint32_t instOffset,
                              const char *fmt, ...) PRINTFLIKE(3, 4);
+
+// Disassembles the whole DATA chunk of the script in one linear sweep, without
+// executing it. Returns the number of instructions.
+int EMCDisassemblerRun(EMCDisassembler *disasm, const INFScript *script);
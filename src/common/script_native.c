@@ -0,0 +1,33 @@
+#include "script_native.h"
+#include <assert.h>
+#include <stdio.h>
+
+static struct {
+  const EMCNativeScript *scripts[EMC_NATIVE_MAX_SCRIPTS];
+  int numScripts;
+  int disabled;
+} _registry = {0};
+
+void EMCNativeRegister(const EMCNativeScript *script) {
+  if (_registry.numScripts == EMC_NATIVE_MAX_SCRIPTS) {
+    printf("EMCNativeRegister: no room for '%s'\n", script->name);
+    return;
+  }
+  _registry.scripts[_registry.numScripts++] = script;
+}
+
+const EMCNativeScript *EMCNativeFind(const INFScript *script) {
+  if (_registry.disabled || !script->scriptData) {
+    return NULL;
+  }
+  for (int i = 0; i < _registry.numScripts; i++) {
+    const EMCNativeScript *native = _registry.scripts[i];
+    if (native->hash == script->hash &&
+        native->scriptDataSize == script->scriptDataSize) {
+      return native;
+    }
+  }
+  return NULL;
+}
+
+void EMCNativeSetEnabled(int enabled) { _registry.disabled = !enabled; }
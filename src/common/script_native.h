@@ -0,0 +1,35 @@
+#pragma once
+#include "formats/format_inf.h"
+#include "script.h"
+#include <stdint.h>
+
+// Scripts compiled to C by 'lol script compile'. A generated file registers
+// itself at startup; EMCStateStart then runs the native version of any script
+// whose bytecode hash matches.
+
+// returned by a native run when the interpreter must take over at state->ip
+#define EMC_NATIVE_FALLBACK -1
+
+// same contract as EMCInterpreterRun: returns after each builtin call or once
+// the instruction budget is spent, 0 once the script is done.
+typedef int (*EMCNativeRunFunc)(EMCInterpreter *interp, EMCState *state);
+
+typedef struct _EMCNativeScript {
+  const char *name;
+  uint32_t hash;
+  uint32_t scriptDataSize;
+  EMCNativeRunFunc run;
+} EMCNativeScript;
+
+#define EMC_NATIVE_MAX_SCRIPTS 128
+
+void EMCNativeRegister(const EMCNativeScript *script);
+// returns NULL if the script was not compiled in
+const EMCNativeScript *EMCNativeFind(const INFScript *script);
+void EMCNativeSetEnabled(int enabled);
+
+// used by the generated code
+static inline void EMCNativePush(EMCState *s, uint16_t val) {
+  s->stack[--s->sp] = val;
+}
+static inline uint16_t EMCNativePop(EMCState *s) { return s->stack[s->sp++]; }
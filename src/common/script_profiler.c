@@ -0,0 +1,156 @@
+#include "script_profiler.h"
+#include "script.h"
+#include "script_builtins.h"
+#include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EMC_PROFILER_PREFIX "EMC_PROF"
+#define EMC_PROFILER_MAX_BUILTINS 256
+// lines of the report for the functions
+#define EMC_PROFILER_REPORT_FUNCTIONS 40
+
+typedef struct {
+  uint64_t calls;
+  uint64_t totalNs;
+  uint64_t maxNs;
+} BuiltinStats;
+
+static struct {
+  int enabled;
+  EMCProfileFunction functions[EMC_PROFILER_MAX_FUNCTIONS];
+  uint32_t numFunctions;
+  BuiltinStats builtins[EMC_PROFILER_MAX_BUILTINS];
+} _emcProfiler = {0};
+
+void EMCProfilerSetEnabled(int enabled) { _emcProfiler.enabled = enabled; }
+
+int EMCProfilerIsEnabled(void) { return _emcProfiler.enabled; }
+
+void EMCProfilerReset(void) {
+  int enabled = _emcProfiler.enabled;
+  memset(&_emcProfiler, 0, sizeof(_emcProfiler));
+  _emcProfiler.enabled = enabled;
+}
+
+EMCProfileFunction *EMCProfilerGetFunction(const EMCState *state) {
+  if (!_emcProfiler.enabled) {
+    return NULL;
+  }
+  uint32_t hash = state->dataPtr->hash ? state->dataPtr->hash : 1;
+  // open addressing, the table is never shrunk
+  uint32_t index = (hash ^ ((uint32_t)state->function * 2654435761U)) %
+                   EMC_PROFILER_MAX_FUNCTIONS;
+  for (int i = 0; i < EMC_PROFILER_MAX_FUNCTIONS; i++) {
+    EMCProfileFunction *entry = _emcProfiler.functions + index;
+    if (entry->scriptHash == 0) {
+      entry->scriptHash = hash;
+      entry->function = state->function;
+      entry->offset = state->functionOffset;
+      _emcProfiler.numFunctions++;
+      return entry;
+    }
+    if (entry->scriptHash == hash && entry->function == state->function) {
+      return entry;
+    }
+    index = (index + 1) % EMC_PROFILER_MAX_FUNCTIONS;
+  }
+  return NULL;
+}
+
+void EMCProfilerAddBuiltinCall(uint8_t funcNum, uint64_t durationNs) {
+  BuiltinStats *stats = _emcProfiler.builtins + funcNum;
+  stats->calls++;
+  stats->totalNs += durationNs;
+  if (durationNs > stats->maxNs) {
+    stats->maxNs = durationNs;
+  }
+}
+
+uint64_t EMCProfilerGetTotalInstructions(void) {
+  uint64_t total = 0;
+  for (int i = 0; i < EMC_PROFILER_MAX_FUNCTIONS; i++) {
+    total += _emcProfiler.functions[i].instructions;
+  }
+  return total;
+}
+
+static int compareFunctions(const void *a, const void *b) {
+  const EMCProfileFunction *fa = *(const EMCProfileFunction **)a;
+  const EMCProfileFunction *fb = *(const EMCProfileFunction **)b;
+  if (fa->instructions == fb->instructions) {
+    return 0;
+  }
+  return fa->instructions < fb->instructions ? 1 : -1;
+}
+
+static int compareBuiltins(const void *a, const void *b) {
+  const BuiltinStats *sa = _emcProfiler.builtins + *(const uint8_t *)a;
+  const BuiltinStats *sb = _emcProfiler.builtins + *(const uint8_t *)b;
+  if (sa->totalNs == sb->totalNs) {
+    return 0;
+  }
+  return sa->totalNs < sb->totalNs ? 1 : -1;
+}
+
+static void emit(Logger *output, const char *fmt, ...) PRINTFLIKE(2, 3);
+static void emit(Logger *output, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  output->func(EMC_PROFILER_PREFIX, fmt, args);
+  va_end(args);
+}
+
+void EMCProfilerReport(Logger *output) {
+  assert(output);
+  EMCProfileFunction *sorted[EMC_PROFILER_MAX_FUNCTIONS];
+  uint32_t numFunctions = 0;
+  uint64_t totalInstructions = 0;
+  uint32_t maxStackDepth = 0;
+  for (int i = 0; i < EMC_PROFILER_MAX_FUNCTIONS; i++) {
+    EMCProfileFunction *entry = _emcProfiler.functions + i;
+    if (entry->scriptHash) {
+      sorted[numFunctions++] = entry;
+      totalInstructions += entry->instructions;
+      if (entry->maxStackDepth > maxStackDepth) {
+        maxStackDepth = entry->maxStackDepth;
+      }
+    }
+  }
+  qsort(sorted, numFunctions, sizeof(EMCProfileFunction *), compareFunctions);
+
+  emit(output, "%llu instructions in %u functions, max stack depth %u/%i",
+       (unsigned long long)totalInstructions, numFunctions, maxStackDepth,
+       STACK_SIZE);
+  emit(output, "%12s %10s %8s %6s %5s", "instructions", "script", "function",
+       "offset", "stack");
+  for (uint32_t i = 0;
+       i < numFunctions && i < EMC_PROFILER_REPORT_FUNCTIONS; i++) {
+    const EMCProfileFunction *entry = sorted[i];
+    emit(output, "%12llu 0x%08X %8i 0x%04X %5u",
+         (unsigned long long)entry->instructions, entry->scriptHash,
+         entry->function, entry->offset, entry->maxStackDepth);
+  }
+
+  uint8_t builtins[EMC_PROFILER_MAX_BUILTINS];
+  int numBuiltins = 0;
+  for (int i = 0; i < EMC_PROFILER_MAX_BUILTINS; i++) {
+    if (_emcProfiler.builtins[i].calls) {
+      builtins[numBuiltins++] = i;
+    }
+  }
+  qsort(builtins, numBuiltins, sizeof(uint8_t), compareBuiltins);
+
+  emit(output, "%-24s %8s %10s %10s %10s", "builtin", "calls", "total ms",
+       "avg us", "max us");
+  for (int i = 0; i < numBuiltins; i++) {
+    const BuiltinStats *stats = _emcProfiler.builtins + builtins[i];
+    const char *name = builtins[i] < getNumBuiltinFunctions()
+                           ? getBuiltinFunctions()[builtins[i]].name
+                           : "?";
+    emit(output, "%-24s %8llu %10.3f %10.2f %10.2f", name,
+         (unsigned long long)stats->calls, stats->totalNs / 1000000.,
+         stats->totalNs / 1000. / stats->calls, stats->maxNs / 1000.);
+  }
+}
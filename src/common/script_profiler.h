@@ -0,0 +1,31 @@
+#pragma once
+#include "logger.h"
+#include <stdint.h>
+
+// Opt-in EMC profiling: instructions executed per script function, calls and
+// time spent in each builtin, and stack depth. Scripts compiled to C are
+// interpreted while the profiler is enabled so that every instruction counts.
+
+#define EMC_PROFILER_MAX_FUNCTIONS 512
+
+typedef struct {
+  uint32_t scriptHash; // 0 for an unused entry
+  int16_t function;    // -1 when the state was not started on a function
+  uint16_t offset;
+  uint64_t instructions;
+  uint32_t maxStackDepth;
+} EMCProfileFunction;
+
+typedef struct _EMCState EMCState;
+
+void EMCProfilerSetEnabled(int enabled);
+int EMCProfilerIsEnabled(void);
+void EMCProfilerReset(void);
+
+// NULL if disabled or the table is full
+EMCProfileFunction *EMCProfilerGetFunction(const EMCState *state);
+void EMCProfilerAddBuiltinCall(uint8_t funcNum, uint64_t durationNs);
+uint64_t EMCProfilerGetTotalInstructions(void);
+
+// functions sorted by instruction count, builtins by time
+void EMCProfilerReport(Logger *output);
@@ -0,0 +1,184 @@
+#include "script_replay.h"
+#include "script_builtins.h"
+#include "script_profiler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint32_t dataOffset; // of the state snapshot
+  int16_t retValue;
+  uint8_t funcNum;
+} ReplayCall;
+
+typedef struct {
+  uint32_t scriptHash; // 0 for an unused entry
+  uint32_t scriptDataSize;
+
+  ReplayCall *calls;
+  uint32_t numCalls;
+  uint32_t callsCapacity;
+
+  uint8_t *data;
+  size_t dataSize;
+  size_t dataCapacity;
+} ReplayLog;
+
+static struct {
+  int disabled;
+  ReplayLog logs[EMC_REPLAY_MAX_SCRIPTS];
+  uint32_t nextEvicted;
+  const ReplayLog *replaying;
+
+  const INFScript *recordedScript;
+  ReplayLog recording;
+  int recordingFailed;
+} _replay = {0};
+
+static void releaseLog(ReplayLog *log) {
+  free(log->calls);
+  free(log->data);
+  memset(log, 0, sizeof(ReplayLog));
+}
+
+static ReplayLog *findLog(const INFScript *script) {
+  for (int i = 0; i < EMC_REPLAY_MAX_SCRIPTS; i++) {
+    ReplayLog *log = _replay.logs + i;
+    if (log->scriptHash && log->scriptHash == script->hash &&
+        log->scriptDataSize == script->scriptDataSize) {
+      return log;
+    }
+  }
+  return NULL;
+}
+
+void EMCReplaySetEnabled(int enabled) { _replay.disabled = !enabled; }
+
+void EMCReplayClear(void) {
+  assert(_replay.replaying == NULL);
+  for (int i = 0; i < EMC_REPLAY_MAX_SCRIPTS; i++) {
+    releaseLog(_replay.logs + i);
+  }
+}
+
+int EMCReplayStartRecording(const INFScript *script) {
+  if (_replay.disabled || _replay.recordedScript || script->hash == 0 ||
+      findLog(script)) {
+    return 0;
+  }
+  _replay.recordedScript = script;
+  _replay.recordingFailed = 0;
+  _replay.recording.scriptHash = script->hash;
+  _replay.recording.scriptDataSize = script->scriptDataSize;
+  return 1;
+}
+
+void EMCReplayStopRecording(const INFScript *script) {
+  if (_replay.recordedScript != script) {
+    return;
+  }
+  _replay.recordedScript = NULL;
+  if (_replay.recordingFailed) {
+    releaseLog(&_replay.recording);
+    return;
+  }
+  ReplayLog *dest = NULL;
+  for (int i = 0; i < EMC_REPLAY_MAX_SCRIPTS && !dest; i++) {
+    if (_replay.logs[i].scriptHash == 0) {
+      dest = _replay.logs + i;
+    }
+  }
+  while (!dest) {
+    ReplayLog *log =
+        _replay.logs + (_replay.nextEvicted++ % EMC_REPLAY_MAX_SCRIPTS);
+    if (log != _replay.replaying) {
+      releaseLog(log);
+      dest = log;
+    }
+  }
+  *dest = _replay.recording;
+  memset(&_replay.recording, 0, sizeof(ReplayLog));
+}
+
+static int reserve(ReplayLog *log) {
+  if (log->numCalls == log->callsCapacity) {
+    uint32_t capacity = log->callsCapacity ? log->callsCapacity * 2 : 64;
+    ReplayCall *calls = realloc(log->calls, capacity * sizeof(ReplayCall));
+    if (!calls) {
+      return 0;
+    }
+    log->calls = calls;
+    log->callsCapacity = capacity;
+  }
+  if (log->dataSize + EMC_STATE_SERIALIZED_MAX_SIZE > log->dataCapacity) {
+    size_t capacity = log->dataCapacity ? log->dataCapacity * 2 : 8192;
+    uint8_t *data = realloc(log->data, capacity);
+    if (!data) {
+      return 0;
+    }
+    log->data = data;
+    log->dataCapacity = capacity;
+  }
+  return 1;
+}
+
+int EMCReplayBeginCall(const EMCState *state, uint8_t funcNum) {
+  if (!_replay.recordedScript || state->dataPtr != _replay.recordedScript ||
+      _replay.recordingFailed) {
+    return -1;
+  }
+  ReplayLog *log = &_replay.recording;
+  if (!reserve(log)) {
+    printf("EMCReplay: out of memory, script 0X%08X not recorded\n",
+           log->scriptHash);
+    _replay.recordingFailed = 1;
+    return -1;
+  }
+  ReplayCall *call = log->calls + log->numCalls;
+  call->dataOffset = log->dataSize;
+  call->funcNum = funcNum;
+  call->retValue = 0;
+  log->dataSize += EMCStateSerialize(state, log->data + log->dataSize,
+                                     log->dataCapacity - log->dataSize);
+  return log->numCalls++;
+}
+
+void EMCReplayEndCall(int call, int16_t retValue) {
+  if (call < 0 || !_replay.recordedScript) {
+    return;
+  }
+  assert(call < _replay.recording.numCalls);
+  _replay.recording.calls[call].retValue = retValue;
+}
+
+EMCReplayResult EMCReplayRun(EMCInterpreter *interp, EMCState *state) {
+  // the profiler counts interpreted instructions
+  if (_replay.disabled || EMCProfilerIsEnabled() || _replay.replaying) {
+    return EMCReplayResult_NotCached;
+  }
+  const INFScript *script = state->dataPtr;
+  ReplayLog *log = findLog(script);
+  if (!log) {
+    return EMCReplayResult_NotCached;
+  }
+  _replay.replaying = log;
+  EMCReplayResult result = EMCReplayResult_Done;
+  for (uint32_t i = 0; i < log->numCalls; i++) {
+    const ReplayCall *call = log->calls + i;
+    int ok = EMCStateDeserialize(state, script, log->data + call->dataOffset,
+                                 log->dataSize - call->dataOffset);
+    assert(ok);
+    EMCInterpreterExecFunction(interp, state, call->funcNum);
+    if (state->retValue != call->retValue) {
+      // recorded again on the next run
+      result = EMCReplayResult_Diverged;
+      break;
+    }
+  }
+  _replay.replaying = NULL;
+  if (result == EMCReplayResult_Diverged) {
+    releaseLog(log);
+  }
+  return result;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "script.h"
+#include <stdint.h>
+
+// Init scripts (level INI, ONETIME.INF) run the same code each time: the game
+// state only changes through their builtin calls. The first run records a
+// snapshot of the state before each builtin call; the next runs of a script
+// with the same hash restore the snapshots and call the builtins without
+// interpreting the code in between.
+// A builtin returning another value than in the recording (eg. a game flag
+// that changed) stops the replay, the caller then interprets the rest.
+
+#define EMC_REPLAY_MAX_SCRIPTS 32
+
+typedef enum {
+  EMCReplayResult_NotCached = 0, // nothing was run
+  EMCReplayResult_Done,
+  // state is right after the builtin call, in function state->function
+  EMCReplayResult_Diverged,
+} EMCReplayResult;
+
+void EMCReplaySetEnabled(int enabled);
+void EMCReplayClear(void);
+
+// records the builtin calls made with the script. Returns 0 if another script
+// is being recorded or the script is already cached.
+int EMCReplayStartRecording(const INFScript *script);
+// the script must have run from start to end
+void EMCReplayStopRecording(const INFScript *script);
+
+// used by EMCInterpreterExecFunction, returns -1 when not recording
+int EMCReplayBeginCall(const EMCState *state, uint8_t funcNum);
+void EMCReplayEndCall(int call, int16_t retValue);
+
+// state must be initialized on the script
+EMCReplayResult EMCReplayRun(EMCInterpreter *interp, EMCState *state);
@@ -0,0 +1,124 @@
+#include "script_scheduler.h"
+#include "profiler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+void EMCSchedulerInit(EMCScheduler *sched, uint32_t budgetUs) {
+  memset(sched, 0, sizeof(EMCScheduler));
+  sched->budgetNs = (uint64_t)budgetUs * 1000;
+}
+
+EMCState *EMCSchedulerSpawn(EMCScheduler *sched, EMCTaskKind kind,
+                            const INFScript *script, int function) {
+  assert(kind > EMCTaskKind_None && kind < EMCTaskKind_Count);
+  for (int i = 0; i < EMC_SCHEDULER_MAX_TASKS; i++) {
+    EMCTask *task = sched->tasks + i;
+    if (task->kind != EMCTaskKind_None || task == sched->running) {
+      continue;
+    }
+    EMCStateInit(&task->state, script);
+    if (!EMCStateStart(&task->state, function)) {
+      printf("EMCSchedulerSpawn: invalid function %i\n", function);
+      return NULL;
+    }
+    task->kind = kind;
+    task->slices = 0;
+    return &task->state;
+  }
+  printf("EMCSchedulerSpawn: no free slot for function %i\n", function);
+  return NULL;
+}
+
+// the task can be running a builtin, only its state is cleared
+static void killTask(EMCTask *task) {
+  task->kind = EMCTaskKind_None;
+  task->state.ip = NULL;
+}
+
+void EMCSchedulerKill(EMCScheduler *sched, EMCTaskKind kind) {
+  for (int i = 0; i < EMC_SCHEDULER_MAX_TASKS; i++) {
+    if (sched->tasks[i].kind == kind) {
+      killTask(sched->tasks + i);
+    }
+  }
+}
+
+void EMCSchedulerKillScript(EMCScheduler *sched, const INFScript *script) {
+  for (int i = 0; i < EMC_SCHEDULER_MAX_TASKS; i++) {
+    if (sched->tasks[i].kind != EMCTaskKind_None &&
+        sched->tasks[i].state.dataPtr == script) {
+      killTask(sched->tasks + i);
+    }
+  }
+}
+
+int EMCSchedulerHasTasks(const EMCScheduler *sched, EMCTaskKind kind) {
+  for (int i = 0; i < EMC_SCHEDULER_MAX_TASKS; i++) {
+    if (sched->tasks[i].kind == kind) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void EMCSchedulerYield(EMCScheduler *sched) { sched->yieldRequested = 1; }
+
+int EMCSchedulerRunFrame(EMCScheduler *sched, EMCInterpreter *interp) {
+  uint64_t start = ProfilerNow();
+  uint32_t slices = 0;
+  sched->yieldRequested = 0;
+  for (;;) {
+    int alive = 0;
+    for (int n = 0; n < EMC_SCHEDULER_MAX_TASKS; n++) {
+      EMCTask *task = sched->tasks + sched->next;
+      sched->next = (sched->next + 1) % EMC_SCHEDULER_MAX_TASKS;
+      if (task->kind == EMCTaskKind_None) {
+        continue;
+      }
+      if (!EMCInterpreterIsValid(interp, &task->state)) {
+        task->kind = EMCTaskKind_None;
+        continue;
+      }
+      sched->running = task;
+      uint32_t budget = interp->instructionBudget;
+      interp->instructionBudget = EMC_SCHEDULER_SLICE_INSTRUCTIONS;
+      EMCInterpreterRun(interp, &task->state);
+      interp->instructionBudget = budget;
+      sched->running = NULL;
+      task->slices++;
+      slices++;
+      if (task->kind == EMCTaskKind_None) {
+        // killed by the builtin it just ran
+        continue;
+      }
+      if (!EMCInterpreterIsValid(interp, &task->state)) {
+        task->kind = EMCTaskKind_None;
+        continue;
+      }
+      alive++;
+      if (sched->yieldRequested) {
+        goto done;
+      }
+    }
+    if (alive == 0) {
+      break;
+    }
+    if (sched->budgetNs && ProfilerNow() - start >= sched->budgetNs) {
+      sched->framesOverBudget++;
+      break;
+    }
+    if (sched->maxSlices && slices >= sched->maxSlices) {
+      break;
+    }
+  }
+
+done:
+  sched->lastSlices = slices;
+  sched->lastDurationNs = ProfilerNow() - start;
+  int alive = 0;
+  for (int i = 0; i < EMC_SCHEDULER_MAX_TASKS; i++) {
+    alive += sched->tasks[i].kind != EMCTaskKind_None;
+  }
+  return alive;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "script.h"
+#include <stdint.h>
+
+// Time slicer for the EMC scripts that run over several frames, the block
+// scripts for now (item scripts are run synchronously by their builtins). A
+// slice ends after a builtin call or EMC_SCHEDULER_SLICE_INSTRUCTIONS
+// instructions, the scheduler runs the tasks slice by slice until they are all
+// done or the frame budget is spent.
+
+#define EMC_SCHEDULER_MAX_TASKS 16
+
+// default time budget for the scripts in a frame
+#define EMC_SCHEDULER_DEFAULT_BUDGET_US 4000
+
+// keeps a loop without builtin calls from holding the frame
+#define EMC_SCHEDULER_SLICE_INSTRUCTIONS 1000
+
+typedef enum {
+  EMCTaskKind_None = 0,
+  EMCTaskKind_Block,
+
+  EMCTaskKind_Count,
+} EMCTaskKind;
+
+typedef struct {
+  EMCTaskKind kind; // EMCTaskKind_None for a free slot
+  EMCState state;
+  uint32_t slices;
+} EMCTask;
+
+typedef struct {
+  EMCTask tasks[EMC_SCHEDULER_MAX_TASKS];
+  int next; // round robin position
+  // its slot is not reused until its slice returns, a builtin can kill it
+  const EMCTask *running;
+  uint64_t budgetNs;
+  uint32_t maxSlices; // per frame, 0: no limit
+  int yieldRequested;
+
+  // last frame
+  uint32_t lastSlices;
+  uint64_t lastDurationNs;
+  uint32_t framesOverBudget;
+} EMCScheduler;
+
+void EMCSchedulerInit(EMCScheduler *sched, uint32_t budgetUs);
+
+// returns the started state so that the caller can set its registers, NULL if
+// the function is invalid or all the slots are taken.
+EMCState *EMCSchedulerSpawn(EMCScheduler *sched, EMCTaskKind kind,
+                            const INFScript *script, int function);
+
+void EMCSchedulerKill(EMCScheduler *sched, EMCTaskKind kind);
+// kills the tasks running the script, before it gets released
+void EMCSchedulerKillScript(EMCScheduler *sched, const INFScript *script);
+int EMCSchedulerHasTasks(const EMCScheduler *sched, EMCTaskKind kind);
+
+// ends the current frame for all the tasks, can be called from a builtin
+// (dialog, TIM animation, ...).
+void EMCSchedulerYield(EMCScheduler *sched);
+
+// returns the number of tasks still alive
+int EMCSchedulerRunFrame(EMCScheduler *sched, EMCInterpreter *interp);
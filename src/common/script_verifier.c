@@ -0,0 +1,274 @@
+#include "script_verifier.h"
+#include "logger.h"
+#include "script.h"
+#include "script_builtins.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_REGS (sizeof(((EMCState *)0)->regs) / sizeof(int16_t))
+#define NUM_UNARY_OPS 3
+#define NUM_BINARY_OPS (BinaryOp_XOR + 1)
+
+#define UNVISITED INT32_MIN
+#define VERIFY_ERROR -1
+
+typedef enum {
+  ProcState_Unvisited = 0,
+  ProcState_InProgress,
+  ProcState_Done,
+} ProcState;
+
+typedef struct {
+  const INFInstruction *program;
+  uint32_t numWords;
+  // subroutines, indexed by their entry offset
+  uint8_t *procState;
+  uint16_t *procDepth;
+  EMCVerifierResult *result;
+} Verifier;
+
+static int32_t fail(Verifier *v, uint32_t offset, const char *fmt, ...)
+    PRINTFLIKE(3, 4);
+static int32_t fail(Verifier *v, uint32_t offset, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  v->result->offset = offset;
+  vsnprintf(v->result->error, sizeof(v->result->error), fmt, args);
+  va_end(args);
+  return VERIFY_ERROR;
+}
+
+// the interpreter jumps without checking the target, END stops the script
+static void clampJumps(INFScript *script, uint32_t numWords) {
+  for (uint32_t i = 0; i < numWords; i++) {
+    INFInstruction *inst = script->instructions + i;
+    if (inst->opcode == OP_JUMP && inst->param >= numWords) {
+      inst->param = numWords;
+    } else if (inst->opcode == OP_JUMP_NE &&
+               (inst->param & 0x7FFF) >= numWords) {
+      inst->param = numWords;
+    }
+  }
+}
+
+typedef struct {
+  int32_t *depths; // stack depth at each offset, relative to the entry
+  uint32_t *work;
+  uint32_t numWork;
+  int growing;
+} Walk;
+
+static void propagate(Walk *walk, uint32_t numWords, uint32_t offset,
+                      int32_t depth) {
+  if (offset >= numWords) {
+    return; // END
+  }
+  if (walk->depths[offset] == UNVISITED) {
+    walk->depths[offset] = depth;
+    walk->work[walk->numWork++] = offset;
+  } else if (depth > walk->depths[offset]) {
+    // a loop pushing more than it pops
+    walk->growing = 1;
+  }
+}
+
+static int32_t analyze(Verifier *v, uint32_t entry);
+
+// returns the max depth reached by the code starting at entry, relative to the
+// entry. Calls (PUSHRC 1 followed by a JUMP) are walked as separate
+// subroutines, the caller resumes after the JUMP with the same depth.
+static int32_t walkCode(Verifier *v, uint32_t entry, Walk *walk) {
+  const uint32_t numWords = v->numWords;
+  int32_t maxDepth = 0;
+  int unknown = 0;
+  propagate(walk, numWords, entry, 0);
+  while (walk->numWork) {
+    uint32_t offset = walk->work[--walk->numWork];
+    const INFInstruction *inst = v->program + offset;
+    const uint16_t param = inst->param;
+    const uint32_t next = offset + inst->size;
+    int32_t depth = walk->depths[offset];
+
+    switch (inst->opcode) {
+    case OP_JUMP:
+      propagate(walk, numWords, param, depth);
+      continue;
+    case OP_SETRETURNVALUE:
+      break;
+    case OP_PUSH_RETURN_OR_LOCATION:
+      if (param == 0) {
+        depth++;
+      } else if (param == 1) {
+        const INFInstruction *jump = v->program + next;
+        if (next < numWords && jump->opcode == OP_JUMP && jump->size == 1 &&
+            jump->param < numWords) {
+          int32_t sub = analyze(v, jump->param);
+          if (sub == VERIFY_ERROR) {
+            return VERIFY_ERROR;
+          }
+          if (sub == EMC_VERIFIER_UNKNOWN_DEPTH) {
+            unknown = 1;
+          } else if (depth + 2 + sub > maxDepth) {
+            maxDepth = depth + 2 + sub;
+          }
+          propagate(walk, numWords, next + 1, depth);
+          continue;
+        }
+        depth += 2;
+      } else {
+        return fail(v, offset, "invalid PUSHRC parameter %i", param);
+      }
+      break;
+    case OP_PUSH:
+    case OP_PUSH2:
+    case OP_PUSH_LOCAL_VARIABLE:
+    case OP_PUSH_PARAMETER:
+      depth++;
+      break;
+    case OP_PUSH_VARIABLE:
+      if (param >= NUM_REGS) {
+        return fail(v, offset, "invalid register %i", param);
+      }
+      depth++;
+      break;
+    case OP_POP_RETURN_OR_LOCATION:
+      if (param == 0) {
+        depth--;
+      } else if (param == 1) {
+        continue; // return to the caller
+      } else {
+        return fail(v, offset, "invalid POPRC parameter %i", param);
+      }
+      break;
+    case OP_POP_VARIABLE:
+      if (param >= NUM_REGS) {
+        return fail(v, offset, "invalid register %i", param);
+      }
+      depth--;
+      break;
+    case OP_POP_LOCAL_VARIABLE:
+    case OP_POP_PARAMETER:
+      depth--;
+      break;
+    case OP_STACK_REWIND:
+      depth -= (int16_t)param;
+      break;
+    case OP_STACK_FORWARD:
+      depth += (int16_t)param;
+      break;
+    case OP_FUNCTION: {
+      // the builtins not implemented yet are left to the runtime assert: the
+      // calls are often in branches that don't run
+      uint8_t funcNum = (uint8_t)param;
+      if (funcNum >= getNumBuiltinFunctions()) {
+        return fail(v, offset, "invalid builtin 0X%X", funcNum);
+      }
+      break;
+    }
+    case OP_JUMP_NE:
+      depth--;
+      propagate(walk, numWords, param & 0x7FFF, depth);
+      break;
+    case OP_UNARY:
+      if (param >= NUM_UNARY_OPS) {
+        return fail(v, offset, "invalid unary operation %i", param);
+      }
+      break;
+    case OP_BINARY:
+      if (param >= NUM_BINARY_OPS) {
+        return fail(v, offset, "invalid binary operation %i", param);
+      }
+      depth--;
+      break;
+    case OP_RETURN:
+      continue;
+    case INF_OPCODE_END:
+      continue;
+    default:
+      return fail(v, offset, "invalid opcode 0X%X", inst->opcode);
+    }
+    if (depth > maxDepth) {
+      maxDepth = depth;
+    }
+    propagate(walk, numWords, next, depth);
+  }
+  if (unknown || walk->growing) {
+    return EMC_VERIFIER_UNKNOWN_DEPTH;
+  }
+  return maxDepth;
+}
+
+static int32_t analyze(Verifier *v, uint32_t entry) {
+  switch (v->procState[entry]) {
+  case ProcState_Done:
+    return v->procDepth[entry];
+  case ProcState_InProgress:
+    return EMC_VERIFIER_UNKNOWN_DEPTH; // recursive call
+  default:
+    break;
+  }
+  v->procState[entry] = ProcState_InProgress;
+
+  Walk walk = {0};
+  walk.depths = malloc(v->numWords * sizeof(int32_t));
+  walk.work = malloc(v->numWords * sizeof(uint32_t));
+  if (!walk.depths || !walk.work) {
+    free(walk.depths);
+    free(walk.work);
+    return fail(v, entry, "out of memory");
+  }
+  for (uint32_t i = 0; i < v->numWords; i++) {
+    walk.depths[i] = UNVISITED;
+  }
+  int32_t depth = walkCode(v, entry, &walk);
+  free(walk.depths);
+  free(walk.work);
+  if (depth == VERIFY_ERROR) {
+    return VERIFY_ERROR;
+  }
+  if (depth > EMC_VERIFIER_UNKNOWN_DEPTH) {
+    depth = EMC_VERIFIER_UNKNOWN_DEPTH;
+  }
+  v->procState[entry] = ProcState_Done;
+  v->procDepth[entry] = depth;
+  return depth;
+}
+
+int EMCVerifierRun(INFScript *script, EMCVerifierResult *result) {
+  const uint32_t numWords = script->scriptDataSize / 2;
+  result->offset = 0;
+  result->error[0] = 0;
+  clampJumps(script, numWords);
+
+  script->maxStackDepths = calloc(script->numOffsets + 1, sizeof(uint16_t));
+  Verifier v = {.program = script->instructions,
+                .numWords = numWords,
+                .procState = calloc(numWords + 1, sizeof(uint8_t)),
+                .procDepth = calloc(numWords + 1, sizeof(uint16_t)),
+                .result = result};
+  int ok = script->maxStackDepths && v.procState && v.procDepth;
+  if (!ok) {
+    fail(&v, 0, "out of memory");
+  }
+  for (int i = 0; ok && i < INFScriptGetNumFunctions(script); i++) {
+    int offset = INFScriptGetFunctionOffset(script, i);
+    // same entry as EMCStateStart
+    if (offset < 0 || offset == 0XFFFF || (uint32_t)offset + 1 >= numWords) {
+      continue;
+    }
+    int32_t depth = analyze(&v, offset + 1);
+    if (depth == VERIFY_ERROR) {
+      ok = 0;
+    } else if (depth != EMC_VERIFIER_UNKNOWN_DEPTH &&
+               depth > STACK_LAST_ENTRY) {
+      fail(&v, offset + 1, "function %i needs %i stack entries", i, depth);
+      ok = 0;
+    } else {
+      script->maxStackDepths[i] = depth;
+    }
+  }
+  free(v.procState);
+  free(v.procDepth);
+  return ok;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "formats/format_inf.h"
+#include <stdint.h>
+
+// Static checks of the EMC bytecode, run once by INFScriptFromBuffer. The code
+// reachable from the function entries must only use known opcodes, registers
+// and builtins, and must not overflow the stack. The interpreter relies on it
+// to skip these checks at runtime.
+// Constant jumps past the end of the code (a common way to end a function)
+// are redirected to the END instruction.
+
+// recursive or growing stack, the depth can't be computed
+#define EMC_VERIFIER_UNKNOWN_DEPTH 0XFFFF
+
+typedef struct {
+  uint32_t offset; // of the faulty instruction
+  char error[64];
+} EMCVerifierResult;
+
+// fills script->maxStackDepths, returns 0 if the script is rejected
+int EMCVerifierRun(INFScript *script, EMCVerifierResult *result);
@@ -1,25 +1,10 @@
 #include "tim_interpreter.h"
+#include "tracer.h"
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
-#define TIM_START_OFFSET 1
-
-typedef enum {
-  TIM_COMMAND_ID_STOP_ALL_FUNCS = 0X01,
-  TIM_COMMAND_ID_WSA_INIT = 0X02,
-  TIM_COMMAND_ID_WSA_RELEASE = 0X03,
-  TIM_COMMAND_ID_WSA_DISPLAY_FRAME = 0X06,
-  TIM_COMMAND_UNUSED_7 = 0X07,
-  TIM_COMMAND_ID_CONTINUE_LOOP = 0X15,
-  TIM_COMMAND_ID_RESET_ALL_RUNTIMES = 0X17,
-  TIM_COMMAND_ID_CMD_RETURN_1 = 0X18,
-  TIM_COMMAND_ID_EXEC_OPCODE = 0X19,
-  TIM_COMMAND_ID_PROCESS_DIALOGUE = 0X1C,
-  TIM_COMMAND_ID_DIALOG_BOX = 0X1D,
-  TIM_COMMAND_SET_LOOP_IP = 0X14,
-} TIM_COMMAND_ID;
 #if 0
 static const char *timCommandsName(uint8_t code) {
   switch ((TIM_COMMAND_ID)code) {
@@ -69,13 +54,6 @@ typedef enum {
   TIM_OPCODE_PLAY_SOUND_FX = 0X0E,
 } TIM_OPCODE;
 
-typedef struct {
-  uint16_t len;
-  uint16_t duration;
-  uint8_t instrCode;
-  uint8_t _unused;
-} TImInstruction;
-
 void TIMInterpreterInit(TIMInterpreter *interp) {
   memset(interp, 0, sizeof(TIMInterpreter));
   interp->loopStartPos = -1;
@@ -84,7 +62,7 @@ void TIMInterpreterInit(TIMInterpreter *interp) {
 void TIMInterpreterStart(TIMInterpreter *interp, const TIMHandle *tim) {
   interp->loopStartPos = -1;
   interp->_tim = tim;
-  interp->pos = TIM_START_OFFSET;
+  interp->pos = 0;
 }
 
 static void processOpCode(TIMInterpreter *interp, const uint16_t *params,
@@ -159,17 +137,15 @@ static void processOpCode(TIMInterpreter *interp, const uint16_t *params,
   assert(0);
 }
 
-static int processInstruction(TIMInterpreter *interp, uint16_t *buffer,
-                              size_t pos) {
-  const TImInstruction *instr = (const TImInstruction *)buffer;
-  const uint16_t *instrParams = buffer + 3;
-  int numParams =
-      instr->len - 3; // 3 is size of minimum instruction size w/o params
+static void processInstruction(TIMInterpreter *interp, const TIMEvent *instr,
+                               size_t pos) {
+  const uint16_t *instrParams = instr->params;
+  int numParams = instr->numParams;
 
   /*
-  printf("0X%zX Instruction dur=0X%X len=%i code=%02X %s  %i params: ", pos,
-         instr->duration, instr->len, instr->instrCode,
-         timCommandsName(instr->instrCode), numParams);
+  printf("0X%X Instruction dur=0X%X code=%02X %s  %i params: ", instr->pos,
+         instr->duration, instr->instrCode, timCommandsName(instr->instrCode),
+         numParams);
 
   for (int i = 0; i < numParams; i++) {
     printf(" 0X%X ", instrParams[i]);
@@ -181,7 +157,7 @@ static int processInstruction(TIMInterpreter *interp, uint16_t *buffer,
   switch ((TIM_COMMAND_ID)instr->instrCode) {
   case TIM_COMMAND_ID_STOP_ALL_FUNCS:
     interp->callbacks.TIMInterpreterCallbacks_StopAllFunctions(interp);
-    return instr->len;
+    return;
   case TIM_COMMAND_ID_WSA_INIT: {
     uint16_t index = instrParams[0];
     uint16_t strParam = instrParams[1];
@@ -192,38 +168,38 @@ static int processInstruction(TIMInterpreter *interp, uint16_t *buffer,
     const char *wsaFile = TIMHandleGetText(interp->_tim, strParam);
     interp->callbacks.TIMInterpreterCallbacks_WSAInit(interp, index, wsaFile, x,
                                                       y, offscreen, wsaFlags);
-    return instr->len;
+    return;
   }
   case TIM_COMMAND_ID_WSA_RELEASE:
     interp->callbacks.TIMInterpreterCallbacks_WSARelease(interp,
                                                          instrParams[0]);
-    return instr->len;
+    return;
   case TIM_COMMAND_ID_WSA_DISPLAY_FRAME: {
     int animIndex = instrParams[0];
     int frame = instrParams[1];
     interp->callbacks.TIMInterpreterCallbacks_WSADisplayFrame(interp, animIndex,
                                                               frame);
-    return instr->len;
+    return;
   }
   case TIM_COMMAND_ID_RESET_ALL_RUNTIMES:
     printf("UNIMPLEMENTED TIM_COMMAND_ID_RESET_ALL_RUNTIMES %i\n", numParams);
-    return instr->len;
+    return;
   case TIM_COMMAND_ID_CMD_RETURN_1:
     // printf("UNIMPLEMENTED TIM_COMMAND_ID_CMD_RETURN_1 %i\n", numParams);
     // FIXME: not sure, seems useless. Ignoring for now
-    return instr->len;
+    return;
   case TIM_COMMAND_ID_EXEC_OPCODE:
     processOpCode(interp, instrParams, numParams);
-    return instr->len;
+    return;
   case TIM_COMMAND_ID_PROCESS_DIALOGUE:
     printf("UNIMPLEMENTED TIM_COMMAND_ID_PROCESS_DIALOGUE\n");
-    return instr->len;
+    return;
   case TIM_COMMAND_ID_DIALOG_BOX: {
     uint16_t functionId = instrParams[0];
     interp->callbacks.TIMInterpreterCallbacks_ShowDialogButtons(
         interp, functionId, instrParams + 1);
 
-    return instr->len;
+    return;
   }
   case TIM_COMMAND_ID_CONTINUE_LOOP:
     if (interp->dontLoop == 0) {
@@ -241,7 +217,7 @@ static int processInstruction(TIMInterpreter *interp, uint16_t *buffer,
     if (interp->debugCallbacks.TIMInterpreterDebugCallbacks_ContinueLoop) {
       interp->debugCallbacks.TIMInterpreterDebugCallbacks_ContinueLoop(interp);
     }
-    return instr->len;
+    return;
   case TIM_COMMAND_SET_LOOP_IP:
     if (interp->dontLoop == 0) {
       interp->loopStartPos = pos;
@@ -249,17 +225,90 @@ static int processInstruction(TIMInterpreter *interp, uint16_t *buffer,
     if (interp->debugCallbacks.TIMInterpreterDebugCallbacks_SetLoop) {
       interp->debugCallbacks.TIMInterpreterDebugCallbacks_SetLoop(interp);
     }
-    return instr->len;
+    return;
   case TIM_COMMAND_UNUSED_7:
-    return instr->len;
+    return;
   }
   printf("unimplemented TIM OPCODE %X\n", instr->instrCode);
   assert(0);
-  return instr->len;
+}
+
+static const char *checkOpCode(const TIMEvent *event) {
+  if (event->numParams == 0) {
+    return "missing opcode";
+  }
+  int numParams = 0;
+  switch ((TIM_OPCODE)event->params[0]) {
+  case TIM_OPCODE_NOOP_2:
+  case TIM_OPCODE_CLEAR_TEXT_FIELD:
+  case TIM_OPCODE_UPDATE:
+    break;
+  case TIM_OPCODE_INIT_SCENE_WIN_DIALOGUE:
+  case TIM_OPCODE_RESTORE_AFTER_SCENE_WIN_DIALOGUE:
+  case TIM_OPCODE_FADE_CLEAR_WINDOW:
+  case TIM_OPCODE_LOAD_SOUND_FILE:
+  case TIM_OPCODE_PLAY_MUSIC_TRACK:
+  case TIM_OPCODE_PLAY_DIALOGUE_TALK_TEXT:
+  case TIM_OPCODE_PLAY_SOUND_FX:
+    numParams = 1;
+    break;
+  case TIM_OPCODE_SET_PARTY_POS:
+    numParams = 2;
+    break;
+  case TIM_OPCODE_GIVE_ITEM:
+  case TIM_OPCODE_CHAR_CHAT:
+    numParams = 3;
+    break;
+  case TIM_OPCODE_COPY_REGION:
+    numParams = 8;
+    break;
+  case TIM_OPCODE_DRAW_SCENE:
+    return "unimplemented opcode";
+  default:
+    return "unknown opcode";
+  }
+  return event->numParams - 1 < numParams ? "missing parameters" : NULL;
+}
+
+const char *TIMInterpreterCheckInstruction(const TIMHandle *tim,
+                                           const TIMEvent *event) {
+  int numParams = 0;
+  switch ((TIM_COMMAND_ID)event->instrCode) {
+  case TIM_COMMAND_ID_STOP_ALL_FUNCS:
+  case TIM_COMMAND_ID_RESET_ALL_RUNTIMES:
+  case TIM_COMMAND_ID_CMD_RETURN_1:
+  case TIM_COMMAND_ID_PROCESS_DIALOGUE:
+  case TIM_COMMAND_ID_CONTINUE_LOOP:
+  case TIM_COMMAND_SET_LOOP_IP:
+  case TIM_COMMAND_UNUSED_7:
+    break;
+  case TIM_COMMAND_ID_WSA_INIT:
+    if (event->numParams < 6) {
+      return "missing parameters";
+    }
+    if (event->params[1] >= tim->numTextStrings) {
+      return "invalid string index";
+    }
+    return NULL;
+  case TIM_COMMAND_ID_WSA_RELEASE:
+    numParams = 1;
+    break;
+  case TIM_COMMAND_ID_WSA_DISPLAY_FRAME:
+    numParams = 2;
+    break;
+  case TIM_COMMAND_ID_DIALOG_BOX:
+    numParams = 4;
+    break;
+  case TIM_COMMAND_ID_EXEC_OPCODE:
+    return checkOpCode(event);
+  default:
+    return "unknown instruction";
+  }
+  return event->numParams < numParams ? "missing parameters" : NULL;
 }
 
 int TIMInterpreterIsRunning(const TIMInterpreter *interp) {
-  return interp->_tim && interp->pos < interp->_tim->avtlSize;
+  return interp->_tim && interp->pos < interp->_tim->numEvents;
 }
 
 void TIMInterpreterButtonClicked(TIMInterpreter *interp, int buttonIndex) {
@@ -268,14 +317,20 @@ void TIMInterpreterButtonClicked(TIMInterpreter *interp, int buttonIndex) {
 }
 
 int TIMInterpreterUpdate(TIMInterpreter *interp) {
-  int adv =
-      processInstruction(interp, interp->_tim->avtl + interp->pos, interp->pos);
+  uint64_t start = TracerBegin();
+  const TIMEvent *instr = interp->_tim->events + interp->pos;
+  processInstruction(interp, instr, interp->pos);
+  if (start) {
+    char name[TRACER_NAME_SIZE];
+    snprintf(name, sizeof(name), "tim instr %02X", instr->instrCode);
+    TracerComplete("tim", name, start, "pos", instr->pos);
+  }
 
   if (interp->restartLoop) {
     interp->restartLoop = 0;
     interp->pos = interp->loopStartPos;
   } else {
-    interp->pos += adv;
+    interp->pos++;
   }
   return interp->currentInstructionDuration;
 }
@@ -3,6 +3,21 @@
 #include <stddef.h>
 #include <stdint.h>
 
+typedef enum {
+  TIM_COMMAND_ID_STOP_ALL_FUNCS = 0X01,
+  TIM_COMMAND_ID_WSA_INIT = 0X02,
+  TIM_COMMAND_ID_WSA_RELEASE = 0X03,
+  TIM_COMMAND_ID_WSA_DISPLAY_FRAME = 0X06,
+  TIM_COMMAND_UNUSED_7 = 0X07,
+  TIM_COMMAND_ID_CONTINUE_LOOP = 0X15,
+  TIM_COMMAND_ID_RESET_ALL_RUNTIMES = 0X17,
+  TIM_COMMAND_ID_CMD_RETURN_1 = 0X18,
+  TIM_COMMAND_ID_EXEC_OPCODE = 0X19,
+  TIM_COMMAND_ID_PROCESS_DIALOGUE = 0X1C,
+  TIM_COMMAND_ID_DIALOG_BOX = 0X1D,
+  TIM_COMMAND_SET_LOOP_IP = 0X14,
+} TIM_COMMAND_ID;
+
 typedef struct _TIMInterpreter TIMInterpreter;
 
 typedef struct {
@@ -65,7 +80,7 @@ typedef struct _TIMInterpreter {
   TIMInterpreterDebugCallbacks debugCallbacks; // *optional* callbacks
 
   const TIMHandle *_tim;
-  size_t pos;
+  size_t pos; // in _tim->events
 
   uint8_t dontLoop; // just list instructions
 
@@ -85,3 +100,8 @@ void TIMInterpreterStart(TIMInterpreter *interp, const TIMHandle *tim);
 int TIMInterpreterIsRunning(const TIMInterpreter *interp);
 int TIMInterpreterUpdate(TIMInterpreter *interp);
 void TIMInterpreterButtonClicked(TIMInterpreter *interp, int buttonIndex);
+
+// returns NULL if TIMInterpreterUpdate can run the instruction, else the reason
+// it would assert
+const char *TIMInterpreterCheckInstruction(const TIMHandle *tim,
+                                           const TIMEvent *event);
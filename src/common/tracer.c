@@ -0,0 +1,242 @@
+#include "tracer.h"
+#include "flight_recorder.h"
+#include "profiler.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACER_FLUSH_INTERVAL_MS 10
+
+typedef struct {
+  const char *category;
+  const char *argName;
+  uint64_t ts;
+  uint64_t dur;
+  int64_t argValue;
+  char phase; // 'X' complete, 'i' instant
+  char name[TRACER_NAME_SIZE];
+} TraceEvent;
+
+// single producer (the owning thread), single consumer (the writer thread)
+typedef struct _TraceRing {
+  TraceEvent events[TRACER_RING_SIZE];
+  atomic_uint head; // written by the producer
+  atomic_uint tail; // written by the consumer
+  uint32_t tid;
+  atomic_int exited; // the ring is freed by TracerStop
+  struct _TraceRing *next;
+} TraceRing;
+
+static struct {
+  atomic_int enabled;
+  FILE *file;
+  uint64_t startTime;
+  int numEventsWritten;
+
+  pthread_t writer;
+  atomic_int writerRunning;
+
+  pthread_mutex_t ringsLock;
+  TraceRing *rings;
+  uint32_t numRings;
+
+  atomic_uint droppedEvents;
+  pthread_once_t ringKeyOnce;
+  pthread_key_t ringKey; // to know when a thread exits
+} _tracer = {.ringsLock = PTHREAD_MUTEX_INITIALIZER,
+             .ringKeyOnce = PTHREAD_ONCE_INIT};
+
+static _Thread_local TraceRing *_threadRing = NULL;
+
+static void threadExited(void *arg) {
+  TraceRing *ring = arg;
+  atomic_store(&ring->exited, 1);
+}
+
+static void createRingKey(void) {
+  pthread_key_create(&_tracer.ringKey, threadExited);
+}
+
+static TraceRing *getThreadRing(void) {
+  if (_threadRing) {
+    return _threadRing;
+  }
+  TraceRing *ring = calloc(1, sizeof(TraceRing));
+  assert(ring);
+  pthread_once(&_tracer.ringKeyOnce, createRingKey);
+  pthread_setspecific(_tracer.ringKey, ring);
+  pthread_mutex_lock(&_tracer.ringsLock);
+  ring->tid = ++_tracer.numRings;
+  ring->next = _tracer.rings;
+  _tracer.rings = ring;
+  pthread_mutex_unlock(&_tracer.ringsLock);
+  _threadRing = ring;
+  return ring;
+}
+
+static void pushEvent(const TraceEvent *event) {
+  TraceRing *ring = getThreadRing();
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail >= TRACER_RING_SIZE) {
+    atomic_fetch_add_explicit(&_tracer.droppedEvents, 1, memory_order_relaxed);
+    return;
+  }
+  ring->events[head & (TRACER_RING_SIZE - 1)] = *event;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void writeEvent(const TraceEvent *event, uint32_t tid) {
+  // timestamps are in microseconds
+  fprintf(_tracer.file,
+          "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":1,"
+          "\"tid\":%u,\"ts\":%.3f",
+          _tracer.numEventsWritten ? "," : "", event->name, event->category,
+          event->phase, tid, (event->ts - _tracer.startTime) / 1000.);
+  if (event->phase == 'X') {
+    fprintf(_tracer.file, ",\"dur\":%.3f", event->dur / 1000.);
+  } else if (event->phase == 'i') {
+    fprintf(_tracer.file, ",\"s\":\"t\"");
+  }
+  if (event->argName) {
+    fprintf(_tracer.file, ",\"args\":{\"%s\":%lld}", event->argName,
+            (long long)event->argValue);
+  }
+  fprintf(_tracer.file, "}");
+  _tracer.numEventsWritten++;
+}
+
+static void drainRings(void) {
+  pthread_mutex_lock(&_tracer.ringsLock);
+  TraceRing *ring = _tracer.rings;
+  pthread_mutex_unlock(&_tracer.ringsLock);
+  // rings are only ever prepended, so the list from here on is stable
+  for (; ring; ring = ring->next) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    for (; tail != head; tail++) {
+      writeEvent(&ring->events[tail & (TRACER_RING_SIZE - 1)], ring->tid);
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  }
+  fflush(_tracer.file);
+}
+
+// called once the writer is stopped and the rings are drained. The rings of
+// the threads still running are kept for the next trace.
+static void freeExitedRings(void) {
+  pthread_mutex_lock(&_tracer.ringsLock);
+  TraceRing **link = &_tracer.rings;
+  while (*link) {
+    TraceRing *ring = *link;
+    if (atomic_load(&ring->exited)) {
+      *link = ring->next;
+      free(ring);
+    } else {
+      link = &ring->next;
+    }
+  }
+  pthread_mutex_unlock(&_tracer.ringsLock);
+}
+
+static void *writerMain(void *arg) {
+  const struct timespec interval = {0, TRACER_FLUSH_INTERVAL_MS * 1000000L};
+  while (atomic_load(&_tracer.writerRunning)) {
+    drainRings();
+    nanosleep(&interval, NULL);
+  }
+  return NULL;
+}
+
+int TracerStart(const char *path) {
+  assert(atomic_load(&_tracer.enabled) == 0);
+  _tracer.file = fopen(path, "w");
+  if (!_tracer.file) {
+    perror("TracerStart");
+    return 0;
+  }
+  fprintf(_tracer.file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  _tracer.startTime = ProfilerNow();
+  _tracer.numEventsWritten = 0;
+  atomic_store(&_tracer.droppedEvents, 0);
+  atomic_store(&_tracer.writerRunning, 1);
+  if (pthread_create(&_tracer.writer, NULL, writerMain, NULL) != 0) {
+    printf("TracerStart: unable to create writer thread\n");
+    fclose(_tracer.file);
+    _tracer.file = NULL;
+    return 0;
+  }
+  atomic_store(&_tracer.enabled, 1);
+  return 1;
+}
+
+void TracerStop(void) {
+  if (!atomic_exchange(&_tracer.enabled, 0)) {
+    return;
+  }
+  atomic_store(&_tracer.writerRunning, 0);
+  pthread_join(_tracer.writer, NULL);
+  drainRings();
+  // the destructor of the key doesn't run for the main thread
+  if (_threadRing) {
+    pthread_setspecific(_tracer.ringKey, NULL);
+    atomic_store(&_threadRing->exited, 1);
+    _threadRing = NULL;
+  }
+  freeExitedRings();
+  fprintf(_tracer.file, "\n]}\n");
+  fclose(_tracer.file);
+  _tracer.file = NULL;
+  printf("trace: wrote %i events, dropped %u\n", _tracer.numEventsWritten,
+         atomic_load(&_tracer.droppedEvents));
+}
+
+int TracerIsEnabled(void) { return atomic_load(&_tracer.enabled); }
+
+uint64_t TracerBegin(void) {
+  return (atomic_load_explicit(&_tracer.enabled, memory_order_relaxed) ||
+          FlightRecorderIsEnabled())
+             ? ProfilerNow()
+             : 0;
+}
+
+static void copyName(char *dst, const char *name) {
+  // names end up in a json string
+  int i = 0;
+  for (; name[i] && i < TRACER_NAME_SIZE - 1; i++) {
+    char c = name[i];
+    dst[i] = (c == '"' || c == '\\' || c < 0x20) ? '_' : c;
+  }
+  dst[i] = 0;
+}
+
+void TracerComplete(const char *category, const char *name, uint64_t start,
+                    const char *argName, int64_t argValue) {
+  uint64_t duration = ProfilerNow() - start;
+  FlightRecorderAddEvent(category, name, start, duration, argName, argValue);
+  if (!atomic_load_explicit(&_tracer.enabled, memory_order_relaxed)) {
+    return;
+  }
+  TraceEvent event = {.category = category,
+                      .argName = argName,
+                      .ts = start,
+                      .dur = duration,
+                      .argValue = argValue,
+                      .phase = 'X'};
+  copyName(event.name, name);
+  pushEvent(&event);
+}
+
+void TracerInstant(const char *category, const char *name) {
+  if (!atomic_load_explicit(&_tracer.enabled, memory_order_relaxed)) {
+    return;
+  }
+  TraceEvent event = {
+      .category = category, .ts = ProfilerNow(), .phase = 'i'};
+  copyName(event.name, name);
+  pushEvent(&event);
+}
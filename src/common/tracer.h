@@ -0,0 +1,45 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Chrome trace event export (chrome://tracing, ui.perfetto.dev).
+// Each thread records into its own ring, a background thread drains the rings
+// into the json file, so the traced code only pays for a copy.
+// Completed spans are also fed to the flight recorder when it is enabled.
+
+#define TRACER_RING_SIZE 4096 // events per thread, must be a power of 2
+#define TRACER_NAME_SIZE 32
+
+int TracerStart(const char *path);
+void TracerStop(void);
+int TracerIsEnabled(void);
+
+// returns the start time to give to TracerComplete, or 0 if tracing is off.
+uint64_t TracerBegin(void);
+
+// records a span from start to now. name is copied, category and argName must
+// be string literals. argName can be NULL.
+void TracerComplete(const char *category, const char *name, uint64_t start,
+                    const char *argName, int64_t argValue);
+void TracerInstant(const char *category, const char *name);
+
+typedef struct {
+  const char *category;
+  const char *name;
+  uint64_t start;
+} TracerScope;
+
+static inline void TracerScopeEnd(TracerScope *scope) {
+  if (scope->start) {
+    TracerComplete(scope->category, scope->name, scope->start, NULL, 0);
+  }
+}
+
+#define TRACER_CONCAT_(a, b) a##b
+#define TRACER_CONCAT(a, b) TRACER_CONCAT_(a, b)
+
+// traces the enclosing block until it goes out of scope.
+#define TRACER_SCOPE(category, name)                                           \
+  TracerScope TRACER_CONCAT(_tracerScope, __LINE__)                            \
+      __attribute__((cleanup(TracerScopeEnd))) = {(category), (name),          \
+                                                  TracerBegin()}
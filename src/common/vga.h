@@ -0,0 +1,6 @@
+#pragma once
+#include <stdint.h>
+
+// VGA palettes have 6 bits per channel
+static inline uint8_t VGA6To8(uint8_t v) { return (v * 255) / 63; }
+#define VGA8To8(x) x
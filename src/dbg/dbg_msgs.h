@@ -29,6 +29,12 @@ typedef enum {
   DBGMsgType_SetVarRequest = 14,
   DBGMsgType_SetVarResponse = 15,
 
+  DBGMsgType_LogMessage = 16, // server to client, a text line of dataSize
+
+  // the report comes as LogMessage lines before the response
+  DBGMsgType_EMCProfileRequest = 17,
+  DBGMsgType_EMCProfileResponse = 18,
+
 } DBGMsgType;
 
 typedef struct {
@@ -69,3 +75,18 @@ typedef struct {
 typedef struct {
   uint16_t response;
 } DBGMSG_EnableLoggerResponse;
+
+typedef enum {
+  DBGEMCProfileAction_Report = 0,
+  DBGEMCProfileAction_Enable = 1,
+  DBGEMCProfileAction_Disable = 2,
+  DBGEMCProfileAction_Reset = 3,
+} DBGEMCProfileAction;
+
+typedef struct {
+  uint8_t action;
+} DBGMSG_EMCProfileRequest;
+
+typedef struct {
+  uint8_t enabled;
+} DBGMSG_EMCProfileResponse;
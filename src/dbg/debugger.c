@@ -14,6 +14,21 @@ static uint8_t recvBuf[1024];
 static int shouldStop = 0;
 static int sock = 0;
 
+// reads the next response header, printing the log lines streamed by the game
+// in between.
+static void readHeader(DBGMsg_Header *header) {
+  while (read(sock, header, sizeof(DBGMsg_Header)) == sizeof(DBGMsg_Header) &&
+         header->type == DBGMsgType_LogMessage) {
+    char line[513] = "";
+    size_t size = header->dataSize < 512 ? header->dataSize : 512;
+    ssize_t r = read(sock, line, size);
+    if (r > 0) {
+      line[r] = 0;
+    }
+    printf("%s\n", line);
+  }
+}
+
 static void processCommand(int argc, char *argv[]) {
   const char *cmd = argv[0];
   if (strcmp(cmd, "exit") == 0) {
@@ -31,7 +46,7 @@ static void processCommand(int argc, char *argv[]) {
     req.itemId = atoi(argv[1]);
     write(sock, &req, sizeof(DBGMSG_GiveItemRequest));
 
-    read(sock, &header, sizeof(DBGMsg_Header));
+    readHeader(&header);
     assert(header.type == DBGMsgType_GiveItemResponse);
     DBGMSG_GiveItemResponse resp;
     read(sock, &resp, sizeof(DBGMSG_GiveItemResponse));
@@ -39,7 +54,7 @@ static void processCommand(int argc, char *argv[]) {
   } else if (strcmp(cmd, "status") == 0) {
     DBGMsg_Header header = {.type = DBGMsgType_StatusRequest, 0};
     write(sock, &header, sizeof(DBGMsg_Header));
-    read(sock, &header, sizeof(DBGMsg_Header));
+    readHeader(&header);
     DBGMsg_Status status;
     read(sock, &status, sizeof(DBGMsg_Status));
     printf("received %i %i current block %X\n", header.type, header.dataSize,
@@ -52,7 +67,7 @@ static void processCommand(int argc, char *argv[]) {
     DBGMSG_SetStateRequest req;
     req.state = atoi(argv[1]);
     write(sock, &req, sizeof(DBGMSG_SetStateRequest));
-    read(sock, &header, sizeof(DBGMsg_Header));
+    readHeader(&header);
     assert(header.type == DBGMsgType_SetStateResponse);
     DBGMSG_SetStateResponse resp;
     read(sock, &resp, sizeof(DBGMSG_SetStateResponse));
@@ -61,7 +76,7 @@ static void processCommand(int argc, char *argv[]) {
     DBGMsg_Header header = {.type = DBGMsgType_QuitRequest, 0};
     write(sock, &header, sizeof(DBGMsg_Header));
 
-    read(sock, &header, sizeof(DBGMsg_Header));
+    readHeader(&header);
     assert(header.type == DBGMsgType_QuitResponse);
     DBGMSG_QuitResponse resp;
     read(sock, &resp, sizeof(DBGMSG_QuitResponse));
@@ -70,7 +85,7 @@ static void processCommand(int argc, char *argv[]) {
   } else if (strcmp(cmd, "noclip") == 0) {
     DBGMsg_Header header = {.type = DBGMsgType_NoClipRequest, 0};
     write(sock, &header, sizeof(DBGMsg_Header));
-    read(sock, &header, sizeof(DBGMsg_Header));
+    readHeader(&header);
     assert(header.type == DBGMsgType_NoClipResponse);
   } else if (strcmp(cmd, "log") == 0 && argc > 2) {
     DBGMsg_Header header = {.type = DBGMsgType_SetLoggerRequest,
@@ -80,9 +95,28 @@ static void processCommand(int argc, char *argv[]) {
     strncpy(req.prefix, argv[1], sizeof(req.prefix));
     req.enable = atoi(argv[2]);
     write(sock, &req, sizeof(DBGMSG_EnableLoggerRequest));
-    read(sock, &header, sizeof(DBGMsg_Header));
+    readHeader(&header);
     assert(header.type == DBGMsgType_SetLoggerResponse);
 
+  } else if (strcmp(cmd, "emcprof") == 0) {
+    // emcprof [on|off|reset], prints the report without argument
+    DBGMSG_EMCProfileRequest req = {.action = DBGEMCProfileAction_Report};
+    if (argc > 1 && strcmp(argv[1], "on") == 0) {
+      req.action = DBGEMCProfileAction_Enable;
+    } else if (argc > 1 && strcmp(argv[1], "off") == 0) {
+      req.action = DBGEMCProfileAction_Disable;
+    } else if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+      req.action = DBGEMCProfileAction_Reset;
+    }
+    DBGMsg_Header header = {.type = DBGMsgType_EMCProfileRequest,
+                            sizeof(DBGMSG_EMCProfileRequest)};
+    write(sock, &header, sizeof(DBGMsg_Header));
+    write(sock, &req, sizeof(DBGMSG_EMCProfileRequest));
+    readHeader(&header);
+    assert(header.type == DBGMsgType_EMCProfileResponse);
+    DBGMSG_EMCProfileResponse resp;
+    read(sock, &resp, sizeof(DBGMSG_EMCProfileResponse));
+    printf("emc profiler %s\n", resp.enabled ? "enabled" : "disabled");
   } else {
     printf("unknown command '%s'\n", cmd);
   }
@@ -1,9 +1,12 @@
 #include "audio.h"
 #include "SDL_audio.h"
+#include "audio_mixer.h"
+#include "audio_sfx_cache.h"
 #include "SDL_stdinc.h"
 #include "config.h"
 #include "formats/format_voc.h"
 #include "pak_file.h"
+#include "profiler.h"
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -19,105 +22,203 @@ static inline uint8_t clampVol(int8_t vol) {
   return vol;
 }
 
-void AudioQueueInit(AudioQueue *queue) {
-  memset(queue, 0, sizeof(AudioQueue));
-  queue->vocHandle.header = NULL;
+static inline uint16_t getAudioGain(uint8_t vol) {
+  return INT16_MAX * vol / 10;
 }
 
-void AudioQueueReset(AudioQueue *queue, size_t sequenceSize) {
-  queue->currentBlock = NULL;
-  queue->currentSample = 0;
-  queue->currentSequenceIndex = 0;
-  queue->sequenceSize = sequenceSize;
+static void sendVolumes(AudioSystem *audioSystem) {
+  unsigned volumes = audioSystem->soundVol | audioSystem->musicVol << 8 |
+                     audioSystem->voiceVol << 16;
+  atomic_store_explicit(&audioSystem->volumes, volumes, memory_order_relaxed);
 }
 
-static inline uint16_t getAudioGain(uint8_t vol) {
-  return INT16_MAX * vol / 10;
+// a free channel, or the one playing the oldest sound
+static AudioChannel *getSoundChannel(AudioSystem *audioSystem) {
+  AudioChannel *oldest = NULL;
+  for (int i = 0; i < AUDIO_NUM_CHANNELS; i++) {
+    AudioChannel *channel = audioSystem->channels + i;
+    if (i == AUDIO_VOICE_CHANNEL) {
+      continue;
+    }
+    if (!AudioChannelIsPlaying(channel)) {
+      return channel;
+    }
+    if (!oldest || channel->startSerial < oldest->startSerial) {
+      oldest = channel;
+    }
+  }
+  return oldest;
 }
 
-static size_t doCopyBlock(AudioQueue *queue, int16_t *samples,
-                          size_t numSamplesOut, int32_t vol) {
-  const VOCSoundDataTyped *data =
-      (const VOCSoundDataTyped *)VOCBlockGetData(queue->currentBlock);
-  size_t numBLockSamples = VOCBlockGetSize(queue->currentBlock) - 2;
-  size_t remainingBlockSamples = numBLockSamples - queue->currentSample;
-
-  if (remainingBlockSamples == 0) {
-    if (VOCBlockIsLast(queue->currentBlock)) {
-      if (queue->currentSequenceIndex == queue->sequenceSize - 1) {
-        queue->sequenceSize = 0;
-        return 0;
-      } else {
-        queue->currentSequenceIndex++;
-        queue->currentSample = 0;
-        queue->currentBlock = NULL;
-        return 0;
-      }
-    } else { // not last block
-      queue->currentBlock = VOCHandleGetNextBlock(
-          &queue->vocHandles[queue->currentSequenceIndex], queue->currentBlock);
-      queue->currentSample = 0;
+static void applyCommand(AudioSystem *audioSystem,
+                         const AudioCommand *command) {
+  AudioChannel *channel = NULL;
+  switch (command->type) {
+  case AudioCommandType_PlayCachedSound:
+    channel = getSoundChannel(audioSystem);
+    channel->startSerial = ++audioSystem->numSoundsStarted;
+    AudioQueueReset(&channel->queue, 0);
+    channel->pcm = command->pcm;
+    channel->pcmFrames = command->pcmFrames;
+    channel->pcmPosition = 0;
+    channel->volume = command->volume;
+    channel->pan = command->pan;
+    return;
+  case AudioCommandType_StopCachedSounds:
+    for (int i = 0; i < AUDIO_NUM_CHANNELS; i++) {
+      audioSystem->channels[i].pcm = NULL;
     }
+    return;
+  case AudioCommandType_StopVoice:
+    AudioQueueReset(&audioSystem->channels[AUDIO_VOICE_CHANNEL].queue, 0);
+    break;
+  case AudioCommandType_PlayVoice:
+    channel = audioSystem->channels + AUDIO_VOICE_CHANNEL;
+    break;
+  case AudioCommandType_PlaySound:
+    channel = getSoundChannel(audioSystem);
+    channel->startSerial = ++audioSystem->numSoundsStarted;
+    break;
   }
-  size_t numSamplesToCopy = remainingBlockSamples > numSamplesOut
-                                ? numSamplesOut
-                                : remainingBlockSamples;
-  assert(numSamplesToCopy <= numSamplesOut);
-  const int8_t *inSamples = ((int8_t *)data) + 2;
-  for (size_t i = 0; i < numSamplesToCopy; i++) {
-    int16_t v = (inSamples[i + queue->currentSample] - 0X80) << 8;
-    samples[i] += (int16_t)(vol * v / (INT32_C(1) << 15));
+  if (channel) {
+    AudioQueue *queue = &channel->queue;
+    channel->pcm = NULL;
+    memcpy(queue->vocHandles, command->vocHandles,
+           command->sequenceSize * sizeof(VOCHandle));
+    memcpy(queue->sequence, command->sequence,
+           command->sequenceSize * sizeof(int));
+    AudioQueueReset(queue, command->sequenceSize);
+    channel->volume = command->volume;
+    channel->pan = command->pan;
+  }
+  if (command->type != AudioCommandType_PlaySound) {
+    atomic_store_explicit(&audioSystem->_voiceEntry,
+                          command->sequenceSize ? command->sequence[0] : -1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&audioSystem->_voiceSerial, command->serial,
+                          memory_order_release);
   }
-  queue->currentSample += numSamplesToCopy;
-  return numSamplesToCopy;
 }
 
-static void _audioCallbackQueue(AudioQueue *queue, int16_t *samples,
-                                size_t numSamplesOut, int32_t vol) {
-  if (queue->sequenceSize == 0) {
-    return;
-  }
-  if (queue->currentBlock == NULL) {
-    queue->currentBlock =
-        queue->vocHandles[queue->currentSequenceIndex].firstBlock;
+static void processCommands(AudioSystem *audioSystem) {
+  unsigned tail =
+      atomic_load_explicit(&audioSystem->commandsTail, memory_order_relaxed);
+  unsigned head =
+      atomic_load_explicit(&audioSystem->commandsHead, memory_order_acquire);
+  for (; tail != head; tail++) {
+    applyCommand(audioSystem,
+                 audioSystem->commands + tail % AUDIO_COMMAND_RING_SIZE);
   }
-  assert(queue->currentBlock);
-  size_t ret = 0;
-  while (1) {
-    ret = doCopyBlock(queue, samples, numSamplesOut, vol);
-    if (ret == numSamplesOut || queue->currentBlock == NULL) {
-      break;
+  atomic_store_explicit(&audioSystem->commandsTail, tail,
+                        memory_order_release);
+}
+
+static void publishVoiceEntry(AudioSystem *audioSystem) {
+  const AudioQueue *queue = &audioSystem->channels[AUDIO_VOICE_CHANNEL].queue;
+  int entry = queue->sequenceSize ? queue->sequence[queue->currentSequenceIndex]
+                                  : -1;
+  atomic_store_explicit(&audioSystem->_voiceEntry, entry,
+                        memory_order_relaxed);
+}
+
+#define AUDIO_MIX_FRAMES 256
+
+static void mix(AudioSystem *audioSystem, int16_t *samples, size_t numFrames) {
+  unsigned volumes =
+      atomic_load_explicit(&audioSystem->volumes, memory_order_relaxed);
+  const int32_t soundGain = getAudioGain(volumes & 0XFF);
+  const int32_t musicGain = getAudioGain((volumes >> 8) & 0XFF);
+  const int32_t voiceGain = getAudioGain((volumes >> 16) & 0XFF);
+  const uint32_t outRate = audioSystem->audioSpec.freq;
+
+  int32_t acc[AUDIO_MIX_FRAMES * AUDIO_OUTPUT_CHANNELS];
+  while (numFrames) {
+    size_t count = numFrames < AUDIO_MIX_FRAMES ? numFrames : AUDIO_MIX_FRAMES;
+    memset(acc, 0, count * AUDIO_OUTPUT_CHANNELS * sizeof(int32_t));
+    AudioMusicMix(&audioSystem->music, acc, count, musicGain);
+    for (int i = 0; i < AUDIO_NUM_CHANNELS; i++) {
+      AudioChannelMix(audioSystem->channels + i, acc, count,
+                      i == AUDIO_VOICE_CHANNEL ? voiceGain : soundGain,
+                      outRate);
     }
+    AudioMixerWrite(acc, samples, count * AUDIO_OUTPUT_CHANNELS);
+    samples += count * AUDIO_OUTPUT_CHANNELS;
+    numFrames -= count;
   }
 }
 
+// the same for both backends
+static void render(AudioSystem *audioSystem, int16_t *samples,
+                   size_t numFrames) {
+  processCommands(audioSystem);
+  mix(audioSystem, samples, numFrames);
+  publishVoiceEntry(audioSystem);
+}
+
 static void _audioCallback(void *userdata, Uint8 *stream, int len) {
   AudioSystem *audioSystem = (AudioSystem *)userdata;
   assert(audioSystem);
-  int16_t *samples = (int16_t *)stream;
-  size_t numSamplesOut = len / 2;
+  render(audioSystem, (int16_t *)stream,
+         len / (AUDIO_OUTPUT_CHANNELS * sizeof(int16_t)));
+}
 
-  memset(stream, 0, len);
+static int hasOutput(const AudioSystem *audioSystem) {
+  return audioSystem->deviceID != 0 ||
+         audioSystem->backend == AudioBackend_Null;
+}
 
-  _audioCallbackQueue(&audioSystem->soundQueue, samples, numSamplesOut,
-                      getAudioGain(audioSystem->_soundVol));
-  _audioCallbackQueue(&audioSystem->voiceQueue, samples, numSamplesOut,
-                      getAudioGain(audioSystem->_voiceVol));
+static int initNull(AudioSystem *audioSystem, const char *wavFile) {
+  audioSystem->audioSpec.freq = AUDIO_OUTPUT_RATE;
+  audioSystem->audioSpec.format = AUDIO_S16SYS;
+  audioSystem->audioSpec.channels = AUDIO_OUTPUT_CHANNELS;
+  audioSystem->audioSpec.samples = AUDIO_NULL_BLOCK_FRAMES;
+  // decoded on the game thread, in step with the mixing
+  AudioMusicInit(&audioSystem->music, AUDIO_OUTPUT_RATE, 0);
+  if (!wavFile) {
+    return 1;
+  }
+  SF_INFO sfinfo = {0};
+  sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+  sfinfo.channels = AUDIO_OUTPUT_CHANNELS;
+  sfinfo.samplerate = AUDIO_OUTPUT_RATE;
+  audioSystem->wavFile = sf_open(wavFile, SFM_WRITE, &sfinfo);
+  if (!audioSystem->wavFile) {
+    printf("Not able to open audio output file %s.\n", wavFile);
+    puts(sf_strerror(NULL));
+    return 0;
+  }
+  return 1;
 }
 
-int AudioSystemInit(AudioSystem *audioSystem, const GameConfig *conf) {
+int AudioSystemInit(AudioSystem *audioSystem, const GameConfig *conf,
+                    AudioBackend backend, const char *wavFile) {
   memset(audioSystem, 0, sizeof(AudioSystem));
 
-  // audio thread not yet setup here, can access shared variables directly.
-  audioSystem->_musicVol = clampVol(conf->musicVol);
-  audioSystem->_soundVol = clampVol(conf->soundVol);
-  audioSystem->_voiceVol = clampVol(conf->voiceVol);
+  audioSystem->soundVol = clampVol(conf->soundVol);
+  audioSystem->musicVol = clampVol(conf->musicVol);
+  audioSystem->voiceVol = clampVol(conf->voiceVol);
+  audioSystem->pendingVoice = -1;
+  atomic_init(&audioSystem->commandsHead, 0);
+  atomic_init(&audioSystem->commandsTail, 0);
+  atomic_init(&audioSystem->volumes, 0);
+  sendVolumes(audioSystem);
+  atomic_init(&audioSystem->_voiceSerial, 0);
+  atomic_init(&audioSystem->_voiceEntry, -1);
+  for (int i = 0; i < AUDIO_NUM_CHANNELS; i++) {
+    AudioQueueInit(&audioSystem->channels[i].queue);
+  }
 
+  audioSystem->backend = backend;
+  if (backend == AudioBackend_Null) {
+    printf("init null audio\n");
+    return initNull(audioSystem, wavFile);
+  }
   printf("init audio\n");
   SDL_AudioSpec desiredSpec = {0};
-  desiredSpec.freq = 22222;
+  // the VOC files are resampled by the mixer
+  desiredSpec.freq = AUDIO_OUTPUT_RATE;
   desiredSpec.format = AUDIO_S16SYS;
-  desiredSpec.channels = 1;
+  desiredSpec.channels = AUDIO_OUTPUT_CHANNELS;
   desiredSpec.samples = 1024;
   desiredSpec.callback = _audioCallback;
   desiredSpec.userdata = audioSystem;
@@ -132,60 +233,109 @@ int AudioSystemInit(AudioSystem *audioSystem, const GameConfig *conf) {
   printf("audio config:\n");
   printf("freq: %i\n", audioSystem->audioSpec.freq);
   printf("samples: %i\n", audioSystem->audioSpec.samples);
+  AudioMusicInit(&audioSystem->music, audioSystem->audioSpec.freq, 1);
   SDL_PauseAudioDevice(audioSystem->deviceID, 0);
-
-  AudioQueueInit(&audioSystem->voiceQueue);
-  AudioQueueInit(&audioSystem->soundQueue);
   return 1;
 }
 
+static void reportNull(const AudioSystem *audioSystem) {
+  double seconds = (double)audioSystem->mixedFrames / AUDIO_OUTPUT_RATE;
+  uint64_t decodeNs = atomic_load(&audioSystem->music.decodeNs);
+  printf("null audio: %.2f s mixed in %.3f ms", seconds,
+         audioSystem->mixNs / 1000000.);
+  if (seconds > 0) {
+    printf(", %.3f ms per second of audio, music decoding %.3f ms per second",
+           audioSystem->mixNs / 1000000. / seconds,
+           decodeNs / 1000000. / seconds);
+  }
+  printf("\n");
+}
+
 void AudioSystemRelease(AudioSystem *audioSystem) {
-  SDL_CloseAudioDevice(audioSystem->deviceID);
+  if (audioSystem->backend == AudioBackend_Null) {
+    reportNull(audioSystem);
+    if (audioSystem->wavFile) {
+      sf_close(audioSystem->wavFile);
+      audioSystem->wavFile = NULL;
+    }
+  } else {
+    SDL_CloseAudioDevice(audioSystem->deviceID);
+  }
+  AudioMusicRelease(&audioSystem->music);
+  AudioSFXCacheRelease(&audioSystem->sfxCache);
+  AudioSFXCacheRelease(&audioSystem->retiredSFXCache);
+}
+
+// returns NULL if the ring is full, the command is sent by pushCommand
+static AudioCommand *getFreeCommand(AudioSystem *audioSystem,
+                                    AudioCommandType type) {
+  if (!hasOutput(audioSystem)) {
+    return NULL; // no audio
+  }
+  unsigned head =
+      atomic_load_explicit(&audioSystem->commandsHead, memory_order_relaxed);
+  unsigned tail =
+      atomic_load_explicit(&audioSystem->commandsTail, memory_order_acquire);
+  if (head - tail == AUDIO_COMMAND_RING_SIZE) {
+    printf("AudioSystem: command ring full, dropping command %i\n", type);
+    return NULL;
+  }
+  AudioCommand *command =
+      audioSystem->commands + head % AUDIO_COMMAND_RING_SIZE;
+  command->type = type;
+  command->sequenceSize = 0;
+  command->volume = 255;
+  command->pan = 0;
+  return command;
+}
+
+static void pushCommand(AudioSystem *audioSystem) {
+  atomic_fetch_add_explicit(&audioSystem->commandsHead, 1,
+                            memory_order_release);
+}
+
+// voice commands are numbered, so that the game thread knows when the audio
+// callback has applied them
+static void pushVoiceCommand(AudioSystem *audioSystem, AudioCommand *command) {
+  command->serial = ++audioSystem->voiceSerial;
+  audioSystem->pendingVoice =
+      command->sequenceSize ? command->sequence[0] : -1;
+  pushCommand(audioSystem);
 }
 
 void AudioSystemSetSoundVolume(AudioSystem *audioSystem, int8_t vol) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
-  audioSystem->_soundVol = clampVol(vol);
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
+  audioSystem->soundVol = clampVol(vol);
+  sendVolumes(audioSystem);
 }
 
 uint8_t AudioSystemGetSoundVolume(const AudioSystem *audioSystem) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
-  Uint8 val = audioSystem->_soundVol;
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
-  return val;
+  return audioSystem->soundVol;
 }
 
 void AudioSystemSetMusicVolume(AudioSystem *audioSystem, int8_t vol) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
-  audioSystem->_musicVol = clampVol(vol);
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
+  audioSystem->musicVol = clampVol(vol);
+  sendVolumes(audioSystem);
 }
 
 uint8_t AudioSystemGetMusicVolume(const AudioSystem *audioSystem) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
-  uint8_t val = audioSystem->_musicVol;
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
-  return val;
+  return audioSystem->musicVol;
 }
 
 void AudioSystemSetVoiceVolume(AudioSystem *audioSystem, int8_t vol) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
-  audioSystem->_voiceVol = clampVol(vol);
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
+  audioSystem->voiceVol = clampVol(vol);
+  sendVolumes(audioSystem);
 }
 
 uint8_t AudioSystemGetVoiceVolume(const AudioSystem *audioSystem) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
-  uint8_t val = audioSystem->_voiceVol;
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
-  return val;
+  return audioSystem->voiceVol;
 }
 
 void AudioSystemClearVoiceQueue(AudioSystem *audioSystem) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
-  AudioQueueReset(&audioSystem->voiceQueue, 0);
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
+  AudioCommand *command =
+      getFreeCommand(audioSystem, AudioCommandType_StopVoice);
+  if (command) {
+    pushVoiceCommand(audioSystem, command);
+  }
 }
 
 void AudioSystemStopSpeech(AudioSystem *audioSystem) {
@@ -193,56 +343,201 @@ void AudioSystemStopSpeech(AudioSystem *audioSystem) {
 }
 
 int AudioSystemGetCurrentVoiceIndex(const AudioSystem *audioSystem) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
-  int idx = audioSystem->voiceQueue.currentSequenceIndex;
-  int size = audioSystem->voiceQueue.sequenceSize;
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
-  if (size == 0) {
-    return -1;
+  if (atomic_load_explicit(&audioSystem->_voiceSerial, memory_order_acquire) !=
+      audioSystem->voiceSerial) {
+    // not yet seen by the audio callback
+    return audioSystem->pendingVoice;
   }
-  return audioSystem->voiceQueue.sequence[idx];
+  return atomic_load_explicit(&audioSystem->_voiceEntry, memory_order_relaxed);
 }
 
 void AudioSystemPlayVoiceSequence(AudioSystem *audioSystem, const PAKFile *pak,
                                   int *sequence, size_t sequenceSize) {
-  SDL_LockAudioDevice(audioSystem->deviceID);
+  AudioCommand *command =
+      getFreeCommand(audioSystem, AudioCommandType_PlayVoice);
+  if (!command) {
+    return;
+  }
+  assert(sequenceSize <= MAX_VOC_SEQ_ENTRIES);
   for (int i = 0; i < sequenceSize; i++) {
     int entryIndex = sequence[i];
     const uint8_t *buffer = PakFileGetEntryData(pak, entryIndex);
     size_t bufferSize = PakFileGetEntrySize(pak, entryIndex);
 
-    if (!VOCHandleFromBuffer(&audioSystem->voiceQueue.vocHandles[i], buffer,
-                             bufferSize)) {
+    if (!VOCHandleFromBuffer(&command->vocHandles[command->sequenceSize],
+                             buffer, bufferSize)) {
       printf("Unable to read voc file index %i\n", entryIndex);
       continue;
     }
-    audioSystem->voiceQueue.sequence[i] = entryIndex;
+    command->sequence[command->sequenceSize++] = entryIndex;
   }
-
-  AudioQueueReset(&audioSystem->voiceQueue, sequenceSize);
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
+  pushVoiceCommand(audioSystem, command);
 }
 
 void AudioSystemPlaySoundFX(AudioSystem *audioSystem, const PAKFile *pak,
                             const char *filename) {
+  AudioSystemPlaySoundFXAt(audioSystem, pak, filename, 255, 0);
+}
+
+void AudioSystemPlaySoundFXAt(AudioSystem *audioSystem, const PAKFile *pak,
+                              const char *filename, uint8_t volume,
+                              int8_t pan) {
   int entryIndex = PakFileGetEntryIndex(pak, filename);
   if (entryIndex == -1) {
     printf("AudioSystemPlaySoundFX: no such sfx file '%s'\n", filename);
     return;
   }
 
-  SDL_LockAudioDevice(audioSystem->deviceID);
-
+  AudioCommand *command =
+      getFreeCommand(audioSystem, AudioCommandType_PlaySound);
+  if (!command) {
+    return;
+  }
   const uint8_t *buffer = PakFileGetEntryData(pak, entryIndex);
   size_t bufferSize = PakFileGetEntrySize(pak, entryIndex);
 
-  if (VOCHandleFromBuffer(&audioSystem->soundQueue.vocHandles[0], buffer,
-                          bufferSize)) {
-
-    AudioQueueReset(&audioSystem->soundQueue, 1);
+  if (VOCHandleFromBuffer(&command->vocHandles[0], buffer, bufferSize)) {
+    command->sequence[0] = entryIndex;
+    command->sequenceSize = 1;
+    command->volume = volume;
+    command->pan = pan < -AUDIO_MAX_PAN ? -AUDIO_MAX_PAN : pan;
+    pushCommand(audioSystem);
   } else {
     printf("VOCHandleFromBuffer error for file '%s'\n", filename);
   }
+}
 
-  SDL_UnlockAudioDevice(audioSystem->deviceID);
+static int isRetiredCacheInUse(AudioSystem *audioSystem) {
+  if (audioSystem->retiredSFXCache.numEntries == 0) {
+    return 0;
+  }
+  unsigned tail =
+      atomic_load_explicit(&audioSystem->commandsTail, memory_order_acquire);
+  if ((int)(tail - audioSystem->retiredUntil) < 0) {
+    return 1;
+  }
+  AudioSFXCacheRelease(&audioSystem->retiredSFXCache);
+  return 0;
+}
+
+int AudioSystemCacheSoundFX(AudioSystem *audioSystem, uint16_t soundId,
+                            const PAKFile *pak, const char *filename) {
+  isRetiredCacheInUse(audioSystem);
+  if (!hasOutput(audioSystem)) {
+    return 0;
+  }
+  if (AudioSFXCacheGet(&audioSystem->sfxCache, soundId)) {
+    return 1;
+  }
+  int entryIndex = PakFileGetEntryIndex(pak, filename);
+  if (entryIndex == -1) {
+    return 0;
+  }
+  return AudioSFXCacheAdd(&audioSystem->sfxCache, soundId,
+                          PakFileGetEntryData(pak, entryIndex),
+                          PakFileGetEntrySize(pak, entryIndex),
+                          audioSystem->audioSpec.freq) != NULL;
+}
+
+int AudioSystemPlayCachedSoundFX(AudioSystem *audioSystem, uint16_t soundId,
+                                 uint8_t volume, int8_t pan) {
+  const AudioSFX *sfx = AudioSFXCacheGet(&audioSystem->sfxCache, soundId);
+  if (!sfx) {
+    return 0;
+  }
+  AudioCommand *command =
+      getFreeCommand(audioSystem, AudioCommandType_PlayCachedSound);
+  if (command) {
+    command->pcm = sfx->samples;
+    command->pcmFrames = sfx->numFrames;
+    command->volume = volume;
+    command->pan = pan < -AUDIO_MAX_PAN ? -AUDIO_MAX_PAN : pan;
+    pushCommand(audioSystem);
+  }
+  return 1;
+}
+
+void AudioSystemClearSoundFXCache(AudioSystem *audioSystem) {
+  if (audioSystem->sfxCache.numEntries == 0) {
+    return;
+  }
+  if (!hasOutput(audioSystem)) {
+    AudioSFXCacheRelease(&audioSystem->sfxCache);
+    return;
+  }
+  if (isRetiredCacheInUse(audioSystem)) {
+    printf("AudioSystem: previous sound cache still in use, not cleared\n");
+    return;
+  }
+  AudioCommand *command =
+      getFreeCommand(audioSystem, AudioCommandType_StopCachedSounds);
+  if (!command) {
+    return;
+  }
+  pushCommand(audioSystem);
+  audioSystem->retiredSFXCache = audioSystem->sfxCache;
+  audioSystem->retiredUntil =
+      atomic_load_explicit(&audioSystem->commandsHead, memory_order_relaxed);
+  AudioSFXCacheInit(&audioSystem->sfxCache);
+}
+
+int AudioSystemPlayMusic(AudioSystem *audioSystem, const PAKFile *pak,
+                         const char *filename, int loop) {
+  int entryIndex = PakFileGetEntryIndex(pak, filename);
+  if (entryIndex == -1) {
+    printf("AudioSystem: no music file '%s'\n", filename);
+    return 0;
+  }
+  if (!AudioSystemPlayMusicBuffer(audioSystem,
+                                  PakFileGetEntryData(pak, entryIndex),
+                                  PakFileGetEntrySize(pak, entryIndex), loop)) {
+    printf("AudioSystem: invalid music file '%s'\n", filename);
+    return 0;
+  }
+  return 1;
+}
+
+int AudioSystemPlayMusicBuffer(AudioSystem *audioSystem,
+                               const uint8_t *buffer, size_t size, int loop) {
+  // read here, the music thread only decodes
+  VOCHandle handle = {0};
+  if (!VOCHandleFromBuffer(&handle, buffer, size)) {
+    return 0;
+  }
+  AudioMusicPlay(&audioSystem->music, &handle, loop);
+  return 1;
+}
+
+void AudioSystemStopMusic(AudioSystem *audioSystem) {
+  AudioMusicStop(&audioSystem->music);
+}
+
+int AudioSystemIsMusicPlaying(AudioSystem *audioSystem) {
+  return AudioMusicIsPlaying(&audioSystem->music);
+}
+
+void AudioSystemAdvance(AudioSystem *audioSystem, uint32_t ms) {
+  if (audioSystem->backend != AudioBackend_Null) {
+    return;
+  }
+  audioSystem->clockRemainder += (uint64_t)ms * AUDIO_OUTPUT_RATE;
+  uint64_t numFrames = audioSystem->clockRemainder / 1000;
+  audioSystem->clockRemainder %= 1000;
+
+  int16_t samples[AUDIO_NULL_BLOCK_FRAMES * AUDIO_OUTPUT_CHANNELS];
+  while (numFrames) {
+    size_t count = numFrames < AUDIO_NULL_BLOCK_FRAMES
+                       ? numFrames
+                       : AUDIO_NULL_BLOCK_FRAMES;
+    AudioMusicPump(&audioSystem->music);
+    uint64_t start = ProfilerNow();
+    render(audioSystem, samples, count);
+    audioSystem->mixNs += ProfilerNow() - start;
+    audioSystem->mixedFrames += count;
+    if (audioSystem->wavFile) {
+      sf_write_short(audioSystem->wavFile, samples,
+                     count * AUDIO_OUTPUT_CHANNELS);
+    }
+    numFrames -= count;
+  }
 }
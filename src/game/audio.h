@@ -1,44 +1,102 @@
 #pragma once
+#include "audio_mixer.h"
+#include "audio_music.h"
+#include "audio_sfx_cache.h"
 #include "config.h"
 #include "formats/format_voc.h"
 #include "pak_file.h"
 #include <SDL2/SDL.h>
+#include <sndfile.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 
-#define MAX_VOC_SEQ_ENTRIES 6
+#define AUDIO_COMMAND_RING_SIZE 32 // power of 2
+#define AUDIO_VOICE_CHANNEL 0     // the others play the sound effects
+#define AUDIO_OUTPUT_RATE 22050
+#define AUDIO_NULL_BLOCK_FRAMES 1024 // mixed at once, like a device callback
 
+typedef enum {
+  AudioBackend_Device,
+  AudioBackend_Null, // mixed by AudioSystemAdvance, optionally to a WAV file
+} AudioBackend;
+
+typedef enum {
+  AudioCommandType_PlayVoice = 0,
+  AudioCommandType_StopVoice,
+  AudioCommandType_PlaySound,
+  AudioCommandType_PlayCachedSound,
+  AudioCommandType_StopCachedSounds,
+} AudioCommandType;
+
+// sent by the game thread to the audio callback. The VOC files are parsed
+// before, the callback only copies the handles.
 typedef struct {
-  VOCHandle vocHandle;
-  const VOCBlock *currentBlock;
-  size_t currentSample;
+  AudioCommandType type;
+  uint32_t serial; // voice commands
+  uint8_t volume;
+  int8_t pan;
+
+  // cached sound, copied: the cache entries are reused once it's cleared.
+  // The samples stay owned by the cache until the stop command is consumed.
+  const int16_t *pcm;
+  uint32_t pcmFrames;
 
-  int sequence[MAX_VOC_SEQ_ENTRIES]; // this one is not touched by the audio
-                                     // thread!
   VOCHandle vocHandles[MAX_VOC_SEQ_ENTRIES];
+  int sequence[MAX_VOC_SEQ_ENTRIES];
   size_t sequenceSize;
-  int currentSequenceIndex;
-} AudioQueue;
-
-void AudioQueueInit(AudioQueue *queue);
-void AudioQueueReset(AudioQueue *queue, size_t sequenceSize);
+} AudioCommand;
 
+// The game thread is the only producer of commands, the audio callback the
+// only consumer: neither of them takes a lock. The volumes are a state rather
+// than commands, the last value set is read by the next callback.
 typedef struct {
+  AudioBackend backend;
   SDL_AudioDeviceID deviceID;
   SDL_AudioSpec audioSpec;
 
-  // don't access these directly, as they are shared with the audio callback!
-  // use getter/setters below.
-  uint8_t _soundVol; // 0-10
-  uint8_t _musicVol; // 0-10
-  uint8_t _voiceVol; // 0-10
+  // null backend only
+  SNDFILE *wavFile;
+  uint64_t clockRemainder; // ms * rate not mixed yet
+  uint64_t mixedFrames;
+  uint64_t mixNs;
+
+  // game thread side
+  uint8_t soundVol; // 0-10
+  uint8_t musicVol; // 0-10
+  uint8_t voiceVol; // 0-10
+  uint32_t voiceSerial; // of the last voice command sent
+  int pendingVoice;     // first entry of that command, -1 for a stop
+
+  AudioSFXCache sfxCache;
+  // the previous cache, freed once the audio callback has stopped playing it
+  AudioSFXCache retiredSFXCache;
+  unsigned retiredUntil; // commandsTail value
 
-  AudioQueue voiceQueue;
-  AudioQueue soundQueue;
+  AudioCommand commands[AUDIO_COMMAND_RING_SIZE];
+  atomic_uint commandsHead; // written by the game thread
+  atomic_uint commandsTail; // written by the audio callback
+  atomic_uint volumes;      // sound, music and voice, a byte each
+
+  AudioMusic music; // decoded on its own thread
+
+  // audio callback side, don't access these directly
+  AudioChannel channels[AUDIO_NUM_CHANNELS];
+  uint32_t numSoundsStarted;
+
+  // published by the audio callback
+  atomic_uint _voiceSerial; // of the last voice command applied
+  atomic_int _voiceEntry;   // currently played, -1 if none
 } AudioSystem;
 
-int AudioSystemInit(AudioSystem *audioSystem, const GameConfig *conf);
+// wavFile is only used by the null backend, it can be NULL
+int AudioSystemInit(AudioSystem *audioSystem, const GameConfig *conf,
+                    AudioBackend backend, const char *wavFile);
 void AudioSystemRelease(AudioSystem *audioSystem);
+// Null backend only: mixes the next 'ms' of audio on the calling thread, the
+// game clock drives the audio instead of a sound card. The mixing cost is
+// reported on release.
+void AudioSystemAdvance(AudioSystem *audioSystem, uint32_t ms);
 
 void AudioSystemSetSoundVolume(AudioSystem *audioSystem, int8_t vol);
 uint8_t AudioSystemGetSoundVolume(const AudioSystem *audioSystem);
@@ -57,3 +115,27 @@ void AudioSystemPlayVoiceSequence(AudioSystem *audioSystem, const PAKFile *pak,
 int AudioSystemGetCurrentVoiceIndex(const AudioSystem *audioSystem);
 void AudioSystemPlaySoundFX(AudioSystem *audioSystem, const PAKFile *pak,
                             const char *filename);
+// volume 0-255, pan -AUDIO_MAX_PAN (left) to AUDIO_MAX_PAN (right)
+void AudioSystemPlaySoundFXAt(AudioSystem *audioSystem, const PAKFile *pak,
+                              const char *filename, uint8_t volume, int8_t pan);
+
+// Sound effects decoded once, played without reading or parsing the VOC file.
+// Returns 0 if the file is invalid or the cache is full.
+int AudioSystemCacheSoundFX(AudioSystem *audioSystem, uint16_t soundId,
+                            const PAKFile *pak, const char *filename);
+// returns 0 if the sound is not cached
+int AudioSystemPlayCachedSoundFX(AudioSystem *audioSystem, uint16_t soundId,
+                                 uint8_t volume, int8_t pan);
+// stops the cached sounds being played
+void AudioSystemClearSoundFXCache(AudioSystem *audioSystem);
+
+// Streams a VOC file as music, the PAK must stay loaded while it plays.
+// Returns 0 if the file is missing or invalid.
+int AudioSystemPlayMusic(AudioSystem *audioSystem, const PAKFile *pak,
+                         const char *filename, int loop);
+// same, the buffer must stay valid while it plays
+int AudioSystemPlayMusicBuffer(AudioSystem *audioSystem,
+                               const uint8_t *buffer, size_t size, int loop);
+void AudioSystemStopMusic(AudioSystem *audioSystem);
+// returns 1 until the last samples of the music have been mixed
+int AudioSystemIsMusicPlaying(AudioSystem *audioSystem);
@@ -0,0 +1,143 @@
+#include "audio_mixer.h"
+#include <string.h>
+
+#define FRAC_ONE (UINT32_C(1) << AUDIO_FRAC_BITS)
+#define FRAC_MASK (FRAC_ONE - 1)
+
+void AudioQueueInit(AudioQueue *queue) { memset(queue, 0, sizeof(AudioQueue)); }
+
+void AudioQueueReset(AudioQueue *queue, size_t sequenceSize) {
+  queue->currentBlock = NULL;
+  queue->position = 0;
+  queue->currentSequenceIndex = 0;
+  queue->sequenceSize = sequenceSize;
+}
+
+// returns the number of U8 samples of the block, 0 for the blocks without
+// sound
+static uint32_t getBlockSamples(AudioQueue *queue, uint32_t outRate,
+                                const uint8_t **samples) {
+  const VOCBlock *block = queue->currentBlock;
+  const uint8_t *data = VOCBlockGetData(block);
+  uint32_t size = VOCBlockGetSize(block);
+  switch (block->type) {
+  case VOCBlockType_SoundDataTyped: {
+    if (size <= 2) {
+      return 0;
+    }
+    // freqDivisor, codec then the samples
+    uint32_t inRate = 1000000 / (256 - data[0]);
+    queue->step = (uint32_t)(((uint64_t)inRate << AUDIO_FRAC_BITS) / outRate);
+    *samples = data + 2;
+    return size - 2;
+  }
+  case VOCBlockType_SoundDataUntyped:
+    // same rate as the previous block
+    *samples = data;
+    return queue->step ? size : 0;
+  default:
+    return 0;
+  }
+}
+
+// moves to the next block, then to the next VOC of the sequence. Returns 0
+// when the sequence is done.
+static int nextBlock(AudioQueue *queue) {
+  const VOCHandle *handle = queue->vocHandles + queue->currentSequenceIndex;
+  if (queue->currentBlock == NULL) {
+    queue->currentBlock = handle->firstBlock;
+    return queue->currentBlock != NULL;
+  }
+  queue->currentBlock = VOCHandleGetNextBlock(handle, queue->currentBlock);
+  if (queue->currentBlock) {
+    return 1;
+  }
+  if (queue->currentSequenceIndex + 1 >= queue->sequenceSize) {
+    queue->sequenceSize = 0;
+    return 0;
+  }
+  queue->currentSequenceIndex++;
+  queue->currentBlock = queue->vocHandles[queue->currentSequenceIndex].firstBlock;
+  return queue->currentBlock != NULL;
+}
+
+static size_t mixPCM(AudioChannel *channel, int32_t *acc, size_t numFrames,
+                     int32_t gainL, int32_t gainR) {
+  size_t count = channel->pcmFrames - channel->pcmPosition;
+  if (count > numFrames) {
+    count = numFrames;
+  }
+  const int16_t *samples = channel->pcm + channel->pcmPosition;
+  for (size_t i = 0; i < count; i++) {
+    acc[0] += (samples[i] * gainL) >> 15;
+    acc[1] += (samples[i] * gainR) >> 15;
+    acc += AUDIO_OUTPUT_CHANNELS;
+  }
+  channel->pcmPosition += count;
+  if (channel->pcmPosition == channel->pcmFrames) {
+    channel->pcm = NULL;
+  }
+  return count;
+}
+
+size_t AudioChannelMix(AudioChannel *channel, int32_t *acc, size_t numFrames,
+                       int32_t gain, uint32_t outRate) {
+  AudioQueue *queue = &channel->queue;
+  gain = gain * channel->volume / 255;
+  int32_t pan = channel->pan;
+  int32_t gainL = pan > 0 ? gain * (AUDIO_MAX_PAN - pan) / AUDIO_MAX_PAN : gain;
+  int32_t gainR = pan < 0 ? gain * (AUDIO_MAX_PAN + pan) / AUDIO_MAX_PAN : gain;
+  if (channel->pcm) {
+    return mixPCM(channel, acc, numFrames, gainL, gainR);
+  }
+  if (queue->sequenceSize == 0 || outRate == 0) {
+    return 0;
+  }
+
+  if (queue->currentBlock == NULL && !nextBlock(queue)) {
+    queue->sequenceSize = 0;
+    return 0;
+  }
+  const size_t totalFrames = numFrames;
+  while (numFrames) {
+    const uint8_t *samples = NULL;
+    uint32_t numSamples = getBlockSamples(queue, outRate, &samples);
+    uint64_t end = (uint64_t)numSamples << AUDIO_FRAC_BITS;
+    if (queue->position >= end) {
+      queue->position -= end;
+      if (!nextBlock(queue)) {
+        return totalFrames - numFrames;
+      }
+      continue;
+    }
+    const uint32_t step = queue->step;
+    size_t count = (end - queue->position + step - 1) / step;
+    if (count > numFrames) {
+      count = numFrames;
+    }
+    uint64_t pos = queue->position;
+    const uint32_t last = numSamples - 1;
+    for (size_t i = 0; i < count; i++) {
+      uint32_t index = (uint32_t)(pos >> AUDIO_FRAC_BITS);
+      uint32_t next = index < last ? index + 1 : last;
+      int32_t a = samples[index] - 0X80;
+      int32_t b = samples[next] - 0X80;
+      // 8 bits samples to 16 bits, interpolated
+      int32_t v = a * 256 + (((b - a) * (int32_t)(pos & FRAC_MASK)) >> 8);
+      acc[0] += (v * gainL) >> 15;
+      acc[1] += (v * gainR) >> 15;
+      acc += AUDIO_OUTPUT_CHANNELS;
+      pos += step;
+    }
+    queue->position = pos;
+    numFrames -= count;
+  }
+  return totalFrames;
+}
+
+void AudioMixerWrite(const int32_t *acc, int16_t *out, size_t numSamples) {
+  for (size_t i = 0; i < numSamples; i++) {
+    int32_t v = acc[i];
+    out[i] = v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v);
+  }
+}
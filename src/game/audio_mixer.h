@@ -0,0 +1,51 @@
+#pragma once
+#include "formats/format_voc.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_VOC_SEQ_ENTRIES 6
+#define AUDIO_NUM_CHANNELS 8
+#define AUDIO_OUTPUT_CHANNELS 2 // stereo
+// positions in the source samples are 16.16 fixed point
+#define AUDIO_FRAC_BITS 16
+#define AUDIO_MAX_PAN 127
+
+typedef struct {
+  const VOCBlock *currentBlock;
+  uint64_t position; // in the current block, blocks can exceed 16 bits
+  uint32_t step;     // source samples per output sample
+
+  int sequence[MAX_VOC_SEQ_ENTRIES];
+  VOCHandle vocHandles[MAX_VOC_SEQ_ENTRIES];
+  size_t sequenceSize;
+  int currentSequenceIndex;
+} AudioQueue;
+
+void AudioQueueInit(AudioQueue *queue);
+void AudioQueueReset(AudioQueue *queue, size_t sequenceSize);
+
+// a channel plays either a decoded sound (pcm) or a sequence of VOC files
+typedef struct {
+  AudioQueue queue;
+  const int16_t *pcm; // mono, at the output rate
+  uint32_t pcmFrames;
+  uint32_t pcmPosition;
+
+  uint8_t volume; // 0-255, on top of the sound or voice volume
+  int8_t pan;     // -AUDIO_MAX_PAN (left) to AUDIO_MAX_PAN (right)
+  uint32_t startSerial; // the oldest channel is reused first
+} AudioChannel;
+
+static inline int AudioChannelIsPlaying(const AudioChannel *channel) {
+  return channel->pcm != NULL || channel->queue.sequenceSize != 0;
+}
+
+// Resamples the VOC data of the channel to outRate and adds it to the
+// interleaved stereo accumulator. gain is 0-INT16_MAX, 1 << 15 keeps the
+// samples unchanged. Returns the number of frames mixed, less than numFrames
+// when the sound ends.
+size_t AudioChannelMix(AudioChannel *channel, int32_t *acc, size_t numFrames,
+                       int32_t gain, uint32_t outRate);
+
+// saturates the accumulated samples to int16
+void AudioMixerWrite(const int32_t *acc, int16_t *out, size_t numSamples);
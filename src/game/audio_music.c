@@ -0,0 +1,268 @@
+#include "audio_music.h"
+#include "profiler.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define RING_MASK (AUDIO_MUSIC_RING_FRAMES - 1)
+
+static void startTrack(AudioMusic *music, const VOCHandle *track, int loop) {
+  AudioQueue *queue = &music->channel.queue;
+  music->channel.pcm = NULL;
+  music->loop = loop;
+  if (track->firstBlock == NULL) {
+    AudioQueueReset(queue, 0);
+    atomic_store_explicit(&music->playing, 0, memory_order_relaxed);
+    return;
+  }
+  queue->vocHandles[0] = *track;
+  queue->sequence[0] = 0;
+  AudioQueueReset(queue, 1);
+  music->fadeIn = AUDIO_MUSIC_FADE_FRAMES;
+  atomic_store_explicit(&music->playing, 1, memory_order_relaxed);
+}
+
+static void applyFades(AudioMusic *music, int32_t *out, size_t numFrames) {
+  for (size_t i = 0; i < numFrames; i++) {
+    int32_t fade = AUDIO_MUSIC_FADE_FRAMES;
+    if (music->switching) {
+      fade = music->fadeOut--;
+    } else if (music->fadeIn) {
+      fade = AUDIO_MUSIC_FADE_FRAMES - music->fadeIn--;
+    } else {
+      return;
+    }
+    for (int c = 0; c < AUDIO_OUTPUT_CHANNELS; c++) {
+      out[i * AUDIO_OUTPUT_CHANNELS + c] =
+          out[i * AUDIO_OUTPUT_CHANNELS + c] * fade / AUDIO_MUSIC_FADE_FRAMES;
+    }
+  }
+}
+
+// decodes the next frames of the current track, with its loops and fades
+static void decode(AudioMusic *music, int32_t *acc, size_t numFrames) {
+  memset(acc, 0, numFrames * AUDIO_OUTPUT_CHANNELS * sizeof(int32_t));
+  size_t done = 0;
+  int restarted = 0;
+  while (done < numFrames && AudioChannelIsPlaying(&music->channel)) {
+    size_t count = numFrames - done;
+    if (music->switching && (size_t)music->fadeOut < count) {
+      count = music->fadeOut;
+    }
+    int32_t *out = acc + done * AUDIO_OUTPUT_CHANNELS;
+    size_t mixed =
+        AudioChannelMix(&music->channel, out, count, 1 << 15, music->outRate);
+    applyFades(music, out, mixed);
+    done += mixed;
+    if (mixed) {
+      restarted = 0;
+    }
+    int ended = !AudioChannelIsPlaying(&music->channel);
+    if (music->switching && (music->fadeOut == 0 || ended)) {
+      music->switching = 0;
+      startTrack(music, &music->pendingTrack, music->pendingLoop);
+    } else if (ended && music->loop && !restarted) {
+      // a track without samples is not restarted forever
+      AudioQueueReset(&music->channel.queue, 1);
+      restarted = 1;
+    }
+  }
+  if (!AudioChannelIsPlaying(&music->channel)) {
+    atomic_store_explicit(&music->playing, 0, memory_order_relaxed);
+  }
+}
+
+static void produce(AudioMusic *music, unsigned writePos) {
+  uint64_t start = ProfilerNow();
+  int32_t acc[AUDIO_MUSIC_CHUNK_FRAMES * AUDIO_OUTPUT_CHANNELS];
+  decode(music, acc, AUDIO_MUSIC_CHUNK_FRAMES);
+  for (int i = 0; i < AUDIO_MUSIC_CHUNK_FRAMES; i++) {
+    int16_t *frame =
+        music->ring + ((writePos + i) & RING_MASK) * AUDIO_OUTPUT_CHANNELS;
+    AudioMixerWrite(acc + i * AUDIO_OUTPUT_CHANNELS, frame,
+                    AUDIO_OUTPUT_CHANNELS);
+  }
+  atomic_store_explicit(&music->writePos, writePos + AUDIO_MUSIC_CHUNK_FRAMES,
+                        memory_order_release);
+  atomic_fetch_add_explicit(&music->decodeNs, ProfilerNow() - start,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&music->decodedFrames, AUDIO_MUSIC_CHUNK_FRAMES,
+                            memory_order_relaxed);
+}
+
+// called with the lock held
+static void applyRequest(AudioMusic *music) {
+  music->hasRequest = 0;
+  music->pendingTrack = music->nextTrack;
+  music->pendingLoop = music->nextLoop;
+  if (!AudioChannelIsPlaying(&music->channel)) {
+    startTrack(music, &music->pendingTrack, music->pendingLoop);
+    return;
+  }
+  // fade out the current track first, from its current level
+  if (!music->switching) {
+    music->switching = 1;
+    music->fadeOut = AUDIO_MUSIC_FADE_FRAMES - music->fadeIn;
+    music->fadeIn = 0;
+  }
+}
+
+// called with the lock held, returns 1 if a chunk was decoded
+static int step(AudioMusic *music) {
+  if (music->hasRequest) {
+    applyRequest(music);
+  }
+  unsigned writePos =
+      atomic_load_explicit(&music->writePos, memory_order_relaxed);
+  unsigned readPos =
+      atomic_load_explicit(&music->readPos, memory_order_acquire);
+  if (AUDIO_MUSIC_RING_FRAMES - (writePos - readPos) <
+          AUDIO_MUSIC_CHUNK_FRAMES ||
+      !AudioChannelIsPlaying(&music->channel)) {
+    return 0;
+  }
+  pthread_mutex_unlock(&music->lock);
+  produce(music, writePos);
+  pthread_mutex_lock(&music->lock);
+  return 1;
+}
+
+static void *producerMain(void *arg) {
+  AudioMusic *music = arg;
+  // the producer wakes up about twice per chunk played
+  const long waitNs = 500000000L * AUDIO_MUSIC_CHUNK_FRAMES / music->outRate;
+  pthread_mutex_lock(&music->lock);
+  while (!music->quit) {
+    if (step(music)) {
+      continue;
+    }
+    if (!AudioChannelIsPlaying(&music->channel)) {
+      // nothing to decode until the next request
+      pthread_cond_wait(&music->cond, &music->lock);
+      continue;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += waitNs;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&music->cond, &music->lock, &deadline);
+  }
+  pthread_mutex_unlock(&music->lock);
+  return NULL;
+}
+
+int AudioMusicInit(AudioMusic *music, uint32_t outRate, int threaded) {
+  memset(music, 0, sizeof(AudioMusic));
+  atomic_init(&music->writePos, 0);
+  atomic_init(&music->readPos, 0);
+  atomic_init(&music->playing, 0);
+  atomic_init(&music->underruns, 0);
+  atomic_init(&music->decodeNs, 0);
+  atomic_init(&music->decodedFrames, 0);
+  AudioQueueInit(&music->channel.queue);
+  music->channel.volume = 255;
+  music->outRate = outRate;
+  music->threaded = threaded;
+  pthread_mutex_init(&music->lock, NULL);
+  pthread_cond_init(&music->cond, NULL);
+  music->initialized = 1;
+  return 1;
+}
+
+void AudioMusicRelease(AudioMusic *music) {
+  if (!music->initialized) {
+    return;
+  }
+  if (music->threadStarted) {
+    pthread_mutex_lock(&music->lock);
+    music->quit = 1;
+    pthread_cond_signal(&music->cond);
+    pthread_mutex_unlock(&music->lock);
+    pthread_join(music->thread, NULL);
+    music->threadStarted = 0;
+  }
+  pthread_cond_destroy(&music->cond);
+  pthread_mutex_destroy(&music->lock);
+  music->initialized = 0;
+}
+
+void AudioMusicPump(AudioMusic *music) {
+  if (!music->initialized || music->threaded) {
+    return;
+  }
+  pthread_mutex_lock(&music->lock);
+  while (step(music)) {
+  }
+  pthread_mutex_unlock(&music->lock);
+}
+
+static void postRequest(AudioMusic *music, const VOCHandle *track, int loop) {
+  if (!music->initialized) {
+    return;
+  }
+  // the thread is only started once there is some music to play
+  if (music->threaded && !music->threadStarted) {
+    if (pthread_create(&music->thread, NULL, producerMain, music) != 0) {
+      printf("AudioMusic: unable to start the music thread\n");
+      return;
+    }
+    music->threadStarted = 1;
+  }
+  pthread_mutex_lock(&music->lock);
+  music->nextTrack = *track;
+  music->nextLoop = loop;
+  music->hasRequest = 1;
+  pthread_cond_signal(&music->cond);
+  pthread_mutex_unlock(&music->lock);
+}
+
+void AudioMusicPlay(AudioMusic *music, const VOCHandle *track, int loop) {
+  postRequest(music, track, loop);
+}
+
+void AudioMusicStop(AudioMusic *music) {
+  VOCHandle none = {0};
+  postRequest(music, &none, 0);
+}
+
+int AudioMusicIsPlaying(AudioMusic *music) {
+  if (!music->initialized) {
+    return 0;
+  }
+  pthread_mutex_lock(&music->lock);
+  int pending = music->hasRequest && music->nextTrack.firstBlock != NULL;
+  pthread_mutex_unlock(&music->lock);
+  return pending ||
+         atomic_load_explicit(&music->playing, memory_order_relaxed) ||
+         atomic_load_explicit(&music->readPos, memory_order_acquire) !=
+             atomic_load_explicit(&music->writePos, memory_order_acquire);
+}
+
+void AudioMusicMix(AudioMusic *music, int32_t *acc, size_t numFrames,
+                   int32_t gain) {
+  unsigned readPos =
+      atomic_load_explicit(&music->readPos, memory_order_relaxed);
+  unsigned writePos =
+      atomic_load_explicit(&music->writePos, memory_order_acquire);
+  size_t count = writePos - readPos;
+  if (count < numFrames &&
+      atomic_load_explicit(&music->playing, memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&music->underruns, 1, memory_order_relaxed);
+  }
+  if (count > numFrames) {
+    count = numFrames;
+  }
+  for (size_t i = 0; i < count; i++) {
+    const int16_t *frame =
+        music->ring + ((readPos + i) & RING_MASK) * AUDIO_OUTPUT_CHANNELS;
+    acc[0] += (frame[0] * gain) >> 15;
+    acc[1] += (frame[1] * gain) >> 15;
+    acc += AUDIO_OUTPUT_CHANNELS;
+  }
+  atomic_store_explicit(&music->readPos, readPos + count,
+                        memory_order_release);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "audio_mixer.h"
+#include "formats/format_voc.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AUDIO_MUSIC_RING_FRAMES 4096 // power of 2, ~190ms at 22050Hz
+#define AUDIO_MUSIC_CHUNK_FRAMES 512 // decoded at once by the producer
+#define AUDIO_MUSIC_FADE_FRAMES 256  // when a track starts or stops
+
+// Music is decoded on its own thread into a PCM ring read by the audio
+// callback: the callback only copies samples and the game thread only posts
+// requests. Switching tracks fades the current one out and the next one in,
+// the switch is heard once the samples already in the ring are played.
+typedef struct {
+  // the producer is the only writer of the samples and writePos, the audio
+  // callback the only writer of readPos
+  int16_t ring[AUDIO_MUSIC_RING_FRAMES * AUDIO_OUTPUT_CHANNELS];
+  atomic_uint writePos; // in frames
+  atomic_uint readPos;  // in frames
+  atomic_int playing;   // set by the producer while a track is decoded
+  atomic_uint underruns;
+  atomic_uint_least64_t decodeNs; // time spent by the producer
+  atomic_uint_least64_t decodedFrames;
+
+  // requests from the game thread
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  int initialized;
+  int threaded;
+  int threadStarted; // on the first request
+  int hasRequest;
+  int quit;
+  VOCHandle nextTrack; // no block to stop the music
+  int nextLoop;
+
+  // producer side
+  uint32_t outRate;
+  AudioChannel channel;
+  int loop;
+  int fadeIn;  // frames left
+  int fadeOut; // frames left, then the pending track starts
+  int switching;
+  VOCHandle pendingTrack;
+  int pendingLoop;
+} AudioMusic;
+
+// With threaded, the producer thread is started by the first request. Without
+// it, the music is decoded by AudioMusicPump.
+int AudioMusicInit(AudioMusic *music, uint32_t outRate, int threaded);
+void AudioMusicRelease(AudioMusic *music);
+// fills the ring on the calling thread, only when there's no producer thread
+void AudioMusicPump(AudioMusic *music);
+
+// the VOC data must stay valid until the next track starts
+void AudioMusicPlay(AudioMusic *music, const VOCHandle *track, int loop);
+void AudioMusicStop(AudioMusic *music);
+// returns 1 until the last samples of the track have been mixed
+int AudioMusicIsPlaying(AudioMusic *music);
+
+// audio callback side, adds the decoded samples to the accumulator
+void AudioMusicMix(AudioMusic *music, int32_t *acc, size_t numFrames,
+                   int32_t gain);
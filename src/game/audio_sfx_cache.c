@@ -0,0 +1,100 @@
+#include "audio_sfx_cache.h"
+#include "audio_mixer.h"
+#include "formats/format_voc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DECODE_FRAMES 1024
+
+void AudioSFXCacheInit(AudioSFXCache *cache) {
+  memset(cache, 0, sizeof(AudioSFXCache));
+}
+
+void AudioSFXCacheRelease(AudioSFXCache *cache) {
+  for (int i = 0; i < cache->numEntries; i++) {
+    free(cache->entries[i].samples);
+  }
+  AudioSFXCacheInit(cache);
+}
+
+const AudioSFX *AudioSFXCacheGet(const AudioSFXCache *cache, uint16_t soundId) {
+  for (int i = 0; i < cache->numEntries; i++) {
+    if (cache->entries[i].soundId == soundId) {
+      return cache->entries + i;
+    }
+  }
+  return NULL;
+}
+
+// runs the mixer's resampler on the file, so that the cached sound is the same
+// as the one played from the VOC file
+static int16_t *decode(const VOCHandle *handle, uint32_t outRate,
+                       size_t maxFrames, uint32_t *numFrames) {
+  AudioChannel channel = {0};
+  AudioQueueInit(&channel.queue);
+  channel.queue.vocHandles[0] = *handle;
+  AudioQueueReset(&channel.queue, 1);
+  channel.volume = 255;
+
+  int16_t *samples = NULL;
+  size_t count = 0;
+  int32_t acc[DECODE_FRAMES * AUDIO_OUTPUT_CHANNELS];
+  while (AudioChannelIsPlaying(&channel)) {
+    if (count + DECODE_FRAMES > maxFrames) {
+      free(samples);
+      return NULL;
+    }
+    int16_t *newSamples =
+        realloc(samples, (count + DECODE_FRAMES) * sizeof(int16_t));
+    if (!newSamples) {
+      free(samples);
+      return NULL;
+    }
+    samples = newSamples;
+    memset(acc, 0, sizeof(acc));
+    AudioChannelMix(&channel, acc, DECODE_FRAMES, 1 << 15, outRate);
+    for (int i = 0; i < DECODE_FRAMES; i++) {
+      samples[count + i] = acc[i * AUDIO_OUTPUT_CHANNELS];
+    }
+    count += DECODE_FRAMES;
+  }
+  // the last chunk is padded with silence
+  while (count && samples[count - 1] == 0) {
+    count--;
+  }
+  int16_t *trimmed = realloc(samples, (count ? count : 1) * sizeof(int16_t));
+  if (trimmed) {
+    samples = trimmed;
+  }
+  *numFrames = count;
+  return samples;
+}
+
+const AudioSFX *AudioSFXCacheAdd(AudioSFXCache *cache, uint16_t soundId,
+                                 const uint8_t *buffer, size_t bufferSize,
+                                 uint32_t outRate) {
+  const AudioSFX *sfx = AudioSFXCacheGet(cache, soundId);
+  if (sfx) {
+    return sfx;
+  }
+  if (cache->numEntries == AUDIO_SFX_CACHE_SIZE) {
+    return NULL;
+  }
+  VOCHandle handle = {0};
+  if (!VOCHandleFromBuffer(&handle, buffer, bufferSize)) {
+    printf("AudioSFXCacheAdd: invalid VOC file for sound %i\n", soundId);
+    return NULL;
+  }
+  size_t maxFrames =
+      (AUDIO_SFX_CACHE_MAX_BYTES - cache->numBytes) / sizeof(int16_t);
+  AudioSFX *entry = cache->entries + cache->numEntries;
+  entry->samples = decode(&handle, outRate, maxFrames, &entry->numFrames);
+  if (!entry->samples) {
+    return NULL;
+  }
+  entry->soundId = soundId;
+  cache->numBytes += entry->numFrames * sizeof(int16_t);
+  cache->numEntries++;
+  return entry;
+}
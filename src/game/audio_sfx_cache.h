@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define AUDIO_SFX_CACHE_SIZE 64
+#define AUDIO_SFX_CACHE_MAX_BYTES (4 * 1024 * 1024)
+
+// a sound effect decoded to mono int16 at the output rate, ready to be mixed
+typedef struct {
+  uint16_t soundId;
+  int16_t *samples;
+  uint32_t numFrames;
+} AudioSFX;
+
+typedef struct {
+  AudioSFX entries[AUDIO_SFX_CACHE_SIZE];
+  int numEntries;
+  size_t numBytes;
+} AudioSFXCache;
+
+void AudioSFXCacheInit(AudioSFXCache *cache);
+void AudioSFXCacheRelease(AudioSFXCache *cache);
+
+const AudioSFX *AudioSFXCacheGet(const AudioSFXCache *cache, uint16_t soundId);
+// decodes the VOC file, returns NULL if it's invalid or the cache is full
+const AudioSFX *AudioSFXCacheAdd(AudioSFXCache *cache, uint16_t soundId,
+                                 const uint8_t *buffer, size_t bufferSize,
+                                 uint32_t outRate);
@@ -24,6 +24,10 @@ int GameConfigFromFile(GameConfig *config, const char *filepath) {
   config->showMonstersInMap = ConfigHandleGetValueFloat(
       &h, CONF_KEY_AUTOMAP_SHOW_MONSTERS, config->showMonstersInMap);
   config->debug = ConfigHandleGetValueFloat(&h, CONF_KEY_DEBUG, config->debug);
+  config->frameBudgetMs = ConfigHandleGetValueFloat(&h, CONF_KEY_FRAME_BUDGET,
+                                                    config->frameBudgetMs);
+  config->scriptBudgetUs = ConfigHandleGetValueFloat(
+      &h, CONF_KEY_SCRIPT_BUDGET, config->scriptBudgetUs);
   ConfigHandleRelease(&h);
   return 1;
 }
@@ -53,6 +57,12 @@ int GameConfigWriteFile(const GameConfig *config, const char *filepath) {
   if (config->debug) {
     ConfigHandleSetValueInt(&h, CONF_KEY_DEBUG, 1);
   }
+  if (config->frameBudgetMs) {
+    ConfigHandleSetValueInt(&h, CONF_KEY_FRAME_BUDGET, config->frameBudgetMs);
+  }
+  if (config->scriptBudgetUs) {
+    ConfigHandleSetValueInt(&h, CONF_KEY_SCRIPT_BUDGET, config->scriptBudgetUs);
+  }
   int ret = ConfigHandleWriteFile(&h, filepath);
   ConfigHandleRelease(&h);
   return ret;
@@ -9,6 +9,8 @@
 #define CONF_KEY_NO_CLIP "noClip"
 #define CONF_KEY_AUTOMAP_SHOW_MONSTERS "monstersInAutomap"
 #define CONF_KEY_DEBUG "debug"
+#define CONF_KEY_FRAME_BUDGET "frameBudgetMs"
+#define CONF_KEY_SCRIPT_BUDGET "scriptBudgetUs"
 
 typedef struct {
   uint8_t soundVol;
@@ -20,6 +22,8 @@ typedef struct {
   int noClip;
   int showMonstersInMap;
   int debug;
+  int frameBudgetMs; // 0: no slow frame recording
+  int scriptBudgetUs; // 0: default budget
 } GameConfig;
 
 int GameConfigFromFile(GameConfig *config, const char *filepath);
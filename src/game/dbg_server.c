@@ -1,11 +1,15 @@
 #include "dbg_server.h"
 #include "dbg_msgs.h"
+#include "flight_recorder.h"
 #include "game_ctx.h"
 #include "logger.h"
+#include "script_profiler.h"
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,13 +23,176 @@ int cltSocket = -1;
 int recvDataSize;
 static uint8_t recvBuf[1024];
 
+#define DBG_SEND_TIMEOUT_MS 1000
+#define DBG_LOG_LINE_SIZE 256
+#define DBG_STREAM_LINES 4096
+
+// a log message that the socket only took in part, sent before anything else
+static uint8_t pendingBuf[sizeof(DBGMsg_Header) + DBG_LOG_LINE_SIZE];
+static size_t pendingSize = 0;
+static unsigned droppedLines = 0;
+
+// lines of the flight recorder dumps, queued by its writer thread and sent by
+// DBGServerUpdate
+static struct {
+  pthread_mutex_t lock;
+  char lines[DBG_STREAM_LINES][DBG_LOG_LINE_SIZE];
+  unsigned head;
+  unsigned tail;
+} _stream = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void closeClient(void) {
+  FlightRecorderSetStreamSink(NULL);
+  close(cltSocket);
+  cltSocket = -1;
+  pendingSize = 0;
+}
+
+// the client socket is non-blocking, but a partial message would break the
+// framing: waits for the socket to be writable, and drops the client on error
+static int sendAll(const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  while (size && cltSocket != -1) {
+    ssize_t ret = write(cltSocket, bytes, size);
+    if (ret > 0) {
+      bytes += ret;
+      size -= ret;
+      continue;
+    }
+    if (ret == -1 && errno == EINTR) {
+      continue;
+    }
+    if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd pfd = {.fd = cltSocket, .events = POLLOUT};
+      int ready = poll(&pfd, 1, DBG_SEND_TIMEOUT_MS);
+      if (ready > 0 || (ready == -1 && errno == EINTR)) {
+        continue;
+      }
+      printf("DBGServer: client not reading, closing the connection\n");
+    } else {
+      perror("DBGServer write");
+    }
+    closeClient();
+  }
+  return cltSocket != -1;
+}
+
+// returns the number of bytes written, -1 if the client was dropped
+static ssize_t writeNoWait(const void *data, size_t size) {
+  ssize_t ret;
+  do {
+    ret = write(cltSocket, data, size);
+  } while (ret == -1 && errno == EINTR);
+  if (ret == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    }
+    perror("DBGServer write");
+    closeClient();
+  }
+  return ret;
+}
+
+// returns 1 once nothing is left of the partial message
+static int flushPending(void) {
+  if (pendingSize == 0) {
+    return 1;
+  }
+  ssize_t ret = writeNoWait(pendingBuf, pendingSize);
+  if (ret <= 0) {
+    return 0;
+  }
+  pendingSize -= ret;
+  memmove(pendingBuf, pendingBuf + ret, pendingSize);
+  return pendingSize == 0;
+}
+
+static void sendMsg(DBGMsgType type, const void *data, size_t size) {
+  if (pendingSize && sendAll(pendingBuf, pendingSize)) {
+    pendingSize = 0;
+  }
+  DBGMsg_Header header = {.type = type, size};
+  if (sendAll(&header, sizeof(DBGMsg_Header)) && size) {
+    sendAll(data, size);
+  }
+}
+
+// logs don't wait for the client: the line is dropped when the socket is full
+static void sendLogLine(const char *line, size_t len) {
+  if (cltSocket == -1) {
+    return;
+  }
+  if (!flushPending()) {
+    droppedLines++;
+    return;
+  }
+  uint8_t msg[sizeof(DBGMsg_Header) + DBG_LOG_LINE_SIZE];
+  DBGMsg_Header header = {.type = DBGMsgType_LogMessage, len};
+  memcpy(msg, &header, sizeof(DBGMsg_Header));
+  memcpy(msg + sizeof(DBGMsg_Header), line, len);
+  size_t size = sizeof(DBGMsg_Header) + len;
+  ssize_t ret = writeNoWait(msg, size);
+  if (ret == 0) {
+    droppedLines++;
+  } else if (ret > 0 && ret < size) {
+    pendingSize = size - ret;
+    memcpy(pendingBuf, msg + ret, pendingSize);
+  }
+}
+
+static size_t formatLine(char *line, const char *prefix, const char *fmt,
+                         va_list args) {
+  int len = snprintf(line, DBG_LOG_LINE_SIZE, "[%s] ", prefix);
+  len += vsnprintf(line + len, DBG_LOG_LINE_SIZE - len, fmt, args);
+  if (len >= DBG_LOG_LINE_SIZE) {
+    len = DBG_LOG_LINE_SIZE - 1;
+  }
+  return len;
+}
+
+static void remoteLogFunc(const char *prefix, const char *fmt, va_list args) {
+  if (cltSocket == -1) {
+    return;
+  }
+  char line[DBG_LOG_LINE_SIZE];
+  size_t len = formatLine(line, prefix, fmt, args);
+  sendLogLine(line, len);
+}
+
+static Logger _remoteLogger = {.func = remoteLogFunc};
+
+static void streamLogFunc(const char *prefix, const char *fmt, va_list args) {
+  pthread_mutex_lock(&_stream.lock);
+  if (_stream.head - _stream.tail < DBG_STREAM_LINES) {
+    formatLine(_stream.lines[_stream.head % DBG_STREAM_LINES], prefix, fmt,
+               args);
+    _stream.head++;
+  }
+  pthread_mutex_unlock(&_stream.lock);
+}
+
+static Logger _streamLogger = {.func = streamLogFunc};
+
+static void sendStreamLines(void) {
+  pthread_mutex_lock(&_stream.lock);
+  for (; _stream.tail != _stream.head; _stream.tail++) {
+    const char *line = _stream.lines[_stream.tail % DBG_STREAM_LINES];
+    sendLogLine(line, strlen(line));
+  }
+  pthread_mutex_unlock(&_stream.lock);
+  if (droppedLines) {
+    printf("DBGServer: %u log lines dropped\n", droppedLines);
+    droppedLines = 0;
+  }
+}
+
 void DBGServerRelease(void) {
   printf("DBGServerRelease\n");
+  FlightRecorderSetStreamSink(NULL);
+  sendMsg(DBGMsgType_Goodbye, NULL, 0);
   if (cltSocket != -1) {
-    DBGMsg_Header outHeader = {.type = DBGMsgType_Goodbye, 0};
-    write(cltSocket, &outHeader, sizeof(DBGMsg_Header));
+    closeClient();
   }
-  close(cltSocket);
 }
 
 int DBGServerInit(void) {
@@ -65,54 +232,43 @@ static int processRecvMsg(GameContext *gameCtx, const DBGMsg_Header *header,
   case DBGMsgType_StatusRequest: {
     printf("received StatusRequest\n");
     printGameState(gameCtx);
-    DBGMsg_Header outHeader = {.type = DBGMsgType_StatusResponse,
-                               sizeof(DBGMsg_Status)};
-    write(cltSocket, &outHeader, sizeof(DBGMsg_Header));
     DBGMsg_Status s = {.currentBock = gameCtx->currentBock};
     memcpy(s.gameFlags, gameCtx->engine->gameFlags, NUM_GAME_FLAGS);
-    write(cltSocket, &s, sizeof(DBGMsg_Status));
+    sendMsg(DBGMsgType_StatusResponse, &s, sizeof(DBGMsg_Status));
   } break;
   case DBGMsgType_GiveItemRequest: {
     const DBGMSG_GiveItemRequest *req = (const DBGMSG_GiveItemRequest *)buffer;
     printf("received GiveItemRequest 0X%0X\n", req->itemId);
-    DBGMsg_Header outHeader = {.type = DBGMsgType_GiveItemResponse,
-                               sizeof(DBGMSG_GiveItemResponse)};
-    write(cltSocket, &outHeader, sizeof(DBGMsg_Header));
     DBGMSG_GiveItemResponse resp;
     resp.response = GameContextAddItemToInventory(gameCtx, req->itemId);
-    write(cltSocket, &resp, sizeof(DBGMSG_GiveItemResponse));
+    sendMsg(DBGMsgType_GiveItemResponse, &resp,
+            sizeof(DBGMSG_GiveItemResponse));
     return 1;
   };
   case DBGMsgType_QuitRequest: {
     printf("received DBGMSGQuitRequest\n");
     gameCtx->_shouldRun = 0;
 
-    DBGMsg_Header outHeader = {.type = DBGMsgType_QuitResponse,
-                               sizeof(DBGMSG_QuitResponse)};
-    write(cltSocket, &outHeader, sizeof(DBGMsg_Header));
     DBGMSG_QuitResponse resp;
     resp.response = 1;
-    write(cltSocket, &resp, sizeof(DBGMSG_QuitResponse));
+    sendMsg(DBGMsgType_QuitResponse, &resp, sizeof(DBGMSG_QuitResponse));
     return 1;
   }
   case DBGMsgType_SetStateRequest: {
     const DBGMSG_SetStateRequest *req = (const DBGMSG_SetStateRequest *)buffer;
     printf("received DBGMSGSetStateRequest 0X%0X\n", req->state);
     GameContextSetState(gameCtx, req->state);
-    DBGMsg_Header outHeader = {.type = DBGMsgType_SetStateResponse,
-                               sizeof(DBGMSG_SetStateResponse)};
-    write(cltSocket, &outHeader, sizeof(DBGMsg_Header));
     DBGMSG_SetStateResponse resp;
     resp.response = 1;
-    write(cltSocket, &resp, sizeof(DBGMSG_SetStateResponse));
+    sendMsg(DBGMsgType_SetStateResponse, &resp,
+            sizeof(DBGMSG_SetStateResponse));
     return 1;
   }
   case DBGMsgType_NoClipRequest: {
     gameCtx->conf.noClip = !gameCtx->conf.noClip;
     printf("received NoClipRequest, setting no clip to %i\n",
            gameCtx->conf.noClip);
-    DBGMsg_Header outHeader = {.type = DBGMsgType_NoClipResponse, 0};
-    write(cltSocket, &outHeader, sizeof(DBGMsg_Header));
+    sendMsg(DBGMsgType_NoClipResponse, NULL, 0);
     return 1;
   }
   case DBGMsgType_SetLoggerRequest: {
@@ -128,21 +284,48 @@ static int processRecvMsg(GameContext *gameCtx, const DBGMsg_Header *header,
         LoggerSetOutput(NULL);
       }
     } else {
-      if (req->enable) {
-        LogEnablePrefix(req->prefix);
+      int category = LogCategoryFromName(req->prefix);
+      if (category == -1) {
+        printf("Unknown log category '%s'\n", req->prefix);
+      } else if (req->enable) {
+        LogEnableCategory(category);
       } else {
-        LogDisablePrefix(req->prefix);
+        LogDisableCategory(category);
       }
     }
-    DBGMsg_Header outHeader = {.type = DBGMsgType_SetLoggerResponse, 0};
-    write(cltSocket, &outHeader, sizeof(DBGMsg_Header));
+    sendMsg(DBGMsgType_SetLoggerResponse, NULL, 0);
     return 1;
   }
+  case DBGMsgType_EMCProfileRequest: {
+    const DBGMSG_EMCProfileRequest *req =
+        (const DBGMSG_EMCProfileRequest *)buffer;
+    printf("received EMCProfileRequest %i\n", req->action);
+    switch ((DBGEMCProfileAction)req->action) {
+    case DBGEMCProfileAction_Report:
+      EMCProfilerReport(&_remoteLogger);
+      break;
+    case DBGEMCProfileAction_Enable:
+      EMCProfilerSetEnabled(1);
+      break;
+    case DBGEMCProfileAction_Disable:
+      EMCProfilerSetEnabled(0);
+      break;
+    case DBGEMCProfileAction_Reset:
+      EMCProfilerReset();
+      break;
+    }
+    DBGMSG_EMCProfileResponse resp = {.enabled = EMCProfilerIsEnabled()};
+    sendMsg(DBGMsgType_EMCProfileResponse, &resp,
+            sizeof(DBGMSG_EMCProfileResponse));
+    return 1;
+  }
+  case DBGMsgType_EMCProfileResponse:
   case DBGMsgType_NoClipResponse:
   case DBGMsgType_SetStateResponse:
   case DBGMsgType_GiveItemResponse:
   case DBGMsgType_StatusResponse:
   case DBGMsgType_SetLoggerResponse:
+  case DBGMsgType_LogMessage:
   case DBGMsgType_Hello:
   default:
     assert(0);
@@ -164,19 +347,20 @@ int DBGServerUpdate(GameContext *gameCtx) {
     }
     printf("new client\n");
     fcntl(cltSocket, F_SETFL, O_NONBLOCK);
-    DBGMsg_Header header = {0};
-    header.type = DBGMsgType_Hello;
-    header.dataSize = 0;
-
-    write(cltSocket, &header, sizeof(DBGMsg_Header));
+    // lines queued for the previous client
+    pthread_mutex_lock(&_stream.lock);
+    _stream.tail = _stream.head;
+    pthread_mutex_unlock(&_stream.lock);
+    FlightRecorderSetStreamSink(&_streamLogger);
+    sendMsg(DBGMsgType_Hello, NULL, 0);
   } else {
+    sendStreamLines();
 
     DBGMsg_Header header = {0};
     ssize_t ret = read(cltSocket, &header, sizeof(DBGMsg_Header));
     if (ret == 0) {
       printf("Client connection closed\n");
-      close(cltSocket);
-      cltSocket = -1;
+      closeClient();
     } else if (ret == -1) {
       if (errno == EAGAIN) {
         return 0;
@@ -4,6 +4,7 @@
 #include "game_ctx.h"
 #include "game_envir.h"
 #include "renderer.h"
+#include <SDL_image.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -45,10 +46,46 @@ static int initSDL(Display *display) {
   return 1;
 }
 
-int DisplayInit(Display *display) {
+static int initHeadless(Display *display) {
+  // no video subsystem: everything is drawn by the software renderer
+  if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER) < 0) {
+    printf("SDL could not be initialized!\n"
+           "SDL_Error: %s\n",
+           SDL_GetError());
+    return 0;
+  }
+  display->frameSurface = SDL_CreateRGBSurfaceWithFormat(
+      0, PIX_BUF_WIDTH, PIX_BUF_HEIGHT, 32, SDL_PIXELFORMAT_XRGB8888);
+  if (!display->frameSurface) {
+    printf("Surface could not be created!\n"
+           "SDL_Error: %s\n",
+           SDL_GetError());
+    return 0;
+  }
+  display->renderer = SDL_CreateSoftwareRenderer(display->frameSurface);
+  if (!display->renderer) {
+    printf("Renderer could not be created!\n"
+           "SDL_Error: %s\n",
+           SDL_GetError());
+    return 0;
+  }
+  display->pixBuf = SDL_CreateTexture(
+      display->renderer, SDL_PIXELFORMAT_XRGB8888, SDL_TEXTUREACCESS_STREAMING,
+      PIX_BUF_WIDTH, PIX_BUF_HEIGHT);
+  if (display->pixBuf == NULL) {
+    printf("Error: %s\n", SDL_GetError());
+    return 0;
+  }
+  return 1;
+}
+
+int DisplayInit(Display *display, DisplayBackend backend) {
   memset(display, 0, sizeof(Display));
+  display->backend = backend;
 
-  if (!initSDL(display)) {
+  int ret = backend == DisplayBackend_Headless ? initHeadless(display)
+                                                : initSDL(display);
+  if (!ret) {
     return 0;
   }
 
@@ -137,9 +174,14 @@ int DisplayInit(Display *display) {
 }
 
 void DisplayRelease(Display *display) {
-  SDL_DestroyRenderer(display->renderer);
-  SDL_DestroyWindow(display->window);
   SDL_DestroyTexture(display->pixBuf);
+  SDL_DestroyRenderer(display->renderer);
+  if (display->window) {
+    SDL_DestroyWindow(display->window);
+  }
+  if (display->frameSurface) {
+    SDL_FreeSurface(display->frameSurface);
+  }
   CPSImageRelease(&display->playField);
   CPSImageRelease(&display->gameTitle);
   CPSImageRelease(&display->mapBackground);
@@ -190,14 +232,46 @@ static void dimRect(SDL_Texture *texture, int startX, int startY, int w,
   SDL_UnlockTexture(texture);
 }
 
+static void saveHeadlessFrame(Display *display) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/frame_%05u.png", display->frameDumpDir,
+           display->frameCount);
+  if (IMG_SavePNG(display->frameSurface, path) != 0) {
+    printf("unable to save frame '%s': %s\n", path, SDL_GetError());
+  }
+}
+
 void DisplayUpdate(Display *display) {
-  SDL_Rect dest = {0, 0, PIX_BUF_WIDTH * SCREEN_FACTOR,
-                   PIX_BUF_HEIGHT * SCREEN_FACTOR};
-  assert(SDL_RenderCopy(display->renderer, display->pixBuf, NULL, &dest) == 0);
-  SDL_RenderPresent(display->renderer);
+  if (display->backend == DisplayBackend_Headless) {
+    assert(SDL_RenderCopy(display->renderer, display->pixBuf, NULL, NULL) ==
+           0);
+    if (display->frameDumpDir) {
+      saveHeadlessFrame(display);
+    }
+  } else {
+    SDL_Rect dest = {0, 0, PIX_BUF_WIDTH * SCREEN_FACTOR,
+                     PIX_BUF_HEIGHT * SCREEN_FACTOR};
+    assert(SDL_RenderCopy(display->renderer, display->pixBuf, NULL, &dest) ==
+           0);
+    SDL_RenderPresent(display->renderer);
+  }
+  display->frameCount++;
+  if (display->presentCallback) {
+    display->presentCallback(display->presentCallbackCtx);
+  }
 }
 
+int DisplayFrameLimitReached(const Display *display) {
+  return display->backend == DisplayBackend_Headless && display->maxFrames &&
+         display->frameCount >= display->maxFrames;
+}
+
+// Headless runs are unattended: nothing to wait for, and reaching the frame
+// limit acts like a quit event.
 int DisplayWaitMouseEvent(Display *display, SDL_Event *event, int tickLength) {
+  if (display->backend == DisplayBackend_Headless) {
+    return DisplayFrameLimitReached(display) ? 0 : -1;
+  }
   uint64_t time = SDL_GetTicks64();
   while (1) {
     SDL_WaitEventTimeout(event, tickLength);
@@ -215,6 +289,9 @@ int DisplayWaitMouseEvent(Display *display, SDL_Event *event, int tickLength) {
 }
 
 int DisplayActiveDelay(Display *display, int tickLength) {
+  if (display->backend == DisplayBackend_Headless) {
+    return !DisplayFrameLimitReached(display);
+  }
   uint64_t time = SDL_GetTicks64();
   while (1) {
     SDL_Event event = {0};
@@ -461,11 +538,7 @@ void DisplayExpandDialogBox(Display *display, int tickLength) {
     if (DisplayActiveDelay(display, tickLength / 10) == 0) {
       return;
     }
-    SDL_Rect dest = {0, 0, PIX_BUF_WIDTH * SCREEN_FACTOR,
-                     PIX_BUF_HEIGHT * SCREEN_FACTOR};
-    assert(SDL_RenderCopy(display->renderer, display->pixBuf, NULL, &dest) ==
-           0);
-    SDL_RenderPresent(display->renderer);
+    DisplayUpdate(display);
   } while (!ret);
 
   display->showBigDialog = 1;
@@ -506,11 +579,7 @@ void DisplayShrinkDialogBox(Display *display, int tickLength) {
     if (DisplayActiveDelay(display, tickLength / 10) == 0) {
       return;
     }
-    SDL_Rect dest = {0, 0, PIX_BUF_WIDTH * SCREEN_FACTOR,
-                     PIX_BUF_HEIGHT * SCREEN_FACTOR};
-    assert(SDL_RenderCopy(display->renderer, display->pixBuf, NULL, &dest) ==
-           0);
-    SDL_RenderPresent(display->renderer);
+    DisplayUpdate(display);
   } while (!ret);
 
   display->showBigDialog = 0;
@@ -518,6 +587,9 @@ void DisplayShrinkDialogBox(Display *display, int tickLength) {
 
 int DisplayWaitForClickOrKey(Display *display, int tickLength) {
   DisplayUpdate(display);
+  if (display->backend == DisplayBackend_Headless) {
+    return 1;
+  }
   while (1) {
     SDL_Event event = {0};
     SDL_WaitEventTimeout(&event, tickLength);
@@ -530,6 +602,9 @@ int DisplayWaitForClickOrKey(Display *display, int tickLength) {
 }
 
 void DisplayCreateCursorForItem(Display *display, uint16_t frameId) {
+  if (display->backend == DisplayBackend_Headless) {
+    return; // no mouse cursor without a window
+  }
   SDL_Cursor *prevCursor = display->cursor;
 
   const int w = 20 * SCREEN_FACTOR;
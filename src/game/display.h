@@ -19,9 +19,27 @@ typedef struct {
   uint8_t isRightClick;
 } MouseEvent;
 
+typedef enum {
+  DisplayBackend_Window,
+  DisplayBackend_Headless, // software renderer drawing into memory, no window
+} DisplayBackend;
+
 typedef struct {
   MouseEvent mouseEv;
   int controlDisabled;
+  int showProfilerOverlay; // debug only, toggled with F1
+
+  DisplayBackend backend;
+  uint32_t frameCount;
+  // called after each presented frame, every loop of the game presents once
+  // per tick
+  void (*presentCallback)(void *ctx);
+  void *presentCallbackCtx;
+
+  // headless only
+  SDL_Surface *frameSurface; // receives every presented frame
+  uint32_t maxFrames;        // 0 means no limit
+  const char *frameDumpDir;  // if set, each frame is saved there as PNG
 
   SDL_Texture *pixBuf;
   SDL_Renderer *renderer;
@@ -56,10 +74,12 @@ typedef struct {
   char *buttonText[3];
 } Display;
 
-int DisplayInit(Display *display);
+int DisplayInit(Display *display, DisplayBackend backend);
 void DisplayRelease(Display *display);
 
 void DisplayUpdate(Display *display);
+// only for the headless backend, always 0 otherwise.
+int DisplayFrameLimitReached(const Display *display);
 
 void DisplayRenderCPS(Display *display, const CPSImage *image, int w, int h);
 void DisplayRenderCPSPart(Display *display, const CPSImage *image, int destX,
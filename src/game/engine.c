@@ -14,7 +14,9 @@ int GameEngineInit(GameEngine *engine) {
   return 1;
 }
 
-void GameEngineRelease(GameEngine *engine) {}
+void GameEngineRelease(GameEngine *engine) {
+  INFScriptRelease(&engine->itemScript);
+}
 
 uint16_t GameEngineGetGameFlag(const GameEngine *engine, uint16_t flag) {
   assert((flag >> 3) >= 0 && (flag >> 3) < sizeof(engine->gameFlags));
@@ -4,6 +4,7 @@
 #include "SDL_keycode.h"
 #include "dbg_server.h"
 #include "display.h"
+#include "flight_recorder.h"
 #include "formats/format_lang.h"
 #include "formats/format_sav.h"
 #include "formats/format_shp.h"
@@ -19,12 +20,18 @@
 #include "logger.h"
 #include "menu.h"
 #include "monster.h"
+#include "profiler.h"
 #include "prologue.h"
 #include "script.h"
 #include "script_builtins.h"
+#include "script_native.h"
+#include "script_profiler.h"
+#include "script_replay.h"
+#include "tracer.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <assert.h>
+#include <getopt.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -37,7 +44,26 @@
 static int GameRun(GameContext *gameCtx);
 
 static void usageGame(void) {
-  printf("game [-d datadir] [-l langId] [-a] [savefile-or-savedir]\n");
+  printf("game [-d datadir] [-l langId] [-a] [-H [-n frames] [-o framesdir]] "
+         "[--trace out.json] [--no-native] [--no-replay] [--emc-profile] "
+         "[--null-audio] [--audio-out out.wav] [savefile-or-savedir]\n");
+  printf("\t-H: headless, render offscreen without a window. Without a save "
+         "file, a new game starts after the prologue, which picks the first "
+         "character by itself\n");
+  printf("\t-n: headless only, stop after this number of frames\n");
+  printf("\t-o: headless only, save every frame as PNG in this directory\n");
+  printf("\t--trace: write a chrome trace event file (chrome://tracing or "
+         "ui.perfetto.dev)\n");
+  printf("\t--no-native: interpret the scripts even if they were compiled "
+         "in\n");
+  printf("\t--no-replay: always interpret the level init scripts instead of "
+         "replaying their first run\n");
+  printf("\t--emc-profile: count script instructions and builtin calls, "
+         "report on exit\n");
+  printf("\t--null-audio: mix the audio without a sound card, one tick per "
+         "presented frame, report the mixing cost on exit\n");
+  printf("\t--audio-out: same as --null-audio, and write the audio to this "
+         "WAV file\n");
 }
 
 static int pathIsFile(const char *path) {
@@ -56,14 +82,58 @@ int cmdGame(int argc, char *argv[]) {
   optind = 0;
   char c;
   int doLogs = 0;
-  while ((c = getopt(argc, argv, "ahd:l:")) != -1) {
+  DisplayBackend backend = DisplayBackend_Window;
+  uint32_t maxFrames = 0;
+  const char *frameDumpDir = NULL;
+  const char *traceFile = NULL;
+  AudioBackend audioBackend = AudioBackend_Device;
+  const char *audioOutFile = NULL;
+  static const struct option longOptions[] = {
+      {"trace", required_argument, NULL, 't'},
+      {"no-native", no_argument, NULL, 'N'},
+      {"no-replay", no_argument, NULL, 'R'},
+      {"emc-profile", no_argument, NULL, 'P'},
+      {"null-audio", no_argument, NULL, 'U'},
+      {"audio-out", required_argument, NULL, 'W'},
+      {NULL, 0, NULL, 0},
+  };
+  while ((c = getopt_long(argc, argv, "aHhd:l:n:o:", longOptions, NULL)) !=
+         -1) {
     switch (c) {
+    case 't':
+      traceFile = optarg;
+      break;
+    case 'N':
+      EMCNativeSetEnabled(0);
+      break;
+    case 'R':
+      EMCReplaySetEnabled(0);
+      break;
+    case 'P':
+      EMCProfilerSetEnabled(1);
+      break;
+    case 'U':
+      audioBackend = AudioBackend_Null;
+      break;
+    case 'W':
+      audioBackend = AudioBackend_Null;
+      audioOutFile = optarg;
+      break;
     case 'h':
       usageGame();
       return 0;
     case 'a':
       doLogs = 1;
       break;
+    case 'H':
+      backend = DisplayBackend_Headless;
+      break;
+    case 'n':
+      maxFrames = atoi(optarg);
+      break;
+    case 'o':
+      frameDumpDir = optarg;
+      break;
     case 'd':
       dataDir = optarg;
       break;
@@ -73,7 +143,7 @@ int cmdGame(int argc, char *argv[]) {
     }
   }
   if (doLogs) {
-    LoggerSetOutput(LoggerStdOut);
+    LoggerSetOutput(LoggerAsyncStdOut);
   }
 
   printf("using lang %s\n", LanguageGetExtension(lang));
@@ -88,7 +158,13 @@ int cmdGame(int argc, char *argv[]) {
 
   assert(GameEnvironmentInit(dataDir ? dataDir : "data", lang));
 
-  if (!GameContextInit(&gameCtx, lang)) {
+  if (!GameContextInit(&gameCtx, lang, backend, audioBackend, audioOutFile)) {
+    return 1;
+  }
+  gameCtx.display->maxFrames = maxFrames;
+  gameCtx.display->frameDumpDir = frameDumpDir;
+  FlightRecorderInit(gameCtx.conf.frameBudgetMs);
+  if (traceFile && !TracerStart(traceFile)) {
     return 1;
   }
 
@@ -104,15 +180,24 @@ int cmdGame(int argc, char *argv[]) {
     printf("Loading sav file '%s'\n", savFileOrDir);
     if (GameContextLoadSaveFile(&gameCtx, savFileOrDir) == 0) {
       printf("Error while reading file '%s'\n", savFileOrDir);
+      TracerStop();
       return 1;
     }
     GameContextSetState(&gameCtx, GameState_PlayGame);
+  } else if (backend == DisplayBackend_Headless) {
+    // nobody to click in the menu
+    GameContextSetState(&gameCtx, GameState_Prologue);
   }
   GameContextSetSavDir(&gameCtx, savFileOrDir);
 
   GameContextUpdateCursor(&gameCtx);
 
   GameRun(&gameCtx);
+  TracerStop();
+  FlightRecorderStop();
+  if (EMCProfilerIsEnabled()) {
+    EMCProfilerReport(LoggerStdOut);
+  }
   LevelContextRelease(&levelCtx);
 
   GameConfigWriteFile(&gameCtx.conf, "conf.txt");
@@ -120,10 +205,12 @@ int cmdGame(int argc, char *argv[]) {
 
   printf("GameEnvironmentRelease\n");
   GameEnvironmentRelease();
+  LoggerAsyncStop();
   return 0;
 }
 
 void LevelContextRelease(LevelContext *levelCtx) {
+  WallBlitPlanRelease(&levelCtx->wallPlan);
   VMPHandleRelease(&levelCtx->vmpHandle);
   VCNHandleRelease(&levelCtx->vcnHandle);
   SHPHandleRelease(&levelCtx->shpHandle);
@@ -616,6 +703,12 @@ static void processGameInputs(GameContext *gameCtx, const SDL_Event *e) {
     return;
   }
 
+  if (gameCtx->conf.debug && e->key.keysym.sym == SDLK_F1) {
+    gameCtx->display->showProfilerOverlay =
+        !gameCtx->display->showProfilerOverlay;
+    return;
+  }
+
   if (gameCtx->state == GameState_GameMenu ||
       gameCtx->state == GameState_MainMenu) {
     MenuKeyDown(gameCtx->currentMenu, gameCtx, e);
@@ -704,12 +797,14 @@ static void processGameInputs(GameContext *gameCtx, const SDL_Event *e) {
 }
 
 static void GamePreUpdate(GameContext *gameCtx) {
-  while (gameCtx->state == GameState_PlayGame &&
-         EMCInterpreterIsValid(&gameCtx->interp, &gameCtx->interpState)) {
-    EMCInterpreterRun(&gameCtx->interp, &gameCtx->interpState);
-    if (gameCtx->dialogState == DialogState_InProgress) {
-      return;
-    }
+  PROFILER_SCOPE(ProfilerPhase_Scripts);
+  if (gameCtx->state != GameState_PlayGame) {
+    return;
+  }
+  EMCSchedulerRunFrame(&gameCtx->scheduler, &gameCtx->interp);
+  if (gameCtx->dialogState == DialogState_InProgress ||
+      EMCSchedulerHasTasks(&gameCtx->scheduler, EMCTaskKind_Block)) {
+    return;
   }
   if (gameCtx->nextFunc) {
     printf("Exec next func %X\n", gameCtx->nextFunc);
@@ -719,8 +814,12 @@ static void GamePreUpdate(GameContext *gameCtx) {
 }
 
 static void getInputs(GameContext *gameCtx) {
-  SDL_Event e;
-  SDL_WaitEventTimeout(&e, gameCtx->conf.tickLength);
+  SDL_Event e = {0};
+  if (gameCtx->display->backend == DisplayBackend_Headless) {
+    SDL_PollEvent(&e);
+  } else {
+    SDL_WaitEventTimeout(&e, gameCtx->conf.tickLength);
+  }
   if (e.type == SDL_QUIT) {
     gameCtx->_shouldRun = 0;
     return;
@@ -756,8 +855,11 @@ static void getInputs(GameContext *gameCtx) {
   }
 }
 
-static void GameRunOnce(GameContext *gameCtx) {
-  DBGServerUpdate(gameCtx);
+static void runFrame(GameContext *gameCtx) {
+  {
+    PROFILER_SCOPE(ProfilerPhase_DebugServer);
+    DBGServerUpdate(gameCtx);
+  }
 
   if (gameCtx->state == GameState_Prologue) {
     int selectedChar = PrologueShow(gameCtx);
@@ -768,17 +870,55 @@ static void GameRunOnce(GameContext *gameCtx) {
     GameContextNewGame(gameCtx, selectedChar);
   }
 
-  getInputs(gameCtx);
+  {
+    PROFILER_SCOPE(ProfilerPhase_Inputs);
+    getInputs(gameCtx);
+  }
+
+  GamePreUpdate(gameCtx);
 
-  GameRender(gameCtx);
+  {
+    PROFILER_SCOPE(ProfilerPhase_Render);
+    GameRender(gameCtx);
+  }
+  if (gameCtx->conf.debug && gameCtx->display->showProfilerOverlay) {
+    GameRenderProfilerOverlay(gameCtx);
+  }
 
-  DisplayUpdate(gameCtx->display);
+  {
+    PROFILER_SCOPE(ProfilerPhase_Present);
+    DisplayUpdate(gameCtx->display);
+  }
+}
+
+static void GameRunOnce(GameContext *gameCtx) {
+  uint64_t start = ProfilerEnter(ProfilerPhase_Frame);
+  runFrame(gameCtx);
+  ProfilerLeave(ProfilerPhase_Frame, start);
+  ProfilerFrameEnd();
+  FlightRecorderFrameEnd();
+  if (TracerIsEnabled()) {
+    TracerComplete("frame", "frame", start, "frame",
+                   gameCtx->display->frameCount);
+  }
 }
 
 static int GameRun(GameContext *gameCtx) {
   gameCtx->_shouldRun = 1;
+  uint64_t start = SDL_GetTicks64();
   while (gameCtx->_shouldRun) {
     GameRunOnce(gameCtx);
+    if (DisplayFrameLimitReached(gameCtx->display)) {
+      gameCtx->_shouldRun = 0;
+    }
+  }
+  if (gameCtx->display->backend == DisplayBackend_Headless) {
+    uint64_t elapsed = SDL_GetTicks64() - start;
+    printf("headless: %u frames in %llu ms (%.3f ms/frame)\n",
+           gameCtx->display->frameCount, (unsigned long long)elapsed,
+           gameCtx->display->frameCount
+               ? (double)elapsed / gameCtx->display->frameCount
+               : 0.);
   }
   SDL_Quit();
   return 0;
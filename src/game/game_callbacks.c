@@ -22,7 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define LOG_PREFIX "CALLBCK"
+#define LOG_CATEGORY LogCategory_Callbacks
 
 static uint16_t rollDices(EMCInterpreter *interp, int16_t times,
                           int16_t maxVal) {
@@ -35,7 +35,7 @@ static uint16_t rollDices(EMCInterpreter *interp, int16_t times,
 
 static uint16_t getDirection(EMCInterpreter *interp) {
   GameContext *ctx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackGetDirection");
+  Log(LOG_CATEGORY, "callbackGetDirection");
   assert(ctx);
   return ctx->orientation;
 }
@@ -43,7 +43,7 @@ static uint16_t getDirection(EMCInterpreter *interp) {
 static int characterSays(EMCInterpreter *interp, int16_t trackId,
                          uint16_t charId, int redraw) {
   GameContext *ctx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "characterSays trackId=0X%X charId=0X%X redraw=0X%X\n",
+  Log(LOG_CATEGORY, "characterSays trackId=0X%X charId=0X%X redraw=0X%X\n",
       trackId, charId, redraw);
   if (trackId == -1) {
     AudioSystemStopSpeech(&ctx->audio);
@@ -60,7 +60,7 @@ static void playDialogue(EMCInterpreter *interp, int16_t charId, int16_t mode,
                          uint16_t strId) {
   GameContext *ctx = (GameContext *)interp->callbackCtx;
   assert(ctx);
-  Log(LOG_PREFIX, "callbackPlayDialogue %x %x %x", charId, mode, strId);
+  Log(LOG_CATEGORY, "callbackPlayDialogue %x %x %x", charId, mode, strId);
   if (charId == 1) {
     charId = ctx->selectedChar;
   }
@@ -72,7 +72,7 @@ static void printMessage(EMCInterpreter *interp, uint16_t type, uint16_t strId,
                          uint16_t soundId) {
   GameContext *ctx = (GameContext *)interp->callbackCtx;
   assert(ctx);
-  Log(LOG_PREFIX, "callbackPrintMessage %x %x %x", type, strId, soundId);
+  Log(LOG_CATEGORY, "callbackPrintMessage %x %x %x", type, strId, soundId);
   GameContextSetDialogF(ctx, strId);
   GameContextPlayDialogSpeech(ctx, 1, soundId);
 }
@@ -81,15 +81,16 @@ static uint16_t getGlobalVar(EMCInterpreter *interp, EMCGlobalVarID id,
                              uint16_t a) {
   GameContext *ctx = (GameContext *)interp->callbackCtx;
   assert(ctx);
-  Log(LOG_PREFIX, "callbackGetGlobalVar %x %x", id, a);
+  Log(LOG_CATEGORY, "callbackGetGlobalVar %x %x", id, a);
   switch (id) {
   case EMCGlobalVarID_CurrentBlock:
     return ctx->currentBock;
   case EMCGlobalVarID_CurrentDir:
     return ctx->orientation;
+  case EMCGlobalVarID_Brightness:
+    return ctx->brightness;
   case EMCGlobalVarID_CurrentLevel:
   case EMCGlobalVarID_ItemInHand:
-  case EMCGlobalVarID_Brightness:
   case EMCGlobalVarID_Credits:
     return ctx->credits;
   case EMCGlobalVarID_6:
@@ -110,7 +111,7 @@ static uint16_t getGlobalVar(EMCInterpreter *interp, EMCGlobalVarID id,
 static uint16_t setGlobalVar(EMCInterpreter *interp, EMCGlobalVarID id,
                              uint16_t a, uint16_t b) {
   GameContext *ctx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackSetGlobalVar %x %x %x", id, a, b);
+  Log(LOG_CATEGORY, "callbackSetGlobalVar %x %x %x", id, a, b);
   switch (id) {
   case EMCGlobalVarID_CurrentBlock: {
     ctx->currentBock = b;
@@ -119,9 +120,11 @@ static uint16_t setGlobalVar(EMCInterpreter *interp, EMCGlobalVarID id,
   case EMCGlobalVarID_CurrentDir:
     ctx->orientation = b;
     break;
+  case EMCGlobalVarID_Brightness:
+    ctx->brightness = b > MAX_BRIGHTNESS ? MAX_BRIGHTNESS : b;
+    break;
   case EMCGlobalVarID_CurrentLevel:
   case EMCGlobalVarID_ItemInHand:
-  case EMCGlobalVarID_Brightness:
   case EMCGlobalVarID_Credits:
   case EMCGlobalVarID_6:
   case EMCGlobalVarID_7_Unused:
@@ -142,7 +145,7 @@ static uint16_t setGlobalVar(EMCInterpreter *interp, EMCGlobalVarID id,
 static void loadLangFile(EMCInterpreter *interp, const char *file) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
   GameFile langFile = {0};
-  Log(LOG_PREFIX, "callbackLoadLangFile %s", file);
+  Log(LOG_CATEGORY, "callbackLoadLangFile %s", file);
   assert(GameEnvironmentGetLangFile(&langFile, file));
   if (!langFile.buffer) {
     return;
@@ -156,7 +159,7 @@ static void loadLangFile(EMCInterpreter *interp, const char *file) {
 
 static void loadCMZ(EMCInterpreter *interp, const char *file) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackLoadCMZ %s", file);
+  Log(LOG_CATEGORY, "callbackLoadCMZ %s", file);
   memset(gameCtx->level->blockProperties, 0, sizeof(BlockProperty) * 1024);
   MazeHandle mazHandle = {0};
   GameFile f = {0};
@@ -184,7 +187,7 @@ static void loadCMZ(EMCInterpreter *interp, const char *file) {
 static void setWallType(EMCInterpreter *interp, uint16_t block, uint16_t wall,
                         uint16_t val) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackSetWallType %x %x %x", block, wall, val);
+  Log(LOG_CATEGORY, "callbackSetWallType %x %x %x", block, wall, val);
   if (wall == 0XFFFF) {
     for (int i = 0; i < 4; i++) {
       gameCtx->level->blockProperties[block].walls[i] = val;
@@ -197,7 +200,7 @@ static void setWallType(EMCInterpreter *interp, uint16_t block, uint16_t wall,
 static uint16_t getWallType(EMCInterpreter *interp, uint16_t blockId,
                             uint16_t wall) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackGetWallType %x %x", blockId, wall);
+  Log(LOG_CATEGORY, "callbackGetWallType %x %x", blockId, wall);
 
   return gameCtx->level->blockProperties[blockId].walls[wall];
 }
@@ -205,7 +208,7 @@ static uint16_t getWallType(EMCInterpreter *interp, uint16_t blockId,
 static void levelShapes(EMCInterpreter *interp, const char *shpFile,
                         const char *datFile) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackLoadLevelShapes %s %s", shpFile, datFile);
+  Log(LOG_CATEGORY, "callbackLoadLevelShapes %s %s", shpFile, datFile);
 
   GameContextLoadLevelShapes(gameCtx, shpFile, datFile);
 }
@@ -213,7 +216,7 @@ static void levelShapes(EMCInterpreter *interp, const char *shpFile,
 static void loadLevel(EMCInterpreter *interp, uint16_t levelNum,
                       uint16_t startBlock, uint16_t startDir) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackLoadLevel %x %x %x", levelNum, startBlock, startDir);
+  Log(LOG_CATEGORY, "callbackLoadLevel %x %x %x", levelNum, startBlock, startDir);
   gameCtx->currentBock = startBlock;
   gameCtx->orientation = startDir;
   gameCtx->levelId = levelNum;
@@ -222,7 +225,7 @@ static void loadLevel(EMCInterpreter *interp, uint16_t levelNum,
 
 static void setGameFlag(EMCInterpreter *interp, uint16_t flag, uint16_t set) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackSetGameFlag %x %x", flag, set);
+  Log(LOG_CATEGORY, "callbackSetGameFlag %x %x", flag, set);
   if (set) {
     GameEngineSetGameFlag(gameCtx->engine, flag);
   } else {
@@ -232,14 +235,14 @@ static void setGameFlag(EMCInterpreter *interp, uint16_t flag, uint16_t set) {
 
 static uint16_t testGameFlag(EMCInterpreter *interp, uint16_t flag) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackTestGameFlag %x", flag);
+  Log(LOG_CATEGORY, "callbackTestGameFlag %x", flag);
   return GameEngineGetGameFlag(gameCtx->engine, flag);
 }
 
 static void levelGraphics(EMCInterpreter *interp, const char *file,
                           const char *paletteFile) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackLoadLevelGraphics %s %s", file, paletteFile);
+  Log(LOG_CATEGORY, "callbackLoadLevelGraphics %s %s", file, paletteFile);
   char pakFile[12] = "";
   snprintf(pakFile, 12, "%s.PAK", file);
   char fileName[12] = "";
@@ -250,6 +253,8 @@ static void levelGraphics(EMCInterpreter *interp, const char *file,
       assert(GameEnvironmentGetFile(&f, fileName));
     }
     // assert(GameEnvironmentGetFileWithExt(&f, file, "VCN"));
+    // the previous level's blocks and atlas
+    VCNHandleRelease(&gameCtx->level->vcnHandle);
     assert(VCNHandleFromLCWBuffer(&gameCtx->level->vcnHandle, f.buffer,
                                   f.bufferSize));
 
@@ -262,9 +267,13 @@ static void levelGraphics(EMCInterpreter *interp, const char *file,
       assert(GameEnvironmentGetFile(&f, fileName));
     }
     // assert(GameEnvironmentGetFileWithExt(&f, file, "VMP"));
+    VMPHandleRelease(&gameCtx->level->vmpHandle);
     assert(VMPHandleFromLCWBuffer(&gameCtx->level->vmpHandle, f.buffer,
                                   f.bufferSize));
   }
+  assert(WallBlitPlanBuild(&gameCtx->level->wallPlan,
+                           &gameCtx->level->vcnHandle,
+                           &gameCtx->level->vmpHandle));
   if (paletteFile) {
     GameFile f = {0};
     assert(GameEnvironmentGetFile(&f, paletteFile));
@@ -283,7 +292,7 @@ static void redrawPlayfield(EMCInterpreter *interp) {
 static void loadBitmap(EMCInterpreter *interp, const char *file,
                        uint16_t param) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackLoadBitmap %s %x", file, param);
+  Log(LOG_CATEGORY, "callbackLoadBitmap %s %x", file, param);
   assert(param == 2);
   GameFile f = {0};
   assert(GameEnvironmentGetFile(&f, file));
@@ -295,7 +304,7 @@ static void loadBitmap(EMCInterpreter *interp, const char *file,
 static void loadDoorShapes(EMCInterpreter *interp, const char *file,
                            uint16_t p1, uint16_t p2, uint16_t p3, uint16_t p4) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackLoadDoorShapes %s %x %x %x %x", file, p1, p2, p3,
+  Log(LOG_CATEGORY, "callbackLoadDoorShapes %s %x %x %x %x", file, p1, p2, p3,
       p4);
   if (p1 != 0 || p2 != 0 || p3 != 0 || p4 != 0) {
     printf("FIXME: not supported yet\n");
@@ -309,7 +318,7 @@ static void loadDoorShapes(EMCInterpreter *interp, const char *file,
 static void loadMonsterShapes(EMCInterpreter *interp, const char *file,
                               uint16_t monsterId, uint16_t p2) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackLoadMonsterShapes %s %x %x", file, monsterId, p2);
+  Log(LOG_CATEGORY, "callbackLoadMonsterShapes %s %x %x", file, monsterId, p2);
   assert(monsterId < MAX_MONSTERS);
   assert(p2 == 0);
   GameFile f;
@@ -360,7 +369,7 @@ static void moveMonster(EMCInterpreter *interp, uint16_t monsterId,
 }
 
 static void clearDialogField(EMCInterpreter *interp) {
-  Log(LOG_PREFIX, "callbackClearDialogField");
+  Log(LOG_CATEGORY, "callbackClearDialogField");
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
   DisplayResetDialog(gameCtx->display);
 }
@@ -368,7 +377,7 @@ static void clearDialogField(EMCInterpreter *interp) {
 static uint16_t checkMonsterHostility(EMCInterpreter *interp,
                                       uint16_t monsterType) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, " UNIMPLEMENTED callbackCheckMonsterHostility %x",
+  Log(LOG_CATEGORY, " UNIMPLEMENTED callbackCheckMonsterHostility %x",
       monsterType);
   return 0;
   for (int i = 0; i < MAX_MONSTERS; i++) {
@@ -386,7 +395,7 @@ static void loadMonster(EMCInterpreter *interp, uint16_t monsterId,
                         uint16_t protection, uint16_t evadeChance,
                         uint16_t speed, uint16_t p6, uint16_t p7, uint16_t p8) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, " INCOMPLETE callbackLoadMonster %i %i\n", monsterId,
+  Log(LOG_CATEGORY, " INCOMPLETE callbackLoadMonster %i %i\n", monsterId,
       shapeId);
   assert(monsterId < MAX_MONSTER_PROPERTIES);
   MonsterProperties *props = &gameCtx->level->monsterProperties[monsterId];
@@ -405,31 +414,33 @@ static void loadMonster(EMCInterpreter *interp, uint16_t monsterId,
 static void loadTimScript(EMCInterpreter *interp, uint16_t scriptId,
                           const char *file) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackLoadTimScript %x %s", scriptId, file);
+  Log(LOG_CATEGORY, "callbackLoadTimScript %x %s", scriptId, file);
   GameTimInterpreterLoadTim(&gameCtx->timInterpreter, scriptId, file);
 }
 
 static void runTimScript(EMCInterpreter *interp, uint16_t scriptId,
                          uint16_t loop) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackRunTimScript %x %i", scriptId, loop);
+  Log(LOG_CATEGORY, "callbackRunTimScript %x %i", scriptId, loop);
   if (!gameCtx->timInterpreter.tim[scriptId].avtl) {
     printf("NO TIM loaded\n");
     return;
   }
   GameContextSetState(gameCtx, GameState_TimAnimation);
   GameTimInterpreterRunTim(&gameCtx->timInterpreter, scriptId);
+  // the scripts resume when the animation is done
+  EMCSchedulerYield(&gameCtx->scheduler);
 }
 
 static void releaseTimScript(EMCInterpreter *interp, uint16_t scriptId) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackReleaseTimScript %i", scriptId);
+  Log(LOG_CATEGORY, "callbackReleaseTimScript %i", scriptId);
   GameTimInterpreterReleaseTim(&gameCtx->timInterpreter, scriptId);
 }
 
 static uint16_t getItemIndexInHand(EMCInterpreter *interp) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackGetItemIndexInHand");
+  Log(LOG_CATEGORY, "callbackGetItemIndexInHand");
   return gameCtx->itemIndexInHand;
 }
 
@@ -437,7 +448,7 @@ static uint16_t getItemParam(EMCInterpreter *interp, uint16_t itemId,
                              EMCGetItemParam how) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
   const GameObject *item = &gameCtx->itemsInGame[itemId];
-  Log(LOG_PREFIX, "callbackGetItemParam itemId=0X%x how=0X%x", itemId, how);
+  Log(LOG_CATEGORY, "callbackGetItemParam itemId=0X%x how=0X%x", itemId, how);
   const ItemProperty *p = &gameCtx->itemProperties[item->itemPropertyIndex];
   switch (how) {
   case EMCGetItemParam_LEVEL:
@@ -483,7 +494,7 @@ static uint16_t getItemParam(EMCInterpreter *interp, uint16_t itemId,
 
 static void allocItemProperties(EMCInterpreter *interp, uint16_t size) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackAllocItemProperties %i", size);
+  Log(LOG_CATEGORY, "callbackAllocItemProperties %i", size);
   gameCtx->itemProperties = malloc(size * sizeof(ItemProperty));
   assert(gameCtx->itemProperties);
   gameCtx->itemsCount = size;
@@ -495,7 +506,7 @@ static void setItemProperty(EMCInterpreter *interp, uint16_t index,
                             uint16_t protection, uint16_t flags) {
 
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackSetItemProperty %x %x %x %x %x %x %x %x %x", index,
+  Log(LOG_CATEGORY, "callbackSetItemProperty %x %x %x %x %x %x %x %x %x", index,
       stringId, shapeId, type, scriptFun, might, skill, protection, flags);
   assert(index < gameCtx->itemsCount);
 
@@ -511,34 +522,34 @@ static void setItemProperty(EMCInterpreter *interp, uint16_t index,
 
 static void disableControls(EMCInterpreter *interp, uint16_t mode) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackDisableControls %x", mode);
+  Log(LOG_CATEGORY, "callbackDisableControls %x", mode);
   assert(mode == 0);
   gameCtx->display->controlDisabled = 1;
 }
 
 static void enableControls(EMCInterpreter *interp) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackEnableControls");
+  Log(LOG_CATEGORY, "callbackEnableControls");
   gameCtx->display->controlDisabled = 0;
 }
 
 static void setGlobalScriptVar(EMCInterpreter *interp, uint16_t index,
                                uint16_t val) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackSetGlobalScriptVar %x %x", index, val);
+  Log(LOG_CATEGORY, "callbackSetGlobalScriptVar %x %x", index, val);
   gameCtx->engine->globalScriptVars[index] = val;
 }
 
 static uint16_t getGlobalScriptVar(EMCInterpreter *interp, uint16_t index) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackGetGlobalScriptVar %x", index);
+  Log(LOG_CATEGORY, "callbackGetGlobalScriptVar %x", index);
   return gameCtx->engine->globalScriptVars[index];
 }
 
 static void WSAInit(EMCInterpreter *interp, uint16_t index, const char *wsaFile,
                     int x, int y, int offscreen, int flags) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackWSAInit %x %s %i %i %i %i", index, wsaFile, x, y,
+  Log(LOG_CATEGORY, "callbackWSAInit %x %s %i %i %i %i", index, wsaFile, x, y,
       offscreen, flags);
   GameFile f = {0};
   printf("----> GameTimAnimator load wsa file '%s' index %i offscreen=%i\n",
@@ -550,13 +561,13 @@ static void WSAInit(EMCInterpreter *interp, uint16_t index, const char *wsaFile,
 
 static void restoreAfterSceneDialog(EMCInterpreter *interp, int mode) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackRestoreAfterSceneDialog %x", mode);
+  Log(LOG_CATEGORY, "callbackRestoreAfterSceneDialog %x", mode);
   GameContextCleanupSceneDialog(gameCtx);
 }
 
 static void restoreAfterSceneWindowDialog(EMCInterpreter *interp, int redraw) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackRestoreAfterSceneWindowDialog %x", redraw);
+  Log(LOG_CATEGORY, "callbackRestoreAfterSceneWindowDialog %x", redraw);
   GameContextCleanupSceneDialog(gameCtx);
 }
 
@@ -573,14 +584,14 @@ static uint16_t checkForCertainPartyMember(EMCInterpreter *interp,
 
 static void setNextFunc(EMCInterpreter *interp, uint16_t func) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackSetNextFunc %x", func);
+  Log(LOG_CATEGORY, "callbackSetNextFunc %x", func);
   assert(gameCtx->nextFunc == 0);
   gameCtx->nextFunc = func;
 }
 
 static uint16_t getWallFlags(EMCInterpreter *interp, uint16_t blockId,
                              uint16_t wall) {
-  Log(LOG_PREFIX, "callbackGetWallFlags %x %x", blockId, wall);
+  Log(LOG_CATEGORY, "callbackGetWallFlags %x %x", blockId, wall);
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
   uint8_t wmi = gameCtx->level->blockProperties[blockId].walls[wall];
   const WllWallMapping *mapping =
@@ -597,9 +608,10 @@ static void fadeScene(EMCInterpreter *interp, uint16_t mode) {
 static void setupDialogueButtons(EMCInterpreter *interp, uint16_t numStrs,
                                  uint16_t strIds[3]) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackSetupDialogueButtons %x %x %x %x", numStrs,
+  Log(LOG_CATEGORY, "callbackSetupDialogueButtons %x %x %x %x", numStrs,
       strIds[0], strIds[1], strIds[2]);
   gameCtx->dialogState = DialogState_InProgress;
+  EMCSchedulerYield(&gameCtx->scheduler);
   GameContextInitSceneDialog(gameCtx);
   printf("callbackSetupDialogueButtons %i %X %X %X\n", numStrs, strIds[0],
          strIds[1], strIds[2]);
@@ -619,7 +631,7 @@ static void setupBackgroundAnimationPart(
     uint16_t partDelay, uint16_t field, uint16_t sfxIndex, uint16_t sfxFrame) {
 
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX,
+  Log(LOG_CATEGORY,
       "callbackSetupBackgroundAnimationPart animIndex=%x part=%x firstFrame=%x "
       "lastFrame=%x cycles=%x nextPart=%x partDelay=%x field=%x sfxIndex=%x "
       "sfxFrame%x\n",
@@ -633,7 +645,7 @@ static void setupBackgroundAnimationPart(
 
 static void deleteHandItem(EMCInterpreter *interp) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackDeleteHandItem");
+  Log(LOG_CATEGORY, "callbackDeleteHandItem");
   GameContextDeleteItem(gameCtx, gameCtx->itemIndexInHand);
   gameCtx->itemIndexInHand = 0;
   GameContextUpdateCursor(gameCtx);
@@ -642,7 +654,7 @@ static void deleteHandItem(EMCInterpreter *interp) {
 static uint16_t createHandItem(EMCInterpreter *interp, uint16_t itemType,
                                uint16_t p1, uint16_t p2) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackCreateHandItem");
+  Log(LOG_CATEGORY, "callbackCreateHandItem");
   if (gameCtx->itemIndexInHand) {
     return 0;
   }
@@ -654,7 +666,7 @@ static uint16_t createHandItem(EMCInterpreter *interp, uint16_t itemType,
 }
 
 static void showHideMouse(EMCInterpreter *interp, int show) {
-  Log(LOG_PREFIX, "callbackShowHidMouse show=%i", show);
+  Log(LOG_CATEGORY, "callbackShowHidMouse show=%i", show);
   if (show) {
     SDL_ShowCursor(show ? SDL_ENABLE : SDL_DISABLE);
   }
@@ -662,7 +674,7 @@ static void showHideMouse(EMCInterpreter *interp, int show) {
 
 static int checkMagic(EMCInterpreter *interp, uint16_t charId,
                       uint16_t spellNum, uint16_t spellLevel) {
-  Log(LOG_PREFIX,
+  Log(LOG_CATEGORY,
       "callbackCheckMagic charId=0X%X spellNum=0X%X spellLevel=0X%X\n ", charId,
       spellNum, spellLevel);
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
@@ -673,7 +685,7 @@ static uint16_t createLevelItem(EMCInterpreter *interp, uint16_t itemType,
                                 uint16_t frame, uint16_t flags, uint16_t level,
                                 uint16_t block, uint16_t xOff, uint16_t yOff,
                                 uint16_t flyingHeight) {
-  Log(LOG_PREFIX,
+  Log(LOG_CATEGORY,
       "[INCOMPLETE] callbackCreateLevelItem itemType=0X%X frame=0X%X "
       "flags=0X%X\n "
       "level=%i block=0X%X xOff=0X%X yOff=0X%X flyingHeight=0X%X\n",
@@ -685,8 +697,13 @@ static uint16_t createLevelItem(EMCInterpreter *interp, uint16_t itemType,
 
 static uint16_t processDialog(EMCInterpreter *interp) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackProcessDialog\n");
-  return gameCtx->dialogState == DialogState_Done;
+  Log(LOG_CATEGORY, "callbackProcessDialog\n");
+  if (gameCtx->dialogState != DialogState_Done) {
+    // polled by the script, wait for the next frame
+    EMCSchedulerYield(&gameCtx->scheduler);
+    return 0;
+  }
+  return 1;
 }
 
 static void playSoundFX(EMCInterpreter *interp, uint16_t soundId) {
@@ -724,7 +741,7 @@ static void printWindowText(EMCInterpreter *interp, uint16_t dim,
 static int initMonster(EMCInterpreter *interp, uint16_t block, uint16_t xOff,
                        uint16_t yOff, uint16_t facing, uint16_t monsterType,
                        uint16_t flags, uint16_t monsterMode) {
-  Log(LOG_PREFIX,
+  Log(LOG_CATEGORY,
       "callbackInitMonster block=0X%X xOff=0X%X yOff=0X%X orientation=0X%X "
       "monsterType=0X%X flags=0X%X monsterMode=0X%X \n",
       block, xOff, yOff, facing, monsterType, flags, monsterMode);
@@ -779,7 +796,7 @@ static uint16_t getMonsterStat(EMCInterpreter *interp, uint16_t monsterId,
 static uint16_t checkRectForMousePointer(EMCInterpreter *interp, uint16_t xMin,
                                          uint16_t yMin, uint16_t xMax,
                                          uint16_t yMax) {
-  Log(LOG_PREFIX, "callbackCheckRectForMousePointer %i %i %i %i\n", xMin, yMin,
+  Log(LOG_CATEGORY, "callbackCheckRectForMousePointer %i %i %i %i\n", xMin, yMin,
       xMax, yMax);
   int x;
   int y;
@@ -793,7 +810,7 @@ static uint16_t checkRectForMousePointer(EMCInterpreter *interp, uint16_t xMin,
 
 static void drawExitButton(EMCInterpreter *interp, uint16_t p0, uint16_t p1) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackDrawExitButton %x %x", p0, p1);
+  Log(LOG_CATEGORY, "callbackDrawExitButton %x %x", p0, p1);
   gameCtx->display->drawExitSceneButton = 1;
   gameCtx->display->exitSceneButtonDisabled = 1;
 }
@@ -802,7 +819,7 @@ static void copyPage(EMCInterpreter *interp, uint16_t srcX, uint16_t srcY,
                      uint16_t destX, uint16_t destY, uint16_t w, uint16_t h,
                      uint16_t srcPage, uint16_t dstPage) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX,
+  Log(LOG_CATEGORY,
       "callbackCopyPage x1=%i y1=%i x2=%i y2=%i w=%i h=%i "
       "scrPage=%i dstPage=%i\n",
       srcX, srcY, destX, destY, w, h, srcPage, dstPage);
@@ -811,7 +828,7 @@ static void copyPage(EMCInterpreter *interp, uint16_t srcX, uint16_t srcY,
 
 static void initSceneDialog(EMCInterpreter *interp, int param) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX, "callbackInitSceneDialog %x", param);
+  Log(LOG_CATEGORY, "callbackInitSceneDialog %x", param);
   GameContextInitSceneDialog(gameCtx);
 }
 
@@ -819,7 +836,7 @@ static void playAnimationPart(EMCInterpreter *interp, uint16_t animIndex,
                               uint16_t firstFrame, uint16_t lastFrame,
                               uint16_t delay) {
   GameContext *gameCtx = (GameContext *)interp->callbackCtx;
-  Log(LOG_PREFIX,
+  Log(LOG_CATEGORY,
       "callbackPlayAnimationPart animIndex=%x firstFrame=%x lastFrame=%x "
       "delay=%x\n",
       animIndex, firstFrame, lastFrame, delay);
@@ -18,8 +18,12 @@
 #include "menu.h"
 #include "pak_file.h"
 #include "prologue.h"
+#include "profiler.h"
 #include "script.h"
+#include "script_builtins.h"
+#include "script_replay.h"
 #include "spells.h"
+#include "tracer.h"
 #include <assert.h>
 #include <dirent.h>
 #include <libgen.h>
@@ -106,17 +110,31 @@ SAVFile *GameContextListSavFiles(GameContext *gameCtx, size_t *numSavFiles) {
 static Display _renderCtx = {0};
 static GameEngine _engine = {0};
 
-int GameContextInit(GameContext *gameCtx, Language lang) {
+// null audio backend: a game tick of audio per presented frame
+static void advanceNullAudio(void *ctx) {
+  GameContext *gameCtx = ctx;
+  AudioSystemAdvance(&gameCtx->audio, gameCtx->conf.tickLength);
+}
+
+int GameContextInit(GameContext *gameCtx, Language lang,
+                    DisplayBackend backend, AudioBackend audioBackend,
+                    const char *audioOutFile) {
   memset(gameCtx, 0, sizeof(GameContext));
   gameCtx->display = &_renderCtx;
-  DisplayInit(gameCtx->display);
+  if (!DisplayInit(gameCtx->display, backend)) {
+    return 0;
+  }
   gameCtx->engine = &_engine;
   GameEngineInit(gameCtx->engine);
   gameCtx->spellProperties = SpellPropertiesGet();
+  gameCtx->brightness = MAX_BRIGHTNESS;
   if (!GameConfigFromFile(&gameCtx->conf, "conf.txt")) {
     printf("Create default config\n");
     GameConfigCreateDefault(&gameCtx->conf);
   }
+  EMCSchedulerInit(&gameCtx->scheduler, gameCtx->conf.scriptBudgetUs
+                                            ? gameCtx->conf.scriptBudgetUs
+                                            : EMC_SCHEDULER_DEFAULT_BUDGET_US);
 
   gameCtx->language = lang;
   GameContextSetState(gameCtx, GameState_MainMenu);
@@ -133,8 +151,22 @@ int GameContextInit(GameContext *gameCtx, Language lang) {
   }
 
   assert(GameEnvironmentLoadPak(&gameCtx->defaultTlkFile, "00.TLK"));
+  TLKIndexBuild(&gameCtx->defaultTlkIndex, &gameCtx->defaultTlkFile);
   assert(GameEnvironmentLoadPak(&gameCtx->sfxPak, "VOC.PAK"));
-  AudioSystemInit(&gameCtx->audio, &gameCtx->conf);
+  if (!AudioSystemInit(&gameCtx->audio, &gameCtx->conf, audioBackend,
+                       audioOutFile)) {
+    if (audioBackend == AudioBackend_Null) {
+      // the run is about the audio output file
+      return 0;
+    }
+    printf("no audio device, the game has no sound\n");
+  }
+  if (audioBackend == AudioBackend_Null) {
+    // the prologue and the dialogs wait for the voices outside of the game
+    // loop, but they all present their frames
+    gameCtx->display->presentCallback = advanceNullAudio;
+    gameCtx->display->presentCallbackCtx = gameCtx;
+  }
 
   AnimatorInit(&gameCtx->animator, gameCtx->display->pixBuf);
   GameTimInterpreterInit(&gameCtx->timInterpreter, &gameCtx->animator);
@@ -175,6 +207,11 @@ void GameContextRelease(GameContext *gameCtx) {
   DisplayRelease(gameCtx->display);
   PAKFileRelease(&gameCtx->sfxPak);
   PAKFileRelease(&gameCtx->defaultTlkFile);
+  TLKIndexRelease(&gameCtx->defaultTlkIndex);
+  TLKIndexRelease(&gameCtx->level->currentTlkIndex);
+  INFScriptRelease(&gameCtx->script);
+  GameEngineRelease(gameCtx->engine);
+  EMCReplayClear();
 }
 
 int GameContextAddItemToInventory(GameContext *ctx, uint16_t itemId) {
@@ -191,22 +228,59 @@ int GameContextAddItemToInventory(GameContext *ctx, uint16_t itemId) {
   return 0;
 }
 
-static int runScript(GameContext *gameCtx, INFScript *script) {
+static void runFunction(GameContext *gameCtx, EMCState *state, int function) {
+  uint64_t start = TracerBegin();
+  while (EMCInterpreterIsValid(&gameCtx->interp, state)) {
+    EMCInterpreterRun(&gameCtx->interp, state);
+  }
+  if (start) {
+    char name[TRACER_NAME_SIZE];
+    snprintf(name, sizeof(name), "emc func %i", function);
+    TracerComplete("emc", name, start, "function", function);
+  }
+}
+
+// runs the functions [0, numFunctions) in the same state, replaying the
+// recorded builtin calls if the script already ran.
+static int runInitFunctions(GameContext *gameCtx, INFScript *script,
+                            int numFunctions) {
   EMCState state = {0};
   EMCStateInit(&state, script);
-  EMCStateStart(&state, 0);
-  while (EMCInterpreterIsValid(&gameCtx->interp, &state)) {
-    EMCInterpreterRun(&gameCtx->interp, &state);
+  int first = 0;
+  switch (EMCReplayRun(&gameCtx->interp, &state)) {
+  case EMCReplayResult_Done:
+    return 1;
+  case EMCReplayResult_Diverged:
+    printf("replay of script 0X%08X diverged in function %i\n", script->hash,
+           state.function);
+    runFunction(gameCtx, &state, state.function);
+    first = state.function + 1;
+    break;
+  case EMCReplayResult_NotCached:
+    EMCReplayStartRecording(script);
+    break;
+  }
+  for (int i = first; i < numFunctions; i++) {
+    EMCStateStart(&state, i);
+    runFunction(gameCtx, &state, i);
   }
+  EMCReplayStopRecording(script);
   return 1;
 }
 
+static int runScript(GameContext *gameCtx, INFScript *script) {
+  PROFILER_SCOPE(ProfilerPhase_Scripts);
+  return runInitFunctions(gameCtx, script, 1);
+}
+
 static int runCompleteScript(GameContext *ctx, const char *name) {
   GameFile f;
   assert(GameEnvironmentGetStartupFile(&f, name));
   INFScript script = {0};
   assert(INFScriptFromBuffer(&script, f.buffer, f.bufferSize));
-  return runScript(ctx, &script);
+  int ret = runScript(ctx, &script);
+  INFScriptRelease(&script);
+  return ret;
 }
 
 int GameContextStartup(GameContext *ctx) {
@@ -246,25 +320,25 @@ void GameContextLoadLevelShapes(GameContext *gameCtx, const char *shpFile,
 }
 
 static int runInitScript(GameContext *gameCtx, INFScript *script) {
-  EMCState state = {0};
-  EMCStateInit(&state, script);
-  for (int i = 0; i < INFScriptGetNumFunctions(script); i++) {
-    EMCStateStart(&state, i);
-    while (EMCInterpreterIsValid(&gameCtx->interp, &state)) {
-      EMCInterpreterRun(&gameCtx->interp, &state);
-    }
-  }
-  return 1;
+  PROFILER_SCOPE(ProfilerPhase_Scripts);
+  return runInitFunctions(gameCtx, script, INFScriptGetNumFunctions(script));
 }
 
+static void prefillSoundFXCache(GameContext *gameCtx);
+
 int GameContextLoadLevel(GameContext *ctx, int levelNum) {
+  uint64_t start = TracerBegin();
   for (int i = 0; i < MAX_MONSTERS; i++) {
     MonsterInit(&ctx->level->monsters[i]);
   }
   DisplayResetDialog(ctx->display);
 
-  GameEnvironmentLoadLevel(levelNum);
   {
+    TRACER_SCOPE("level", "load level pak");
+    GameEnvironmentLoadLevel(levelNum);
+  }
+  {
+    TRACER_SCOPE("level", "load wll");
     GameFile f = {0};
     char wllFile[12];
     snprintf(wllFile, 12, "LEVEL%i.WLL", levelNum);
@@ -272,6 +346,7 @@ int GameContextLoadLevel(GameContext *ctx, int levelNum) {
     assert(WllHandleFromBuffer(&ctx->level->wllHandle, f.buffer, f.bufferSize));
   }
   {
+    TRACER_SCOPE("level", "load tlc");
     GameFile f = {0};
     char tlcFile[12];
     snprintf(tlcFile, 12, "LEVEL%02i.TLC", levelNum);
@@ -280,13 +355,25 @@ int GameContextLoadLevel(GameContext *ctx, int levelNum) {
     assert(TLCHandleFromBuffer(&ctx->level->tlcHandle, f.buffer, f.bufferSize));
   }
   {
+    TRACER_SCOPE("level", "load inf");
     GameFile f = {0};
     char infFile[12];
     snprintf(infFile, 12, "LEVEL%i.INF", levelNum);
     assert(GameEnvironmentGetFile(&f, infFile));
+    EMCSchedulerKillScript(&ctx->scheduler, &ctx->script);
+    INFScriptRelease(&ctx->script);
     assert(INFScriptFromBuffer(&ctx->script, f.buffer, f.bufferSize));
   }
   {
+    uint64_t cacheStart = TracerBegin();
+    prefillSoundFXCache(ctx);
+    if (cacheStart) {
+      TracerComplete("level", "cache sounds", cacheStart, "bytes",
+                     ctx->audio.sfxCache.numBytes);
+    }
+  }
+  {
+    TRACER_SCOPE("level", "run ini script");
     INFScript iniScript = {0};
     GameFile f = {0};
     char iniFile[12];
@@ -295,9 +382,11 @@ int GameContextLoadLevel(GameContext *ctx, int levelNum) {
     assert(INFScriptFromBuffer(&iniScript, f.buffer, f.bufferSize));
     printf("->Run INI SCRIPT\n");
     runInitScript(ctx, &iniScript);
+    INFScriptRelease(&iniScript);
     printf("<-DONE INI SCRIPT\n");
   }
   {
+    TRACER_SCOPE("level", "load xxx");
     GameFile f = {0};
     char iniFile[12];
     snprintf(iniFile, 12, "LEVEL%i.XXX", levelNum);
@@ -307,10 +396,14 @@ int GameContextLoadLevel(GameContext *ctx, int levelNum) {
   }
 
   if (levelNum != ctx->level->currentTlkFileIndex) {
+    TRACER_SCOPE("level", "load tlk");
     AudioSystemClearVoiceQueue(&ctx->audio);
     GameContextLoadTLKFile(ctx, levelNum);
   }
 
+  if (start) {
+    TracerComplete("level", "GameContextLoadLevel", start, "level", levelNum);
+  }
   return 1;
 }
 
@@ -333,9 +426,11 @@ int GameContextLoadChars(GameContext *gameCtx) {
 }
 
 int GameContextRunScript(GameContext *gameCtx, int function) {
-  EMCStateInit(&gameCtx->interpState, &gameCtx->script);
+  // only one block script at a time
+  EMCSchedulerKill(&gameCtx->scheduler, EMCTaskKind_Block);
   if (function > 0) {
-    if (!EMCStateStart(&gameCtx->interpState, function)) {
+    if (!EMCSchedulerSpawn(&gameCtx->scheduler, EMCTaskKind_Block,
+                           &gameCtx->script, function)) {
       printf("EMCInterpreterStart: invalid\n");
       return 0;
     }
@@ -346,6 +441,8 @@ int GameContextRunScript(GameContext *gameCtx, int function) {
 static int runItemFunc(GameContext *gameCtx, uint8_t func, uint16_t charId,
                        uint16_t itemId, uint16_t flags, uint16_t next,
                        uint16_t reg4) {
+  // runs to completion, the item properties may change right after
+  PROFILER_SCOPE(ProfilerPhase_Scripts);
   EMCState state = {0};
   EMCStateInit(&state, &gameCtx->engine->itemScript);
   if (!EMCStateStart(&state, func)) {
@@ -359,9 +456,7 @@ static int runItemFunc(GameContext *gameCtx, uint8_t func, uint16_t charId,
   state.regs[3] = next;
   state.regs[4] = next;
 
-  while (EMCInterpreterIsValid(&gameCtx->interp, &state)) {
-    EMCInterpreterRun(&gameCtx->interp, &state);
-  }
+  runFunction(gameCtx, &state, func);
   return 1;
 }
 
@@ -585,47 +680,47 @@ void GameContextLoadTLKFile(GameContext *gameCtx, int levelIndex) {
   snprintf(tlkFilePath, 7, "%02d.TLK", levelIndex);
   printf("load TLK file '%s'\n", tlkFilePath);
   GameEnvironmentLoadPak(&gameCtx->level->currentTlkFile, tlkFilePath);
+  TLKIndexBuild(&gameCtx->level->currentTlkIndex,
+                &gameCtx->level->currentTlkFile);
   gameCtx->level->currentTlkFileIndex = levelIndex;
 }
 
-static int getTLKSequence(GameContext *gameCtx, PAKFile *pak, int16_t charId,
+// the parts of the speaker's voice, or the ones for any speaker ('_')
+static int getTLKSequence(const TLKIndex *index, int16_t charId,
                           uint16_t soundId, const char *pattern2,
                           int fileSequence[]) {
+  char key[MAX_FILENAME] = "";
+  if (soundId >= 1000 && !(soundId & 0x4000)) {
+    snprintf(key, MAX_FILENAME, "@%04d%c.%s", soundId - 1000, (char)charId,
+             pattern2);
+    const TLKVoice *voice = TLKIndexFind(index, key);
+    if (voice && voice->parts[0] != -1) {
+      fileSequence[0] = voice->parts[0];
+      return 1;
+    }
+    return 0;
+  }
 
-  int fileSequenceIndex = 0;
   char pattern1[8] = "";
-  char file3[8] = "";
   if (soundId & 0x4000) {
     snprintf(pattern1, 8, "%03X", soundId & 0x3FFF);
-  } else if (soundId < 1000) {
-    snprintf(pattern1, 8, "%03d", soundId);
   } else {
-    snprintf(file3, 8, "@%04d%c.%s", soundId - 1000, (char)charId, pattern2);
-    int file3index = PakFileGetEntryIndex(pak, file3);
-    if (file3index != -1) {
-      fileSequence[fileSequenceIndex++] = file3index;
-    }
+    snprintf(pattern1, 8, "%03d", soundId);
   }
+  snprintf(key, MAX_FILENAME, "%s%c.%s", pattern1, (char)charId, pattern2);
+  const TLKVoice *speakerVoice = TLKIndexFind(index, key);
+  snprintf(key, MAX_FILENAME, "%s%c.%s", pattern1, '_', pattern2);
+  const TLKVoice *anyVoice = TLKIndexFind(index, key);
 
-  char file1[9] = "";
-  char file2[9] = "";
-  if (strlen(file3) == 0) {
-    for (char i = 0; i < 100; i++) {
-      char symbol = '0' + i;
-      snprintf(file1, 9, "%s%c%c.%s", pattern1, (char)charId, symbol, pattern2);
-      snprintf(file2, 9, "%s%c%c.%s", pattern1, '_', symbol, pattern2);
-
-      int file1index = PakFileGetEntryIndex(pak, file1);
-      int file2index = PakFileGetEntryIndex(pak, file2);
-      if (file1index != -1) {
-        printf("found file1='%s'\n", file1);
-        fileSequence[fileSequenceIndex++] = file1index;
-      } else if (file2index != -1) {
-        printf("found file2='%s'\n", file2);
-        fileSequence[fileSequenceIndex++] = file2index;
-      } else {
-        break;
-      }
+  int fileSequenceIndex = 0;
+  for (int i = 0; i < TLK_MAX_PARTS && fileSequenceIndex < MAX_VOC_SEQ_ENTRIES;
+       i++) {
+    if (speakerVoice && speakerVoice->parts[i] != -1) {
+      fileSequence[fileSequenceIndex++] = speakerVoice->parts[i];
+    } else if (anyVoice && anyVoice->parts[i] != -1) {
+      fileSequence[fileSequenceIndex++] = anyVoice->parts[i];
+    } else {
+      break;
     }
   }
   return fileSequenceIndex;
@@ -649,7 +744,7 @@ void GameContextPlayDialogSpeech(GameContext *gameCtx, int16_t charId,
   int fileSequence[MAX_VOC_SEQ_ENTRIES] = {0};
 
   int fileSequenceIndex =
-      getTLKSequence(gameCtx, &gameCtx->level->currentTlkFile, charId, soundId,
+      getTLKSequence(&gameCtx->level->currentTlkIndex, charId, soundId,
                      pattern2, fileSequence);
 
   if (fileSequenceIndex > 0) {
@@ -659,7 +754,7 @@ void GameContextPlayDialogSpeech(GameContext *gameCtx, int16_t charId,
     return;
   }
   // is the sequence in default TLK file?
-  fileSequenceIndex = getTLKSequence(gameCtx, &gameCtx->defaultTlkFile, charId,
+  fileSequenceIndex = getTLKSequence(&gameCtx->defaultTlkIndex, charId,
                                      soundId, pattern2, fileSequence);
 
   if (fileSequenceIndex > 0) {
@@ -767,12 +862,71 @@ static const char *const sfxNames[230] = {
     "RUCKUS3",  "CHANT1",   "EMPTY",     "EMPTY",     "EMPTY",    "CHANT2",
     "CHANT3",   ""};
 
-void GameContextPlaySoundFX(GameContext *gameCtx, uint16_t soundId) {
+#define NUM_SFX_IDS (sizeof(sfxIndex) / sizeof(sfxIndex[0]) / 2)
+#define NUM_SFX_NAMES (sizeof(sfxNames) / sizeof(sfxNames[0]))
+
+static void getSoundFXFile(uint16_t soundId, char fullName[16]) {
   uint16_t index = sfxIndex[soundId << 1];
 
   const char *name = sfxNames[index];
-  char fullName[16] = "";
   snprintf(fullName, 16, "%s.VOC", name);
+}
+
+static int cacheSoundFX(GameContext *gameCtx, uint16_t soundId) {
+  if (soundId >= NUM_SFX_IDS || sfxIndex[soundId << 1] >= NUM_SFX_NAMES) {
+    return 0;
+  }
+  char fullName[16] = "";
+  getSoundFXFile(soundId, fullName);
+  return AudioSystemCacheSoundFX(&gameCtx->audio, soundId, &gameCtx->sfxPak,
+                                 fullName);
+}
+
+// the sounds played by the engine itself, see characterSurpriseSFX
+static const uint16_t engineSoundFX[] = {78, 136, 50, 49, 48};
+
+// Decodes the sounds of the level before it starts: the ones the engine plays
+// and the constant ids passed to playSoundEffect by the level script.
+static void prefillSoundFXCache(GameContext *gameCtx) {
+  AudioSystemClearSoundFXCache(&gameCtx->audio);
+  for (size_t i = 0; i < sizeof(engineSoundFX) / sizeof(engineSoundFX[0]);
+       i++) {
+    cacheSoundFX(gameCtx, engineSoundFX[i]);
+  }
+
+  int funcNum = -1;
+  const ScriptFunDesc *builtins = getBuiltinFunctions();
+  for (size_t i = 0; i < getNumBuiltinFunctions(); i++) {
+    if (strcmp(builtins[i].name, "playSoundEffect") == 0) {
+      funcNum = i;
+      break;
+    }
+  }
+  const INFScript *script = &gameCtx->script;
+  const uint32_t numWords = script->scriptDataSize / 2;
+  const INFInstruction *prev = NULL;
+  for (uint32_t i = 0; i < numWords;) {
+    const INFInstruction *inst = script->instructions + i;
+    if (inst->opcode == OP_FUNCTION && inst->param == funcNum && prev &&
+        (prev->opcode == OP_PUSH || prev->opcode == OP_PUSH2)) {
+      cacheSoundFX(gameCtx, prev->param);
+    }
+    prev = inst;
+    i += inst->size ? inst->size : 1;
+  }
+}
+
+void GameContextPlaySoundFX(GameContext *gameCtx, uint16_t soundId) {
+  if (AudioSystemPlayCachedSoundFX(&gameCtx->audio, soundId, 255, 0)) {
+    return;
+  }
+  // decoded on first use if the cache has room left
+  if (cacheSoundFX(gameCtx, soundId) &&
+      AudioSystemPlayCachedSoundFX(&gameCtx->audio, soundId, 255, 0)) {
+    return;
+  }
+  char fullName[16] = "";
+  getSoundFXFile(soundId, fullName);
   AudioSystemPlaySoundFX(&gameCtx->audio, &gameCtx->sfxPak, fullName);
 }
 
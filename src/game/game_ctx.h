@@ -15,6 +15,7 @@
 #include "monster.h"
 #include "pak_file.h"
 #include "script.h"
+#include "script_scheduler.h"
 #include "spells.h"
 #include <stddef.h>
 #include <stdint.h>
@@ -26,6 +27,8 @@
 
 #define DIALOG_BUFFER_SIZE (size_t)1024
 
+#define MAX_BRIGHTNESS 0XFF
+
 typedef struct {
   uint16_t stringId;
   uint16_t shapeId;
@@ -83,11 +86,13 @@ typedef struct _GameContext {
   uint16_t itemIndexInHand;
   uint16_t credits;
 
+  uint16_t brightness; // 0 to MAX_BRIGHTNESS, darkens the maze sprites
+
   INFScript script;
   uint16_t nextFunc;
 
   EMCInterpreter interp;
-  EMCState interpState;
+  EMCScheduler scheduler;
 
   GameEngine *engine;
 
@@ -106,13 +111,16 @@ typedef struct _GameContext {
 
   PAKFile sfxPak;
   PAKFile defaultTlkFile; // 00.TLK
+  TLKIndex defaultTlkIndex;
   GameConfig conf;
 
   const SpellProperties *spellProperties; // count is SPELL_PROPERTIES_COUNT
 } GameContext;
 
 void GameContextRelease(GameContext *gameCtx);
-int GameContextInit(GameContext *gameCtx, Language lang);
+int GameContextInit(GameContext *gameCtx, Language lang,
+                    DisplayBackend backend, AudioBackend audioBackend,
+                    const char *audioOutFile);
 int GameContextStartup(GameContext *ctx);
 
 int GameContextSetSavDir(GameContext *gameCtx, const char *path);
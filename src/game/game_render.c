@@ -9,6 +9,7 @@
 #include "game_render.h"
 #include "geometry.h"
 #include "menu.h"
+#include "profiler.h"
 #include "render.h"
 #include "renderer.h"
 #include "ui.h"
@@ -249,3 +250,25 @@ void GameRender(GameContext *gameCtx) {
   }
   renderDialog(gameCtx);
 }
+
+void GameRenderProfilerOverlay(GameContext *gameCtx) {
+  const FNTHandle *font = &gameCtx->display->font6p;
+  const int lineHeight = font->maxHeight + 1;
+  UIFillRect(gameCtx->display->pixBuf, MAZE_COORDS_X, MAZE_COORDS_Y,
+             MAZE_COORDS_W, lineHeight * (ProfilerPhase_Count + 1) + 2,
+             (SDL_Color){0, 0, 0});
+  UISetDefaultStyle();
+  UIRenderText(font, gameCtx->display->pixBuf, MAZE_COORDS_X + 2,
+               MAZE_COORDS_Y + 1, MAZE_COORDS_W, "phase min/avg/p99 ms");
+  for (int i = 0; i < ProfilerPhase_Count; i++) {
+    ProfilerStats stats;
+    ProfilerGetStats(i, &stats);
+    char line[64];
+    snprintf(line, sizeof(line), "%s %.2f/%.2f/%.2f x%u",
+             ProfilerPhaseName(i), stats.minNs / 1000000.,
+             stats.avgNs / 1000000., stats.p99Ns / 1000000., stats.lastCalls);
+    UIRenderText(font, gameCtx->display->pixBuf, MAZE_COORDS_X + 2,
+                 MAZE_COORDS_Y + 1 + lineHeight * (i + 1), MAZE_COORDS_W,
+                 line);
+  }
+}
@@ -13,6 +13,65 @@
 #include <stdlib.h>
 #include <string.h>
 
+static const GameTimWSAFile *
+getPrefetchedWSA(const GameTimInterpreter *timInterp, const char *wsaFile) {
+  for (int i = 0; i < NUM_TIM_ANIMATIONS; i++) {
+    for (int j = 0; j < NUM_TIM_PREFETCHED_WSA; j++) {
+      const GameTimWSAFile *entry = &timInterp->wsaFiles[i][j];
+      if (entry->name && strcmp(entry->name, wsaFile) == 0) {
+        return entry;
+      }
+    }
+  }
+  return NULL;
+}
+
+// xoring over the cleared buffer gives the same frame, whatever the WSA flags
+static uint8_t *decodeFirstFrame(const GameFile *file) {
+  WSAHandle wsa;
+  WSAHandleInit(&wsa);
+  if (!WSAHandleFromBuffer(&wsa, file->buffer, file->bufferSize) ||
+      wsa.header.numFrames == 0) {
+    return NULL;
+  }
+  uint8_t *frame = calloc(wsa.header.width * wsa.header.height, 1);
+  assert(frame);
+  if (!WSAHandleGetFrame(&wsa, 0, frame, 1)) {
+    free(frame);
+    return NULL;
+  }
+  return frame;
+}
+
+// looks up the WSA files of the TIM and decodes their first frame now, so that
+// playing it doesn't search the PAK files nor decompress the opening frames
+static void prefetchWSAFiles(GameTimInterpreter *timInterp, uint16_t scriptId) {
+  const TIMHandle *tim = &timInterp->tim[scriptId];
+  GameTimWSAFile *wsaFiles = timInterp->wsaFiles[scriptId];
+  int count = 0;
+  for (size_t i = 0; i < tim->numEvents; i++) {
+    const TIMEvent *event = tim->events + i;
+    if (event->instrCode != TIM_COMMAND_ID_WSA_INIT || event->numParams < 2 ||
+        event->params[1] >= tim->numTextStrings) {
+      continue;
+    }
+    const char *wsaFile = TIMHandleGetText(tim, event->params[1]);
+    if (getPrefetchedWSA(timInterp, wsaFile)) {
+      continue;
+    }
+    if (count == NUM_TIM_PREFETCHED_WSA) {
+      printf("GameTimAnimator: too many WSA files to prefetch\n");
+      return;
+    }
+    GameTimWSAFile *entry = wsaFiles + count;
+    if (GameEnvironmentGetFileWithExt(&entry->file, wsaFile, "WSA")) {
+      entry->name = wsaFile;
+      entry->firstFrame = decodeFirstFrame(&entry->file);
+      count++;
+    }
+  }
+}
+
 static void callbackTIM_WSAInit(TIMInterpreter *interp, uint16_t index,
                                 const char *wsaFile, int x, int y,
                                 int offscreen, int flags) {
@@ -20,9 +79,17 @@ static void callbackTIM_WSAInit(TIMInterpreter *interp, uint16_t index,
   GameFile f = {0};
   printf("----> GameTimAnimator load wsa file '%s' index %i offscreen=%i\n",
          wsaFile, index, offscreen);
-  assert(GameEnvironmentGetFileWithExt(&f, wsaFile, "WSA"));
+  const GameTimWSAFile *prefetched =
+      getPrefetchedWSA(&gameCtx->timInterpreter, wsaFile);
+  if (prefetched) {
+    f = prefetched->file;
+  } else {
+    assert(GameEnvironmentGetFileWithExt(&f, wsaFile, "WSA"));
+  }
   AnimatorInitWSA(&gameCtx->animator, f.buffer, f.bufferSize, x, y, offscreen,
                   flags);
+  gameCtx->timInterpreter.pendingFirstFrame =
+      prefetched && prefetched->firstFrame ? prefetched : NULL;
 }
 
 static void callbackTIM_WSADisplayFrame(TIMInterpreter *interp, int animIndex,
@@ -39,10 +106,18 @@ static void callbackTIM_WSADisplayFrame(TIMInterpreter *interp, int animIndex,
     printf("WSADisplayFrame: unimplemented WSA loop, setting frame to 0\n");
     frame = 0;
   }
-  WSAHandleGetFrame(&timInterp->animator->wsa, frame,
-                    timInterp->animator->wsaFrameBuffer,
-                    timInterp->animator->wsaFlags & WSA_XOR);
   assert(timInterp->animator->wsaFrameBuffer);
+  if (frame == 0 && timInterp->pendingFirstFrame) {
+    memcpy(timInterp->animator->wsaFrameBuffer,
+           timInterp->pendingFirstFrame->firstFrame,
+           timInterp->animator->wsa.header.width *
+               timInterp->animator->wsa.header.height);
+  } else {
+    WSAHandleGetFrame(&timInterp->animator->wsa, frame,
+                      timInterp->animator->wsaFrameBuffer,
+                      timInterp->animator->wsaFlags & WSA_XOR);
+  }
+  timInterp->pendingFirstFrame = NULL;
   AnimatorRenderWSAFrame(timInterp->animator);
 }
 
@@ -172,15 +247,20 @@ void GameTimInterpreterInit(GameTimInterpreter *timInterpreter,
 }
 
 void GameTimInterpreterRelease(GameTimInterpreter *animator) {
+  for (int i = 0; i < NUM_TIM_ANIMATIONS; i++) {
+    GameTimInterpreterReleaseTim(animator, i);
+  }
   AnimatorRelease(animator->animator);
 }
 
 void GameTimInterpreterLoadTim(GameTimInterpreter *timInterp, uint16_t scriptId,
                                const char *file) {
   GameFile f = {0};
+  GameTimInterpreterReleaseTim(timInterp, scriptId);
   assert(GameEnvironmentGetFileWithExt(&f, file, "TIM"));
   assert(
       TIMHandleFromBuffer(&timInterp->tim[scriptId], f.buffer, f.bufferSize));
+  prefetchWSAFiles(timInterp, scriptId);
 }
 
 void GameTimInterpreterRunTim(GameTimInterpreter *timInterp,
@@ -191,7 +271,20 @@ void GameTimInterpreterRunTim(GameTimInterpreter *timInterp,
 
 void GameTimInterpreterReleaseTim(GameTimInterpreter *timInterp,
                                   uint16_t scriptId) {
-  TIMHandleInit(&timInterp->tim[scriptId]);
+  if (timInterp->timInterpreter._tim == &timInterp->tim[scriptId]) {
+    timInterp->timInterpreter._tim = NULL;
+  }
+  TIMHandleRelease(&timInterp->tim[scriptId]);
+  for (int i = 0; i < NUM_TIM_PREFETCHED_WSA; i++) {
+    const GameTimWSAFile *entry = &timInterp->wsaFiles[scriptId][i];
+    if (timInterp->pendingFirstFrame == entry) {
+      timInterp->pendingFirstFrame = NULL;
+    }
+    free(entry->firstFrame);
+  }
+  // the files belong to the PAK cache
+  memset(timInterp->wsaFiles[scriptId], 0,
+         sizeof(timInterp->wsaFiles[scriptId]));
 }
 
 int GameTimInterpreterRender(GameTimInterpreter *timInterp) {
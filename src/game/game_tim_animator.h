@@ -2,11 +2,20 @@
 
 #include "animator.h"
 #include "formats/format_tim.h"
+#include "game_envir.h"
 #include "tim_interpreter.h"
 #include <SDL2/SDL.h>
 #include <stdint.h>
 
 #define NUM_TIM_ANIMATIONS 4
+#define NUM_TIM_PREFETCHED_WSA 8
+
+// a WSA file used by a loaded TIM, looked up before playing it
+typedef struct {
+  const char *name; // NULL for an unused entry
+  GameFile file;
+  uint8_t *firstFrame; // decoded over a cleared frame buffer, can be NULL
+} GameTimWSAFile;
 
 typedef struct {
 
@@ -14,6 +23,9 @@ typedef struct {
   uint16_t currentTimScriptId;
 
   TIMHandle tim[NUM_TIM_ANIMATIONS];
+  GameTimWSAFile wsaFiles[NUM_TIM_ANIMATIONS][NUM_TIM_PREFETCHED_WSA];
+  // first frame of the WSA just initialized, NULL once displayed
+  const GameTimWSAFile *pendingFirstFrame;
   Animator *animator;
 } GameTimInterpreter;
 
@@ -11,6 +11,8 @@
 #include "formats/format_xxx.h"
 #include "monster.h"
 #include "pak_file.h"
+#include "renderer.h"
+#include "tlk_index.h"
 #include <stdint.h>
 
 #define MAX_MONSTER_PROPERTIES 5
@@ -24,6 +26,7 @@ typedef struct {
 typedef struct _LevelContext {
   VCNHandle vcnHandle;
   VMPHandle vmpHandle;
+  WallBlitPlan wallPlan; // built from vcnHandle/vmpHandle by levelGraphics
   TLCHandle tlcHandle;
   WllHandle wllHandle;
   DatHandle datHandle;
@@ -37,6 +40,7 @@ typedef struct _LevelContext {
   Monster monsters[MAX_MONSTERS];
 
   PAKFile currentTlkFile;
+  TLKIndex currentTlkIndex;
   int currentTlkFileIndex;
 
   BlockProperty blockProperties[MAZE_NUM_CELL];
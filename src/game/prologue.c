@@ -272,6 +272,25 @@ static void RenderCharSelection(GameContext *gameCtx, Prologue *prologue,
                        textBuffer);
 }
 
+// Headless runs are unattended: once a loop has rendered
+// PROLOGUE_HEADLESS_FRAMES frames, the wait returns a click at x, y.
+static int waitMouseEvent(GameContext *gameCtx, SDL_Event *e,
+                          uint32_t startFrame, int x, int y) {
+  int r = DisplayWaitMouseEvent(gameCtx->display, e, gameCtx->conf.tickLength);
+  if (r == -1 && gameCtx->display->backend == DisplayBackend_Headless &&
+      gameCtx->display->frameCount - startFrame >= PROLOGUE_HEADLESS_FRAMES) {
+    e->type = SDL_MOUSEBUTTONDOWN;
+    e->button.x = x * SCREEN_FACTOR;
+    e->button.y = y * SCREEN_FACTOR;
+    return 1;
+  }
+  return r;
+}
+
+// center of the face of the character picked by the headless runs
+#define HEADLESS_CHAR_X (93 + 58 * PROLOGUE_HEADLESS_CHAR + 18)
+#define HEADLESS_CHAR_Y (123 + 19)
+
 static void CharSelectionLoop(GameContext *gameCtx, Prologue *prologue);
 static void CharTextBoxLoop(GameContext *gameCtx, Prologue *prologue);
 static void KingIntroLoop(GameContext *gameCtx, Prologue *prologue);
@@ -367,10 +386,11 @@ static void CharTextBoxLoop(GameContext *gameCtx, Prologue *prologue) {
                        124, 38, 38, 320);
 
   int frameIndex = 0;
+  uint32_t startFrame = gameCtx->display->frameCount;
   while (gameCtx->_shouldRun) {
     SDL_Event e = {0};
-    int r =
-        DisplayWaitMouseEvent(gameCtx->display, &e, gameCtx->conf.tickLength);
+    // headless: accept the character
+    int r = waitMouseEvent(gameCtx, &e, startFrame, 87 + 20, 180 + 7);
     if (r == 0) {
       gameCtx->_shouldRun = 0;
       break;
@@ -531,13 +551,14 @@ static void KingIntroLoop(GameContext *gameCtx, Prologue *prologue) {
   RenderCharSelection(gameCtx, prologue, 1);
 
   int animIndex = 0;
+  uint32_t startFrame = gameCtx->display->frameCount;
 
   while (gameCtx->_shouldRun && AudioSystemGetCurrentVoiceIndex(
                                     &gameCtx->audio) == kingAudioSequenceId) {
 
     SDL_Event e = {0};
-    int r =
-        DisplayWaitMouseEvent(gameCtx->display, &e, gameCtx->conf.tickLength);
+    int r = waitMouseEvent(gameCtx, &e, startFrame, HEADLESS_CHAR_X,
+                           HEADLESS_CHAR_Y);
     if (r == 0) {
       gameCtx->_shouldRun = 0;
       return;
@@ -633,10 +654,11 @@ static void CharSelectionLoop(GameContext *gameCtx, Prologue *prologue) {
   prologue->isFirst = 0;
 
   uint32_t start = SDL_GetTicks();
+  uint32_t startFrame = gameCtx->display->frameCount;
   while (gameCtx->_shouldRun) {
     SDL_Event e = {0};
-    int r =
-        DisplayWaitMouseEvent(gameCtx->display, &e, gameCtx->conf.tickLength);
+    int r = waitMouseEvent(gameCtx, &e, startFrame, HEADLESS_CHAR_X,
+                           HEADLESS_CHAR_Y);
     if (r == 0) {
       gameCtx->_shouldRun = 0;
       return;
@@ -2,5 +2,11 @@
 
 typedef struct _GameContext GameContext;
 
+// headless runs click this character, then accept it, each after this number
+// of frames
+#define PROLOGUE_HEADLESS_CHAR 0
+#define PROLOGUE_HEADLESS_FRAMES 50
+
 extern const char *charNames[4];
+// returns the selected character
 int PrologueShow(GameContext *gameCtx);
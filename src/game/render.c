@@ -4,6 +4,7 @@
 #include "game_ctx.h"
 #include "geometry.h"
 #include "level.h"
+#include "profiler.h"
 #include "renderer.h"
 #include <assert.h>
 #include <stdint.h>
@@ -124,8 +125,20 @@ typedef struct {
   int xFlip;
 } RenderWall;
 
+// fade levels added for each cell away from the party
+#define FADE_LEVELS_PER_CELL 4
+
+// distance 0 only applies the brightness
+static const uint8_t *getFadeTable(const GameContext *gameCtx, int distance) {
+  int level = distance * FADE_LEVELS_PER_CELL;
+  level += (MAX_BRIGHTNESS - gameCtx->brightness) * TLC_NUM_FADE_TABLES /
+           (MAX_BRIGHTNESS + 1);
+  return TLCHandleGetFadeTable(&gameCtx->level->tlcHandle, level);
+}
+
 static void renderDecoration(SDL_Texture *pixBuf, LevelContext *level,
-                             const RenderWall *wall, uint16_t decorationId) {
+                             const RenderWall *wall, uint16_t decorationId,
+                             const uint8_t *fadeTable) {
   const DatDecoration *deco = level->datHandle.datDecoration + decorationId;
   if (deco->shapeIndex[wall->decoIndex] != DECORATION_EMPTY_INDEX) {
     SHPFrame frame = {0};
@@ -134,28 +147,29 @@ static void renderDecoration(SDL_Texture *pixBuf, LevelContext *level,
     SHPFrameGetImageData(&frame);
     drawSHPMazeFrame(pixBuf, &frame, deco->shapeX[wall->decoIndex] + wall->x,
                      deco->shapeY[wall->decoIndex] + wall->y,
-                     level->vcnHandle.palette, wall->xFlip, 1);
+                     level->vcnHandle.palette, wall->xFlip, fadeTable);
     int isFrontWall = (wall->cellId == CELL_N || wall->cellId == CELL_J ||
                        wall->cellId == CELL_D);
     if (isFrontWall && deco->flags & DatDecorationFlags_Mirror) {
       drawSHPMazeFrame(pixBuf, &frame, deco->shapeX[wall->decoIndex] + wall->x,
                        deco->shapeY[wall->decoIndex] + wall->y,
-                       level->vcnHandle.palette, 1, 1);
+                       level->vcnHandle.palette, 1, fadeTable);
     }
     SHPFrameRelease(&frame);
   }
   if (deco->next) {
-    renderDecoration(pixBuf, level, wall, deco->next);
+    renderDecoration(pixBuf, level, wall, deco->next, fadeTable);
   }
 }
 
 static void renderWallDecoration(SDL_Texture *pixBuf, LevelContext *level,
-                                 const RenderWall *wall, uint8_t wmi) {
+                                 const RenderWall *wall, uint8_t wmi,
+                                 const uint8_t *fadeTable) {
   const WllWallMapping *mapping =
       WllHandleGetWallMapping(&level->wllHandle, wmi);
   if (mapping && mapping->decorationId != 0 &&
       mapping->decorationId < level->datHandle.nbrDecorations) {
-    renderDecoration(pixBuf, level, wall, mapping->decorationId);
+    renderDecoration(pixBuf, level, wall, mapping->decorationId, fadeTable);
   }
 }
 
@@ -224,13 +238,9 @@ static void renderEnemy(GameContext *gameCtx, const Monster *monster,
   if (cell->frontDist > 1) {
     SHPFrameScale(&f, f.header.width / ratioX, f.header.height / ratioY);
   }
-  float att = 1.0f;
-  if (cell->frontDist > 1) {
-    att = 1.5f * abs(cell->frontDist);
-  }
-
   drawSHPMazeFrame(gameCtx->display->pixBuf, &f, x, y,
-                   gameCtx->level->vcnHandle.palette, 0, att);
+                   gameCtx->level->vcnHandle.palette, 0,
+                   getFadeTable(gameCtx, cell->frontDist - 1));
   SHPFrameRelease(&f);
 }
 
@@ -278,9 +288,9 @@ static void renderDoor(GameContext *gameCtx, int cellId) {
     SHPFrameScale(&frame, frame.header.width / ratioX,
                   frame.header.height / ratioY);
   }
-  float att = 1.f * abs(cell->frontDist);
   drawSHPMazeFrame(gameCtx->display->pixBuf, &frame, x, y,
-                   gameCtx->level->vcnHandle.palette, 0, att);
+                   gameCtx->level->vcnHandle.palette, 0,
+                   getFadeTable(gameCtx, cell->frontDist - 1));
   SHPFrameRelease(&frame);
 }
 
@@ -314,7 +324,43 @@ static RenderWall renderWalls[] = {
 
 };
 
+#define NUM_RENDER_WALLS (sizeof(renderWalls) / sizeof(RenderWall))
+
+typedef struct {
+  int blockId;
+  uint8_t wmi;
+  uint16_t wallType;
+  uint8_t visible;
+} RenderWallState;
+
+// Front to back pass: a slot is skipped when every column it touches is
+// already covered by an opaque wall nearer to the party.
+static void computeWallVisibility(GameContext *gameCtx,
+                                  RenderWallState *states) {
+  LevelContext *level = gameCtx->level;
+  uint32_t covered = 0;
+  for (int i = NUM_RENDER_WALLS - 1; i >= 0; i--) {
+    const RenderWall *r = renderWalls + i;
+    const ViewConeEntry *entry = _viewConeEntries + r->cellId;
+    RenderWallState *state = states + i;
+    state->blockId = entry->coords.y * 32 + entry->coords.x;
+    Orientation absOri = absOrientation(gameCtx->orientation, r->orientation);
+    state->wmi = level->blockProperties[state->blockId].walls[absOri];
+    state->wallType =
+        state->wmi ? WllHandleGetWallType(&level->wllHandle, state->wmi) : 0;
+
+    uint32_t columns = WallRenderIndexGetColumns(r->wallRenderIndex);
+    state->visible = (columns & ~covered) != 0;
+    if (state->visible && state->wallType) {
+      covered |= WallBlitPlanGetOpaqueColumns(&level->wallPlan,
+                                              state->wallType,
+                                              r->wallRenderIndex);
+    }
+  }
+}
+
 void GameRenderMaze(GameContext *gameCtx) {
+  PROFILER_SCOPE(ProfilerPhase_RenderMaze);
   clearMazeZone(gameCtx);
   for (int x = 0; x < 32; x++) {
     for (int y = 0; y < 32; y++) {
@@ -322,24 +368,29 @@ void GameRenderMaze(GameContext *gameCtx) {
     }
   }
   LevelContext *level = gameCtx->level;
+  // the ceiling/floor is mirrored on every step to give a sense of motion
+  int ceilingVariant = ((gameCtx->currentBock & 0X1F) +
+                        (gameCtx->currentBock >> 5) + gameCtx->orientation) &
+                       1;
   drawCeilingAndFloor(gameCtx->display->pixBuf, &level->vcnHandle,
-                      &level->vmpHandle);
+                      &level->wallPlan, ceilingVariant);
 
   SDL_Texture *texture = gameCtx->display->pixBuf;
 
-  for (int i = 0; i < sizeof(renderWalls) / sizeof(RenderWall); i++) {
+  RenderWallState states[NUM_RENDER_WALLS];
+  computeWallVisibility(gameCtx, states);
+
+  for (int i = 0; i < NUM_RENDER_WALLS; i++) {
     const RenderWall *r = renderWalls + i;
-    const ViewConeEntry *entry = _viewConeEntries + r->cellId;
-    if (!entry) {
+    const RenderWallState *state = states + i;
+    if (!state->visible) {
       continue;
     }
-    int blockId = entry->coords.y * 32 + entry->coords.x;
-    Orientation absOri = absOrientation(gameCtx->orientation, r->orientation);
-
-    uint8_t wmi = gameCtx->level->blockProperties[blockId].walls[absOri];
+    int blockId = state->blockId;
+    uint8_t wmi = state->wmi;
 
     if (wmi) {
-      uint16_t wallType = WllHandleGetWallType(&level->wllHandle, wmi);
+      uint16_t wallType = state->wallType;
       if (wallType) {
 
         if (r->orientation == South &&
@@ -350,11 +401,11 @@ void GameRenderMaze(GameContext *gameCtx) {
             wallType == 3) { // door
           renderDoor(gameCtx, r->cellId);
         }
-        drawWall(texture, &level->vcnHandle, &level->vmpHandle, wallType,
+        drawWall(texture, &level->vcnHandle, &level->wallPlan, wallType,
                  r->wallRenderIndex);
       }
       if (r->decoIndex != 0) {
-        renderWallDecoration(texture, level, r, wmi);
+        renderWallDecoration(texture, level, r, wmi, getFadeTable(gameCtx, 0));
       }
     }
     if (r->cellId == CELL_N || r->cellId == CELL_J || r->cellId == CELL_I ||
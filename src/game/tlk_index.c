@@ -0,0 +1,95 @@
+#include "tlk_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void TLKIndexInit(TLKIndex *index) { memset(index, 0, sizeof(TLKIndex)); }
+
+void TLKIndexRelease(TLKIndex *index) {
+  free(index->voices);
+  TLKIndexInit(index);
+}
+
+// FNV-1a
+static uint32_t hashKey(const char *key) {
+  uint32_t hash = 2166136261U;
+  for (; *key; key++) {
+    hash = (hash ^ (uint8_t)*key) * 16777619U;
+  }
+  return hash;
+}
+
+// open addressing, the table is at most half full
+static TLKVoice *getSlot(const TLKIndex *index, const char *key) {
+  uint32_t slot = hashKey(key) & (index->capacity - 1);
+  for (;;) {
+    TLKVoice *voice = index->voices + slot;
+    if (voice->key[0] == 0 || strcmp(voice->key, key) == 0) {
+      return voice;
+    }
+    slot = (slot + 1) & (index->capacity - 1);
+  }
+}
+
+// splits the file name into the voice key and the part number
+static int parseFileName(const char *fileName, char key[MAX_FILENAME],
+                         int *part) {
+  const char *ext = strchr(fileName, '.');
+  if (!ext) {
+    return 0;
+  }
+  size_t baseLen = ext - fileName;
+  if (fileName[0] == '@') {
+    *part = 0;
+    snprintf(key, MAX_FILENAME, "%s", fileName);
+    return 1;
+  }
+  // at least one char for the voice, the speaker and the part
+  if (baseLen < 3) {
+    return 0;
+  }
+  *part = fileName[baseLen - 1] - '0';
+  if (*part < 0 || *part >= TLK_MAX_PARTS) {
+    return 0;
+  }
+  snprintf(key, MAX_FILENAME, "%.*s%s", (int)baseLen - 1, fileName, ext);
+  return 1;
+}
+
+int TLKIndexBuild(TLKIndex *index, const PAKFile *pak) {
+  TLKIndexRelease(index);
+  index->capacity = 16;
+  while (index->capacity < (uint32_t)pak->count * 2) {
+    index->capacity *= 2;
+  }
+  index->voices = calloc(index->capacity, sizeof(TLKVoice));
+  if (!index->voices) {
+    TLKIndexInit(index);
+    return 0;
+  }
+  for (int i = 0; i < pak->count; i++) {
+    char key[MAX_FILENAME];
+    int part = 0;
+    if (!parseFileName(pak->entries[i].filename, key, &part)) {
+      continue;
+    }
+    TLKVoice *voice = getSlot(index, key);
+    if (voice->key[0] == 0) {
+      memcpy(voice->key, key, MAX_FILENAME);
+      for (int j = 0; j < TLK_MAX_PARTS; j++) {
+        voice->parts[j] = -1;
+      }
+      index->numVoices++;
+    }
+    voice->parts[part] = i;
+  }
+  return 1;
+}
+
+const TLKVoice *TLKIndexFind(const TLKIndex *index, const char *key) {
+  if (index->capacity == 0) {
+    return NULL;
+  }
+  const TLKVoice *voice = getSlot(index, key);
+  return voice->key[0] ? voice : NULL;
+}
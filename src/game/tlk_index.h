@@ -0,0 +1,28 @@
+#pragma once
+#include "pak_file.h"
+#include <stdint.h>
+
+// voice parts are numbered from 0 in the file names
+#define TLK_MAX_PARTS 10
+
+// The TLK files are named <voice><speaker><part>.<level>, '_' being any
+// speaker, or @<voice><speaker>.<level> for single part voices.
+typedef struct {
+  char key[MAX_FILENAME]; // the file name without the part number
+  int parts[TLK_MAX_PARTS]; // PAK entry indices, -1 if missing
+} TLKVoice;
+
+// maps the voices of a TLK file to their parts, built once when the file is
+// loaded
+typedef struct {
+  TLKVoice *voices;
+  uint32_t capacity; // power of 2
+  int numVoices;
+} TLKIndex;
+
+void TLKIndexInit(TLKIndex *index);
+void TLKIndexRelease(TLKIndex *index);
+int TLKIndexBuild(TLKIndex *index, const PAKFile *pak);
+
+// returns NULL if there's no file for the key
+const TLKVoice *TLKIndexFind(const TLKIndex *index, const char *key);
@@ -1,4 +1,5 @@
 
+#include "audio.h"
 #include "bytes.h"
 #include "config.h"
 #include "dbg/debugger.h"
@@ -22,9 +23,14 @@
 #include "pak_file.h"
 #include "renderer.h"
 #include "script.h"
+#include "script_compiler.h"
 #include "script_disassembler.h"
+#include "script_runner.h"
+#include "script_verifier.h"
+#include "tim_checker.h"
 #include "tim_dumper.h"
 #include <assert.h>
+#include <getopt.h>
 #include <sndfile.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -157,7 +163,9 @@ static int cmdVMP(int argc, char *argv[]) {
 }
 
 static void usageScript(void) {
-  printf("script subcommands: strings|offsets|disasm [infile] [outfile] \n");
+  printf("script subcommands: strings|offsets|disasm|compile [infile] "
+         "[outfile] \n");
+  printf("                   run infile [--function N] [--repeat K]\n");
 }
 
 static int cmdScriptStrings(const char *filepath) {
@@ -177,6 +185,7 @@ static int cmdScriptStrings(const char *filepath) {
   for (int i = 0; i < script.numTextStrings; i++) {
     printf("%i '%s'\n", i, INFScriptGetDataString(&script, i));
   }
+  INFScriptRelease(&script);
 
   if (freeBuffer) {
     free(iffData);
@@ -200,10 +209,17 @@ static int cmdScriptOffsets(const char *filepath) {
 
   for (int i = 0; i < INFScriptGetNumFunctions(&script); i++) {
     int offset = INFScriptGetFunctionOffset(&script, i);
-    if (offset != -1) {
-      printf("0X%X %X\n", i, offset);
+    if (offset == -1) {
+      continue;
+    }
+    // max stack depth, from the verifier
+    if (script.maxStackDepths[i] == EMC_VERIFIER_UNKNOWN_DEPTH) {
+      printf("0X%X %X stack ?\n", i, offset);
+    } else {
+      printf("0X%X %X stack %i\n", i, offset, script.maxStackDepths[i]);
     }
   }
+  INFScriptRelease(&script);
   if (freeBuffer) {
     free(iffData);
   }
@@ -221,21 +237,10 @@ static int cmdScriptDisasm(const char *filepath, const char *outFile) {
     return 1;
   }
 
-  EMCInterpreter interp = {0};
   EMCDisassembler disassembler = {0};
   EMCDisassemblerInit(&disassembler);
-  interp.disassembler = &disassembler;
   disassembler.showDisamComment = 1;
-  EMCState state = {0};
-  EMCStateInit(&state, &script);
-
-  int n = 0;
-  while (EMCInterpreterIsValid(&interp, &state)) {
-    if (EMCInterpreterRun(&interp, &state) == 0) {
-      printf("EMCInterpreterRun returned 0\n");
-    }
-    n++;
-  }
+  int n = EMCDisassemblerRun(&disassembler, &script);
 
   FILE *file = fopen(outFile, "w");
   if (file) {
@@ -244,13 +249,92 @@ static int cmdScriptDisasm(const char *filepath, const char *outFile) {
   }
 
   EMCDisassemblerRelease(&disassembler);
-  printf("Exec'ed %i / %i instructions\n", n, script.scriptDataSize);
+  INFScriptRelease(&script);
+  printf("Disassembled %i instructions, %i bytes\n", n,
+         script.scriptDataSize);
   if (freeBuffer) {
     free(iffData);
   }
   return 0;
 }
 
+static int cmdScriptCompile(const char *filepath, const char *outFile) {
+  size_t dataSize = 0;
+  int freeBuffer = 0;
+  uint8_t *iffData = getFileContent(filepath, &dataSize, &freeBuffer);
+
+  INFScript script = {0};
+  if (!INFScriptFromBuffer(&script, iffData, dataSize)) {
+    printf("INFScriptFromBuffer error\n");
+    return 1;
+  }
+
+  int ret = 1;
+  FILE *file = fopen(outFile, "w");
+  if (file) {
+    ret = !EMCCompilerWriteC(&script, filepath, file);
+    fclose(file);
+  } else {
+    perror("fopen");
+  }
+
+  INFScriptRelease(&script);
+  if (freeBuffer) {
+    free(iffData);
+  }
+  return ret;
+}
+
+static int cmdScriptRun(int argc, char *argv[]) {
+  int function = -1;
+  int repeat = 0;
+  static const struct option longOptions[] = {
+      {"function", required_argument, NULL, 'f'},
+      {"repeat", required_argument, NULL, 'r'},
+      {NULL, 0, NULL, 0},
+  };
+  optind = 0;
+  int c;
+  while ((c = getopt_long(argc, argv, "f:r:", longOptions, NULL)) != -1) {
+    switch (c) {
+    case 'f':
+      function = atoi(optarg);
+      break;
+    case 'r':
+      repeat = atoi(optarg);
+      break;
+    default:
+      usageScript();
+      return 1;
+    }
+  }
+  if (optind >= argc) {
+    usageScript();
+    return 1;
+  }
+  const char *filepath = argv[optind];
+
+  size_t dataSize = 0;
+  int freeBuffer = 0;
+  uint8_t *iffData = getFileContent(filepath, &dataSize, &freeBuffer);
+  if (!iffData) {
+    return 1;
+  }
+
+  INFScript script = {0};
+  if (!INFScriptFromBuffer(&script, iffData, dataSize)) {
+    printf("INFScriptFromBuffer error\n");
+    return 1;
+  }
+  int ret = ScriptRunnerRun(&script, function, repeat);
+
+  INFScriptRelease(&script);
+  if (freeBuffer) {
+    free(iffData);
+  }
+  return ret;
+}
+
 static int cmdScript(int argc, char *argv[]) {
   if (argc < 2) {
     usageScript();
@@ -264,8 +348,16 @@ static int cmdScript(int argc, char *argv[]) {
       return 1;
     }
     return cmdScriptDisasm(argv[1], argv[2]);
+  } else if (strcmp(argv[0], "compile") == 0) {
+    if (argc < 3) {
+      usageScript();
+      return 1;
+    }
+    return cmdScriptCompile(argv[1], argv[2]);
   } else if (strcmp(argv[0], "strings") == 0) {
     return cmdScriptStrings(argv[1]);
+  } else if (strcmp(argv[0], "run") == 0) {
+    return cmdScriptRun(argc, argv);
   }
   usageScript();
   return 1;
@@ -314,7 +406,8 @@ static int cmdCONF(int argc, char *argv[]) {
 }
 
 static void usageVOC(void) {
-  printf("voc subcommands: info|extract filepath [outfile]\n");
+  printf("voc subcommands: info|extract|play filepath [outfile]\n");
+  printf("\tplay: stream the file as music, to a WAV file if outfile is set\n");
 }
 
 static int doVocExtract(const VOCHandle *handle, const char *outFilePath) {
@@ -436,6 +529,57 @@ static int cmdVocInfo(const char *vocFile) {
 
   return 0;
 }
+static int cmdVocPlay(const char *vocFile, const char *outFile) {
+  size_t dataSize = 0;
+  int freeBuffer = 0;
+  uint8_t *buffer = getFileContent(vocFile, &dataSize, &freeBuffer);
+  if (!buffer) {
+    printf("Error while getting data for '%s'\n", vocFile);
+    return 1;
+  }
+  GameConfig conf;
+  GameConfigCreateDefault(&conf);
+  AudioBackend backend = outFile ? AudioBackend_Null : AudioBackend_Device;
+  if (backend == AudioBackend_Device && SDL_Init(SDL_INIT_AUDIO) < 0) {
+    printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+    if (freeBuffer) {
+      free(buffer);
+    }
+    return 1;
+  }
+
+  static AudioSystem audio;
+  int ret = 1;
+  if (AudioSystemInit(&audio, &conf, backend, outFile)) {
+    if (AudioSystemPlayMusicBuffer(&audio, buffer, dataSize, 0)) {
+      ret = 0;
+    } else {
+      printf("Error while reading file\n");
+    }
+  }
+  // decoded by the music thread, or mixed here with the null backend
+  while (ret == 0 && AudioSystemIsMusicPlaying(&audio)) {
+    if (backend == AudioBackend_Null) {
+      AudioSystemAdvance(&audio, 100);
+    } else {
+      SDL_Delay(100);
+    }
+  }
+  if (ret == 0 && backend == AudioBackend_Device) {
+    // the last block given to the device
+    SDL_Delay(100);
+  }
+  AudioSystemRelease(&audio);
+  if (backend == AudioBackend_Device) {
+    SDL_Quit();
+  }
+
+  if (freeBuffer) {
+    free(buffer);
+  }
+  return ret;
+}
+
 static int cmdVOC(int argc, char *argv[]) {
   if (argc < 2) {
     usageVOC();
@@ -452,11 +596,18 @@ static int cmdVOC(int argc, char *argv[]) {
     const char *vocFile = argv[1];
     const char *outFile = argv[2];
     return cmdVocExtract(vocFile, outFile);
+  } else if (strcmp(argv[0], "play") == 0) {
+    const char *vocFile = argv[1];
+    const char *outFile = argc > 2 ? argv[2] : NULL;
+    return cmdVocPlay(vocFile, outFile);
   }
   usageVOC();
   return 0;
 }
-static void usageTim(void) { printf("tim subcommands: show filepath\n"); }
+static void usageTim(void) {
+  printf("tim subcommands: show filepath | check-all [-j jobs] [-r repeat] "
+         "[dataDir]\n");
+}
 
 static int cmdTimShow(const char *file) {
   size_t dataSize = 0;
@@ -473,6 +624,7 @@ static int cmdTimShow(const char *file) {
   } else {
     DumpTim(&handle);
   }
+  TIMHandleRelease(&handle);
 
   if (freeBuffer) {
     free(buffer);
@@ -481,12 +633,42 @@ static int cmdTimShow(const char *file) {
   return 0;
 }
 
+static int cmdTimCheckAll(int argc, char *argv[]) {
+  long numJobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int repeat = 1;
+  static const struct option longOptions[] = {
+      {"jobs", required_argument, NULL, 'j'},
+      {"repeat", required_argument, NULL, 'r'},
+      {NULL, 0, NULL, 0},
+  };
+  optind = 0;
+  int c;
+  while ((c = getopt_long(argc, argv, "j:r:", longOptions, NULL)) != -1) {
+    switch (c) {
+    case 'j':
+      numJobs = atoi(optarg);
+      break;
+    case 'r':
+      repeat = atoi(optarg);
+      break;
+    default:
+      usageTim();
+      return 1;
+    }
+  }
+  const char *dataDir = optind < argc ? argv[optind] : "data";
+  return TIMCheckerRun(dataDir, numJobs > 0 ? numJobs : 1, repeat);
+}
+
 static int cmdTim(int argc, char *argv[]) {
-  if (argc < 2) {
+  if (argc < 1) {
     usageTim();
     return 1;
   }
-  if (strcmp(argv[0], "show") == 0) {
+  if (strcmp(argv[0], "check-all") == 0) {
+    return cmdTimCheckAll(argc, argv);
+  }
+  if (strcmp(argv[0], "show") == 0 && argc > 1) {
     return cmdTimShow(argv[1]);
   }
   usageTim();
@@ -0,0 +1,532 @@
+#include "script_runner.h"
+#include "formats/format_sav.h"
+#include "profiler.h"
+#include "script.h"
+#include "script_profiler.h"
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a script waiting for something that never comes (eg. a mouse click) would
+// loop forever
+#define SCRIPT_RUNNER_MAX_STEPS 100000
+#define SCRIPT_RUNNER_NUM_FLAGS 100
+#define SCRIPT_RUNNER_NUM_VARS 16
+
+typedef enum {
+  SideEffect_Asset = 0,
+  SideEffect_Monster,
+  SideEffect_Flag,
+  SideEffect_Other,
+
+  SideEffect_Count,
+} SideEffect;
+
+static const char *sideEffectNames[SideEffect_Count] = {
+    "asset",
+    "monster",
+    "flag",
+    "other",
+};
+
+typedef struct {
+  int recording;
+  uint32_t counts[SideEffect_Count];
+
+  uint8_t gameFlags[SCRIPT_RUNNER_NUM_FLAGS];
+  uint16_t globalScriptVars[NUM_GLOBAL_SCRIPT_VARS];
+  uint16_t globalVars[SCRIPT_RUNNER_NUM_VARS];
+  int16_t credits;
+  uint32_t seed;
+  int numMonsters;
+  int numSteps;
+} ScriptRunner;
+
+static void record(EMCInterpreter *interp, SideEffect kind, const char *fmt,
+                   ...) __attribute__((format(printf, 3, 4)));
+static void record(EMCInterpreter *interp, SideEffect kind, const char *fmt,
+                   ...) {
+  ScriptRunner *runner = interp->callbackCtx;
+  runner->counts[kind]++;
+  if (!runner->recording) {
+    return;
+  }
+  printf("  %-8s ", sideEffectNames[kind]);
+  va_list args;
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  printf("\n");
+}
+
+#define RUNNER(interp) ((ScriptRunner *)(interp)->callbackCtx)
+
+static uint16_t rollDices(EMCInterpreter *interp, int16_t times,
+                          int16_t maxVal) {
+  // deterministic, so that the runs can be compared
+  ScriptRunner *runner = RUNNER(interp);
+  uint16_t ret = 0;
+  for (int i = 0; i < times; i++) {
+    runner->seed = runner->seed * 1103515245 + 12345;
+    ret += maxVal > 0 ? 1 + (runner->seed >> 16) % maxVal : 0;
+  }
+  return ret;
+}
+
+static uint16_t setGlobalVar(EMCInterpreter *interp, EMCGlobalVarID id,
+                             uint16_t a, uint16_t b) {
+  record(interp, SideEffect_Other, "setGlobalVar %i %X %X", id, a, b);
+  if (id < SCRIPT_RUNNER_NUM_VARS) {
+    RUNNER(interp)->globalVars[id] = b;
+  }
+  return 1;
+}
+
+static uint16_t getGlobalVar(EMCInterpreter *interp, EMCGlobalVarID id,
+                             uint16_t a) {
+  return id < SCRIPT_RUNNER_NUM_VARS ? RUNNER(interp)->globalVars[id] : 0;
+}
+
+static uint16_t getDirection(EMCInterpreter *interp) {
+  return RUNNER(interp)->globalVars[EMCGlobalVarID_CurrentDir];
+}
+
+static void playDialogue(EMCInterpreter *interp, int16_t charId, int16_t mode,
+                         uint16_t strId) {
+  record(interp, SideEffect_Other, "playDialogue char=%i mode=%i str=%X",
+         charId, mode, strId);
+}
+
+static void printMessage(EMCInterpreter *interp, uint16_t type, uint16_t strId,
+                         uint16_t soundId) {
+  record(interp, SideEffect_Other, "printMessage type=%i str=%X sound=%X",
+         type, strId, soundId);
+}
+
+static void loadLangFile(EMCInterpreter *interp, const char *file) {
+  record(interp, SideEffect_Asset, "lang '%s'", file);
+}
+
+static void loadCMZ(EMCInterpreter *interp, const char *file) {
+  record(interp, SideEffect_Asset, "cmz '%s'", file);
+}
+
+static void loadLevelShapes(EMCInterpreter *interp, const char *shpFile,
+                            const char *datFile) {
+  record(interp, SideEffect_Asset, "level shapes '%s' '%s'", shpFile, datFile);
+}
+
+static void clearDialogField(EMCInterpreter *interp) {}
+
+static void loadLevelGraphics(EMCInterpreter *interp, const char *file,
+                              const char *paletteFile) {
+  record(interp, SideEffect_Asset, "level graphics '%s' palette '%s'", file,
+         paletteFile ? paletteFile : "");
+}
+
+static void loadLevel(EMCInterpreter *interp, uint16_t levelNum,
+                      uint16_t startBlock, uint16_t startDir) {
+  record(interp, SideEffect_Asset, "level %i block=%X dir=%i", levelNum,
+         startBlock, startDir);
+}
+
+static uint16_t testGameFlag(EMCInterpreter *interp, uint16_t flag) {
+  if ((flag >> 3) >= SCRIPT_RUNNER_NUM_FLAGS) {
+    return 0;
+  }
+  return (RUNNER(interp)->gameFlags[flag >> 3] >> (flag & 7)) & 1;
+}
+
+static void setGameFlag(EMCInterpreter *interp, uint16_t flag, uint16_t set) {
+  record(interp, SideEffect_Flag, "%s %X", set ? "set" : "reset", flag);
+  if ((flag >> 3) >= SCRIPT_RUNNER_NUM_FLAGS) {
+    return;
+  }
+  if (set) {
+    RUNNER(interp)->gameFlags[flag >> 3] |= 1 << (flag & 7);
+  } else {
+    RUNNER(interp)->gameFlags[flag >> 3] &= ~(1 << (flag & 7));
+  }
+}
+
+static void loadBitmap(EMCInterpreter *interp, const char *file,
+                       uint16_t param) {
+  record(interp, SideEffect_Asset, "bitmap '%s' %X", file, param);
+}
+
+static void loadDoorShapes(EMCInterpreter *interp, const char *file,
+                           uint16_t p1, uint16_t p2, uint16_t p3,
+                           uint16_t p4) {
+  record(interp, SideEffect_Asset, "door shapes '%s'", file);
+}
+
+static void loadMonsterShapes(EMCInterpreter *interp, const char *file,
+                              uint16_t monsterId, uint16_t p2) {
+  record(interp, SideEffect_Asset, "monster shapes '%s' monster=%i", file,
+         monsterId);
+}
+
+static void loadMonster(EMCInterpreter *interp, uint16_t monsterIndex,
+                        uint16_t shapeIndex, uint16_t hitChance,
+                        uint16_t protection, uint16_t evadeChance,
+                        uint16_t speed, uint16_t p6, uint16_t p7,
+                        uint16_t p8) {
+  record(interp, SideEffect_Monster, "load monster %i shape=%i", monsterIndex,
+         shapeIndex);
+}
+
+static void loadTimScript(EMCInterpreter *interp, uint16_t scriptId,
+                          const char *file) {
+  record(interp, SideEffect_Asset, "tim %i '%s'", scriptId, file);
+}
+
+static void runTimScript(EMCInterpreter *interp, uint16_t scriptId,
+                         uint16_t loop) {
+  record(interp, SideEffect_Other, "run tim %i loop=%i", scriptId, loop);
+}
+
+static void releaseTimScript(EMCInterpreter *interp, uint16_t scriptId) {}
+
+static uint16_t getItemIndexInHand(EMCInterpreter *interp) { return 0; }
+
+static void allocItemProperties(EMCInterpreter *interp, uint16_t size) {}
+
+static void setItemProperty(EMCInterpreter *interp, uint16_t index,
+                            uint16_t stringId, uint16_t shapeId, uint16_t type,
+                            uint16_t scriptFun, uint16_t might, uint16_t skill,
+                            uint16_t protection, uint16_t flags) {}
+
+static uint16_t checkMonsterHostility(EMCInterpreter *interp,
+                                      uint16_t monsterType) {
+  return 1;
+}
+
+static uint16_t getItemParam(EMCInterpreter *interp, uint16_t itemId,
+                             EMCGetItemParam how) {
+  return 0;
+}
+
+static void disableControls(EMCInterpreter *interp, uint16_t mode) {}
+
+static void enableControls(EMCInterpreter *interp) {}
+
+static uint16_t getGlobalScriptVar(EMCInterpreter *interp, uint16_t index) {
+  assert(index < NUM_GLOBAL_SCRIPT_VARS);
+  return RUNNER(interp)->globalScriptVars[index];
+}
+
+static void setGlobalScriptVar(EMCInterpreter *interp, uint16_t index,
+                               uint16_t val) {
+  assert(index < NUM_GLOBAL_SCRIPT_VARS);
+  record(interp, SideEffect_Other, "setGlobalScriptVar %i %X", index, val);
+  RUNNER(interp)->globalScriptVars[index] = val;
+}
+
+static void WSAInit(EMCInterpreter *interp, uint16_t index, const char *wsaFile,
+                    int x, int y, int offscreen, int flags) {
+  record(interp, SideEffect_Asset, "wsa %i '%s'", index, wsaFile);
+}
+
+static void initSceneDialog(EMCInterpreter *interp, int controlMode) {}
+
+static void copyPage(EMCInterpreter *interp, uint16_t srcX, uint16_t srcY,
+                     uint16_t destX, uint16_t destY, uint16_t w, uint16_t h,
+                     uint16_t srcPage, uint16_t dstPage) {}
+
+static void drawExitButton(EMCInterpreter *interp, uint16_t p0, uint16_t p1) {}
+
+static void restoreAfterSceneDialog(EMCInterpreter *interp, int controlMode) {}
+
+static void restoreAfterSceneWindowDialog(EMCInterpreter *interp, int redraw) {
+}
+
+static uint16_t getWallType(EMCInterpreter *interp, uint16_t blockId,
+                            uint16_t wall) {
+  return 0;
+}
+
+static void setWallType(EMCInterpreter *interp, uint16_t blockId,
+                        uint16_t wall, uint16_t val) {
+  record(interp, SideEffect_Other, "setWallType block=%X wall=%i val=%X",
+         blockId, wall, val);
+}
+
+static uint16_t getWallFlags(EMCInterpreter *interp, uint16_t blockId,
+                             uint16_t wall) {
+  return 0;
+}
+
+static uint16_t checkRectForMousePointer(EMCInterpreter *interp, uint16_t xMin,
+                                         uint16_t yMin, uint16_t xMax,
+                                         uint16_t yMax) {
+  return 0;
+}
+
+static void setupDialogueButtons(EMCInterpreter *interp, uint16_t numStrs,
+                                 uint16_t strIds[3]) {}
+
+static uint16_t processDialog(EMCInterpreter *interp) {
+  // dialogs are over right away
+  return 1;
+}
+
+static void setupBackgroundAnimationPart(EMCInterpreter *interp,
+                                         uint16_t animIndex, uint16_t part,
+                                         uint16_t firstFrame,
+                                         uint16_t lastFrame, uint16_t cycles,
+                                         uint16_t nextPart, uint16_t partDelay,
+                                         uint16_t field, uint16_t sfxIndex,
+                                         uint16_t sfxFrame) {}
+
+static void deleteHandItem(EMCInterpreter *interp) {}
+
+static uint16_t createHandItem(EMCInterpreter *interp, uint16_t itemType,
+                               uint16_t p1, uint16_t p2) {
+  record(interp, SideEffect_Other, "createHandItem %X", itemType);
+  return 1;
+}
+
+static uint16_t createLevelItem(EMCInterpreter *interp, uint16_t itemType,
+                                uint16_t frame, uint16_t flags, uint16_t level,
+                                uint16_t block, uint16_t xOff, uint16_t yOff,
+                                uint16_t flyingHeight) {
+  record(interp, SideEffect_Other, "createLevelItem %X level=%i block=%X",
+         itemType, level, block);
+  return 1;
+}
+
+static void playAnimationPart(EMCInterpreter *interp, uint16_t animIndex,
+                              uint16_t firstFrame, uint16_t lastFrame,
+                              uint16_t delay) {}
+
+static uint16_t checkForCertainPartyMember(EMCInterpreter *interp,
+                                           uint16_t charId) {
+  return 0;
+}
+
+static void setNextFunc(EMCInterpreter *interp, uint16_t func) {
+  record(interp, SideEffect_Other, "setNextFunc %X", func);
+}
+
+static uint16_t getCredits(EMCInterpreter *interp) {
+  return RUNNER(interp)->credits;
+}
+
+static void creditsTransaction(EMCInterpreter *interp, int16_t amount) {
+  RUNNER(interp)->credits += amount;
+}
+
+static void moveMonster(EMCInterpreter *interp, uint16_t monsterId,
+                        uint16_t destBlock, uint16_t xOff, uint16_t yOff,
+                        uint16_t destDir) {
+  record(interp, SideEffect_Monster, "move monster %i block=%X", monsterId,
+         destBlock);
+}
+
+static void playSoundFX(EMCInterpreter *interp, uint16_t soundId) {}
+
+static void characterSurpriseSFX(EMCInterpreter *interp) {}
+
+static void moveParty(EMCInterpreter *interp, uint16_t how) {}
+
+static void fadeScene(EMCInterpreter *interp, uint16_t mode) {}
+
+static void prepareSpecialScene(EMCInterpreter *interp, uint16_t fieldType,
+                                uint16_t hasDialogue, uint16_t suspendGUI,
+                                uint16_t allowSceneUpdate,
+                                uint16_t controlMode, uint16_t fadeFlag) {}
+
+static void restoreAfterSpecialScene(EMCInterpreter *interp, uint16_t fadeFlag,
+                                     uint16_t redrawPlayField,
+                                     uint16_t releaseTimScripts,
+                                     uint16_t sceneUpdateMode) {}
+
+static int initMonster(EMCInterpreter *interp, uint16_t block, uint16_t xOff,
+                       uint16_t yOff, uint16_t facing, uint16_t monsterType,
+                       uint16_t flags, uint16_t monsterMode) {
+  record(interp, SideEffect_Monster, "init monster type=%i block=%X mode=%i",
+         monsterType, block, monsterMode);
+  return RUNNER(interp)->numMonsters++;
+}
+
+static uint16_t getMonsterStat(EMCInterpreter *interp, uint16_t monsterId,
+                               GetMonsterStatHow how) {
+  return 0;
+}
+
+static void printWindowText(EMCInterpreter *interp, uint16_t dim,
+                            uint16_t flags, uint16_t stringId) {}
+
+static void redrawPlayfield(EMCInterpreter *interp) {}
+
+static int triggerEventOnMouseButtonClick(EMCInterpreter *interp,
+                                          uint16_t event) {
+  return 0;
+}
+
+static int characterSays(EMCInterpreter *interp, int16_t trackId,
+                         uint16_t charId, int redraw) {
+  record(interp, SideEffect_Other, "characterSays track=%i char=%i", trackId,
+         charId);
+  return 1;
+}
+
+static int checkMagic(EMCInterpreter *interp, uint16_t charId,
+                      uint16_t spellNum, uint16_t spellLevel) {
+  return 0;
+}
+
+static void showHideMouse(EMCInterpreter *interp, int show) {}
+
+static void installCallbacks(EMCInterpreter *interp) {
+  EMCInterpreterCallbacks *cb = &interp->callbacks;
+  cb->EMCInterpreterCallbacks_RollDices = rollDices;
+  cb->EMCInterpreterCallbacks_SetGlobalVar = setGlobalVar;
+  cb->EMCInterpreterCallbacks_GetGlobalVar = getGlobalVar;
+  cb->EMCInterpreterCallbacks_GetDirection = getDirection;
+  cb->EMCInterpreterCallbacks_PlayDialogue = playDialogue;
+  cb->EMCInterpreterCallbacks_PrintMessage = printMessage;
+  cb->EMCInterpreterCallbacks_LoadLangFile = loadLangFile;
+  cb->EMCInterpreterCallbacks_LoadCMZ = loadCMZ;
+  cb->EMCInterpreterCallbacks_LoadLevelShapes = loadLevelShapes;
+  cb->EMCInterpreterCallbacks_ClearDialogField = clearDialogField;
+  cb->EMCInterpreterCallbacks_LoadLevelGraphics = loadLevelGraphics;
+  cb->EMCInterpreterCallbacks_LoadLevel = loadLevel;
+  cb->EMCInterpreterCallbacks_TestGameFlag = testGameFlag;
+  cb->EMCInterpreterCallbacks_SetGameFlag = setGameFlag;
+  cb->EMCInterpreterCallbacks_LoadBitmap = loadBitmap;
+  cb->EMCInterpreterCallbacks_LoadDoorShapes = loadDoorShapes;
+  cb->EMCInterpreterCallbacks_LoadMonsterShapes = loadMonsterShapes;
+  cb->EMCInterpreterCallbacks_LoadMonster = loadMonster;
+  cb->EMCInterpreterCallbacks_LoadTimScript = loadTimScript;
+  cb->EMCInterpreterCallbacks_RunTimScript = runTimScript;
+  cb->EMCInterpreterCallbacks_ReleaseTimScript = releaseTimScript;
+  cb->EMCInterpreterCallbacks_GetItemIndexInHand = getItemIndexInHand;
+  cb->EMCInterpreterCallbacks_AllocItemProperties = allocItemProperties;
+  cb->EMCInterpreterCallbacks_SetItemProperty = setItemProperty;
+  cb->EMCInterpreterCallbacks_CheckMonsterHostility = checkMonsterHostility;
+  cb->EMCInterpreterCallbacks_GetItemParam = getItemParam;
+  cb->EMCInterpreterCallbacks_DisableControls = disableControls;
+  cb->EMCInterpreterCallbacks_EnableControls = enableControls;
+  cb->EMCInterpreterCallbacks_GetGlobalScriptVar = getGlobalScriptVar;
+  cb->EMCInterpreterCallbacks_SetGlobalScriptVar = setGlobalScriptVar;
+  cb->EMCInterpreterCallbacks_WSAInit = WSAInit;
+  cb->EMCInterpreterCallbacks_InitSceneDialog = initSceneDialog;
+  cb->EMCInterpreterCallbacks_CopyPage = copyPage;
+  cb->EMCInterpreterCallbacks_DrawExitButton = drawExitButton;
+  cb->EMCInterpreterCallbacks_RestoreAfterSceneDialog =
+      restoreAfterSceneDialog;
+  cb->EMCInterpreterCallbacks_RestoreAfterSceneWindowDialog =
+      restoreAfterSceneWindowDialog;
+  cb->EMCInterpreterCallbacks_GetWallType = getWallType;
+  cb->EMCInterpreterCallbacks_SetWallType = setWallType;
+  cb->EMCInterpreterCallbacks_GetWallFlags = getWallFlags;
+  cb->EMCInterpreterCallbacks_CheckRectForMousePointer =
+      checkRectForMousePointer;
+  cb->EMCInterpreterCallbacks_SetupDialogueButtons = setupDialogueButtons;
+  cb->EMCInterpreterCallbacks_ProcessDialog = processDialog;
+  cb->EMCInterpreterCallbacks_SetupBackgroundAnimationPart =
+      setupBackgroundAnimationPart;
+  cb->EMCInterpreterCallbacks_DeleteHandItem = deleteHandItem;
+  cb->EMCInterpreterCallbacks_CreateHandItem = createHandItem;
+  cb->EMCInterpreterCallbacks_CreateLevelItem = createLevelItem;
+  cb->EMCInterpreterCallbacks_PlayAnimationPart = playAnimationPart;
+  cb->EMCInterpreterCallbacks_CheckForCertainPartyMember =
+      checkForCertainPartyMember;
+  cb->EMCInterpreterCallbacks_SetNextFunc = setNextFunc;
+  cb->EMCInterpreterCallbacks_GetCredits = getCredits;
+  cb->EMCInterpreterCallbacks_CreditsTransaction = creditsTransaction;
+  cb->EMCInterpreterCallbacks_MoveMonster = moveMonster;
+  cb->EMCInterpreterCallbacks_PlaySoundFX = playSoundFX;
+  cb->EMCInterpreterCallbacks_CharacterSurpriseSFX = characterSurpriseSFX;
+  cb->EMCInterpreterCallbacks_MoveParty = moveParty;
+  cb->EMCInterpreterCallbacks_FadeScene = fadeScene;
+  cb->EMCInterpreterCallbacks_PrepareSpecialScene = prepareSpecialScene;
+  cb->EMCInterpreterCallbacks_RestoreAfterSpecialScene =
+      restoreAfterSpecialScene;
+  cb->EMCInterpreterCallbacks_InitMonster = initMonster;
+  cb->EMCInterpreterCallbacks_GetMonsterStat = getMonsterStat;
+  cb->EMCInterpreterCallbacks_PrintWindowText = printWindowText;
+  cb->EMCInterpreterCallbacks_RedrawPlayfield = redrawPlayfield;
+  cb->EMCInterpreterCallbacks_TriggerEventOnMouseButtonClick =
+      triggerEventOnMouseButtonClick;
+  cb->EMCInterpreterCallbacks_CharacterSays = characterSays;
+  cb->EMCInterpreterCallbacks_CheckMagic = checkMagic;
+  cb->EMCInterpreterCallbacks_ShowHideMouse = showHideMouse;
+}
+
+static void runFunction(EMCInterpreter *interp, EMCState *state) {
+  ScriptRunner *runner = interp->callbackCtx;
+  while (EMCInterpreterIsValid(interp, state)) {
+    if (++runner->numSteps > SCRIPT_RUNNER_MAX_STEPS) {
+      printf("more than %i builtin calls, stopping\n", SCRIPT_RUNNER_MAX_STEPS);
+      state->ip = NULL;
+      return;
+    }
+    EMCInterpreterRun(interp, state);
+  }
+}
+
+static void runOnce(EMCInterpreter *interp, const INFScript *script,
+                    int function) {
+  ScriptRunner *runner = interp->callbackCtx;
+  int recording = runner->recording;
+  memset(runner, 0, sizeof(ScriptRunner));
+  runner->recording = recording;
+
+  EMCState state;
+  EMCStateInit(&state, script);
+  if (function >= 0) {
+    if (EMCStateStart(&state, function)) {
+      runFunction(interp, &state);
+    }
+    return;
+  }
+  for (int i = 0; i < INFScriptGetNumFunctions(script); i++) {
+    if (EMCStateStart(&state, i)) {
+      runFunction(interp, &state);
+    }
+  }
+}
+
+int ScriptRunnerRun(const INFScript *script, int function, int repeat) {
+  ScriptRunner runner = {0};
+  EMCInterpreter interp = {0};
+  installCallbacks(&interp);
+  interp.callbackCtx = &runner;
+
+  // the first run counts the instructions and shows what the script does
+  printf("side effects:\n");
+  int wasProfiling = EMCProfilerIsEnabled();
+  EMCProfilerReset();
+  EMCProfilerSetEnabled(1);
+  runner.recording = 1;
+  runOnce(&interp, script, function);
+  uint64_t numInstructions = EMCProfilerGetTotalInstructions();
+  for (int i = 0; i < SideEffect_Count; i++) {
+    printf("%u %s side effects\n", runner.counts[i], sideEffectNames[i]);
+  }
+  printf("%llu instructions, %i builtin calls per run\n",
+         (unsigned long long)numInstructions, runner.numSteps);
+  EMCProfilerSetEnabled(wasProfiling);
+
+  if (repeat <= 0) {
+    return 0;
+  }
+  runner.recording = 0;
+  uint64_t start = ProfilerNow();
+  for (int i = 0; i < repeat; i++) {
+    runOnce(&interp, script, function);
+  }
+  uint64_t elapsed = ProfilerNow() - start;
+  double seconds = elapsed / 1000000000.;
+  printf("%i runs in %.3f ms, %.3f us per run", repeat, elapsed / 1000000.,
+         elapsed / 1000. / repeat);
+  if (seconds > 0) {
+    printf(", %.2f M instructions/s", numInstructions * repeat / seconds / 1e6);
+  }
+  printf("\n");
+  return 0;
+}
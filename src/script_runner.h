@@ -0,0 +1,10 @@
+#pragma once
+#include "formats/format_inf.h"
+
+// Runs a script without a game context: the callbacks are stubs that keep
+// track of the game flags and variables and record the side effects (asset
+// loads, monsters, flags). function = -1 runs all the functions in order, like
+// a level INI script.
+// The first run is profiled and lists the side effects, the next 'repeat' runs
+// are timed.
+int ScriptRunnerRun(const INFScript *script, int function, int repeat);
@@ -0,0 +1,243 @@
+#include "tim_checker.h"
+#include "formats/format_tim.h"
+#include "game_envir.h"
+#include "profiler.h"
+#include "tim_interpreter.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIM_CHECKER_MAX_JOBS 64
+
+typedef struct {
+  const char *pakName;
+  char fileName[MAX_FILENAME];
+  const uint8_t *buffer;
+  size_t bufferSize;
+
+  int parsed;
+  size_t numInstructions;
+  size_t numExecuted; // per run
+  uint64_t parseNs;   // per run
+  uint64_t execNs;    // per run
+
+  // first instruction the interpreter can't run
+  const char *error;
+  uint32_t errorPos;
+  uint8_t errorCode;
+} TIMCheck;
+
+typedef struct {
+  TIMCheck *checks;
+  size_t numChecks;
+  size_t capacity;
+  int repeat;
+  atomic_size_t next;
+} TIMChecker;
+
+static void nullWSAInit(TIMInterpreter *interp, uint16_t index,
+                        const char *wsaFile, int x, int y, int offscreen,
+                        int flags) {}
+static void nullWSARelease(TIMInterpreter *interp, int index) {}
+static void nullWSADisplayFrame(TIMInterpreter *interp, int animIndex,
+                                int frame) {}
+static void nullPlayDialogue(TIMInterpreter *interp, uint16_t strId, int argc,
+                             const uint16_t *argv) {}
+static void nullCharChat(TIMInterpreter *interp, uint16_t charId,
+                         uint16_t mode, uint16_t stringId) {}
+static void nullShowDialogButtons(TIMInterpreter *interp, uint16_t functionId,
+                                  const uint16_t buttonStrIds[3]) {}
+static void nullSceneDialog(TIMInterpreter *interp, int controlMode) {}
+static void nullParam(TIMInterpreter *interp, uint16_t param) {}
+static uint16_t nullGiveItem(TIMInterpreter *interp, uint16_t param0,
+                             uint16_t param1, uint16_t param2) {
+  return 0;
+}
+static void nullCopyPage(TIMInterpreter *interp, uint16_t srcX, uint16_t srcY,
+                         uint16_t destX, uint16_t destY, uint16_t w, uint16_t h,
+                         uint16_t srcPage, uint16_t dstPage) {}
+static void nullNoParam(TIMInterpreter *interp) {}
+static void nullSetPartyPos(TIMInterpreter *interp, uint16_t how,
+                            uint16_t value) {}
+
+static const TIMInterpreterCallbacks nullCallbacks = {
+    .TIMInterpreterCallbacks_WSAInit = nullWSAInit,
+    .TIMInterpreterCallbacks_WSARelease = nullWSARelease,
+    .TIMInterpreterCallbacks_WSADisplayFrame = nullWSADisplayFrame,
+    .TIMInterpreterCallbacks_PlayDialogue = nullPlayDialogue,
+    .TIMInterpreterCallbacks_CharChat = nullCharChat,
+    .TIMInterpreterCallbacks_ShowDialogButtons = nullShowDialogButtons,
+    .TIMInterpreterCallbacks_InitSceneDialog = nullSceneDialog,
+    .TIMInterpreterCallbacks_RestoreAfterSceneDialog = nullSceneDialog,
+    .TIMInterpreterCallbacks_FadeClearWindow = nullParam,
+    .TIMInterpreterCallbacks_GiveItem = nullGiveItem,
+    .TIMInterpreterCallbacks_CopyPage = nullCopyPage,
+    .TIMInterpreterCallbacks_PlaySoundFX = nullParam,
+    .TIMInterpreterCallbacks_StopAllFunctions = nullNoParam,
+    .TIMInterpreterCallbacks_ClearTextField = nullNoParam,
+    .TIMInterpreterCallbacks_LoadSoundFile = nullParam,
+    .TIMInterpreterCallbacks_PlayMusicTrack = nullParam,
+    .TIMInterpreterCallbacks_Update = nullNoParam,
+    .TIMInterpreterCallbacks_SetPartyPos = nullSetPartyPos,
+};
+
+static void addFile(void *ctx, const char *pakName, const char *fileName,
+                    const GameFile *file) {
+  TIMChecker *checker = ctx;
+  if (checker->numChecks == checker->capacity) {
+    checker->capacity = checker->capacity ? checker->capacity * 2 : 64;
+    checker->checks =
+        realloc(checker->checks, checker->capacity * sizeof(TIMCheck));
+    if (!checker->checks) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  TIMCheck *check = checker->checks + checker->numChecks++;
+  memset(check, 0, sizeof(TIMCheck));
+  check->pakName = pakName;
+  snprintf(check->fileName, sizeof(check->fileName), "%s", fileName);
+  check->buffer = file->buffer;
+  check->bufferSize = file->bufferSize;
+}
+
+static int findError(TIMCheck *check, const TIMHandle *tim) {
+  for (size_t i = 0; i < tim->numEvents; i++) {
+    const TIMEvent *event = tim->events + i;
+    const char *error = TIMInterpreterCheckInstruction(tim, event);
+    if (error) {
+      check->error = error;
+      check->errorPos = event->pos;
+      check->errorCode = event->instrCode;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void runCheck(TIMCheck *check, int repeat) {
+  TIMHandle tim;
+  uint64_t start = ProfilerNow();
+  for (int i = 0; i < repeat; i++) {
+    TIMHandleInit(&tim);
+    check->parsed = TIMHandleFromBuffer(&tim, check->buffer, check->bufferSize);
+    if (!check->parsed || i + 1 < repeat) {
+      TIMHandleRelease(&tim);
+    }
+    if (!check->parsed) {
+      return;
+    }
+  }
+  check->parseNs = (ProfilerNow() - start) / repeat;
+  check->numInstructions = tim.numEvents;
+
+  // the interpreter asserts on the instructions it doesn't know
+  if (findError(check, &tim)) {
+    TIMHandleRelease(&tim);
+    return;
+  }
+
+  TIMInterpreter interp;
+  start = ProfilerNow();
+  for (int i = 0; i < repeat; i++) {
+    TIMInterpreterInit(&interp);
+    interp.callbacks = nullCallbacks;
+    interp.dontLoop = 1;
+    TIMInterpreterStart(&interp, &tim);
+    check->numExecuted = 0;
+    while (TIMInterpreterIsRunning(&interp)) {
+      TIMInterpreterUpdate(&interp);
+      check->numExecuted++;
+    }
+  }
+  check->execNs = (ProfilerNow() - start) / repeat;
+  TIMHandleRelease(&tim);
+}
+
+static void *workerMain(void *arg) {
+  TIMChecker *checker = arg;
+  for (;;) {
+    size_t index = atomic_fetch_add(&checker->next, 1);
+    if (index >= checker->numChecks) {
+      return NULL;
+    }
+    runCheck(checker->checks + index, checker->repeat);
+  }
+}
+
+static int report(const TIMChecker *checker, uint64_t elapsedNs) {
+  size_t numFailed = 0;
+  size_t numInstructions = 0;
+  uint64_t parseNs = 0;
+  uint64_t execNs = 0;
+  for (size_t i = 0; i < checker->numChecks; i++) {
+    const TIMCheck *check = checker->checks + i;
+    printf("%-12s %-12s ", check->pakName, check->fileName);
+    if (!check->parsed) {
+      printf("parse error\n");
+      numFailed++;
+      continue;
+    }
+    printf("%5zu instructions, parse %8.2f us", check->numInstructions,
+           check->parseNs / 1000.);
+    parseNs += check->parseNs;
+    if (check->error) {
+      printf(", 0X%04X code 0X%02X: %s\n", check->errorPos, check->errorCode,
+             check->error);
+      numFailed++;
+      continue;
+    }
+    printf(", run %8.2f us\n", check->execNs / 1000.);
+    execNs += check->execNs;
+    numInstructions += check->numExecuted;
+  }
+  printf("%zu TIM files, %zu failed\n", checker->numChecks, numFailed);
+  printf("parse %.3f ms, run %.3f ms per pass", parseNs / 1000000.,
+         execNs / 1000000.);
+  if (execNs) {
+    printf(", %.2f M instructions/s", numInstructions * 1000. / execNs);
+  }
+  printf("\n%i passes in %.3f ms\n", checker->repeat, elapsedNs / 1000000.);
+  return numFailed != 0;
+}
+
+int TIMCheckerRun(const char *dataDir, int numJobs, int repeat) {
+  if (numJobs < 1) {
+    numJobs = 1;
+  } else if (numJobs > TIM_CHECKER_MAX_JOBS) {
+    numJobs = TIM_CHECKER_MAX_JOBS;
+  }
+  if (repeat < 1) {
+    repeat = 1;
+  }
+  if (!GameEnvironmentInit(dataDir, Language_EN)) {
+    return 1;
+  }
+  TIMChecker checker = {.repeat = repeat};
+  atomic_init(&checker.next, 0);
+  // the PAK files are read here, the workers only get buffers
+  GameEnvironmentForEachFile("TIM", addFile, &checker);
+
+  pthread_t threads[TIM_CHECKER_MAX_JOBS];
+  int numThreads = 0;
+  uint64_t start = ProfilerNow();
+  for (; numThreads < numJobs; numThreads++) {
+    if (pthread_create(threads + numThreads, NULL, workerMain, &checker) !=
+        0) {
+      break;
+    }
+  }
+  if (numThreads == 0) {
+    workerMain(&checker);
+  }
+  for (int i = 0; i < numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  int ret = report(&checker, ProfilerNow() - start);
+
+  free(checker.checks);
+  GameEnvironmentRelease();
+  return ret;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Parses and runs all the TIM files of the game data on 'numJobs' threads, with
+// callbacks doing nothing. Reports for each file the parse and run times, the
+// number of instructions and the ones the interpreter can't run. The times are
+// averaged over 'repeat' runs.
+// Returns 1 if a file can't be parsed or run.
+int TIMCheckerRun(const char *dataDir, int numJobs, int repeat);
@@ -0,0 +1,92 @@
+#include "audio_mixer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OUT_RATE 22050
+#define MIX_FRAMES 1024
+
+static int numFailed = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #cond);          \
+      numFailed++;                                                             \
+    }                                                                          \
+  } while (0)
+
+// a VOC file with a single typed block of 'numSamples' U8 samples
+static uint8_t *makeVOC(uint32_t numSamples, uint8_t freqDivisor) {
+  const size_t headerSize = 26;
+  uint8_t *data = calloc(headerSize + 4 + 2 + numSamples + 1, 1);
+  memcpy(data, "Creative Voice File\x1a", 20);
+  data[20] = headerSize;
+  uint8_t *block = data + headerSize;
+  uint32_t blockSize = numSamples + 2;
+  block[0] = VOCBlockType_SoundDataTyped;
+  block[1] = blockSize & 0XFF;
+  block[2] = (blockSize >> 8) & 0XFF;
+  block[3] = (blockSize >> 16) & 0XFF;
+  block[4] = freqDivisor;
+  block[5] = 0; // PCM U8
+  for (uint32_t i = 0; i < numSamples; i++) {
+    block[6 + i] = 0X80 + (i % 2 ? 40 : -40);
+  }
+  return data; // the terminator block is already 0
+}
+
+static uint64_t mixToEnd(AudioChannel *channel, uint64_t maxFrames) {
+  int32_t acc[MIX_FRAMES * AUDIO_OUTPUT_CHANNELS];
+  uint64_t numFrames = 0;
+  while (AudioChannelIsPlaying(channel) && numFrames < maxFrames) {
+    memset(acc, 0, sizeof(acc));
+    numFrames += AudioChannelMix(channel, acc, MIX_FRAMES, 1 << 15, OUT_RATE);
+  }
+  return numFrames;
+}
+
+// blocks longer than 16 bits of samples must end
+static void testLongBlock(void) {
+  const uint32_t numSamples = 100000;
+  const uint8_t freqDivisor = 0XA5; // 10989Hz
+  uint8_t *data = makeVOC(numSamples, freqDivisor);
+  AudioChannel channel = {0};
+  AudioQueueInit(&channel.queue);
+  CHECK(VOCHandleFromBuffer(&channel.queue.vocHandles[0], data,
+                            26 + 4 + 2 + numSamples + 1));
+  AudioQueueReset(&channel.queue, 1);
+  channel.volume = 255;
+
+  uint32_t inRate = 1000000 / (256 - freqDivisor);
+  uint64_t expected = (uint64_t)numSamples * OUT_RATE / inRate;
+  uint64_t numFrames = mixToEnd(&channel, expected * 2);
+  CHECK(!AudioChannelIsPlaying(&channel));
+  CHECK(numFrames + 2 >= expected && numFrames <= expected + 2);
+  free(data);
+}
+
+static void testPCM(void) {
+  int16_t pcm[3000];
+  for (int i = 0; i < 3000; i++) {
+    pcm[i] = 1000;
+  }
+  AudioChannel channel = {0};
+  AudioQueueInit(&channel.queue);
+  channel.pcm = pcm;
+  channel.pcmFrames = 3000;
+  channel.volume = 255;
+  channel.pan = -AUDIO_MAX_PAN;
+  int32_t acc[MIX_FRAMES * AUDIO_OUTPUT_CHANNELS] = {0};
+  CHECK(AudioChannelMix(&channel, acc, MIX_FRAMES, 1 << 15, OUT_RATE) ==
+        MIX_FRAMES);
+  CHECK(acc[0] == 1000 && acc[1] == 0); // hard left
+  CHECK(mixToEnd(&channel, 10000) == 3000 - MIX_FRAMES);
+}
+
+int main(void) {
+  testLongBlock();
+  testPCM();
+  printf("audio_mixer_test: %s\n", numFailed ? "FAILED" : "ok");
+  return numFailed != 0;
+}
@@ -0,0 +1,171 @@
+#include "script.h"
+#include "script_compiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int numFailed = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #cond);          \
+      numFailed++;                                                             \
+    }                                                                          \
+  } while (0)
+
+static size_t writeBE16(uint8_t *dst, uint16_t v) {
+  dst[0] = v >> 8;
+  dst[1] = v & 0XFF;
+  return 2;
+}
+
+static size_t writeBE32(uint8_t *dst, uint32_t v) {
+  writeBE16(dst, v >> 16);
+  writeBE16(dst + 2, v & 0XFFFF);
+  return 4;
+}
+
+// an INF file with a single function at offset 0
+static size_t makeINF(uint8_t *buffer, const uint16_t *code, size_t numWords) {
+  size_t size = 0;
+  memcpy(buffer, "FORM", 4);
+  size += 4;
+  size += writeBE32(buffer + size, 0); // not read
+  memcpy(buffer + size, "EMC2ORDR", 8);
+  size += 8;
+  size += writeBE32(buffer + size, 2);
+  size += writeBE16(buffer + size, 0);
+  memcpy(buffer + size, "DATA", 4);
+  size += 4;
+  size += writeBE32(buffer + size, numWords * 2);
+  for (size_t i = 0; i < numWords; i++) {
+    size += writeBE16(buffer + size, code[i]);
+  }
+  return size;
+}
+
+static int load(INFScript *script, const uint16_t *code, size_t numWords) {
+  uint8_t buffer[256];
+  size_t size = makeINF(buffer, code, numWords);
+  INFScriptInit(script);
+  return INFScriptFromBuffer(script, buffer, size);
+}
+
+static char *compile(const uint16_t *code, size_t numWords) {
+  INFScript script;
+  if (!load(&script, code, numWords)) {
+    return NULL;
+  }
+  char *out = NULL;
+  size_t outSize = 0;
+  FILE *f = open_memstream(&out, &outSize);
+  int ok = EMCCompilerWriteC(&script, "TEST.INF", f);
+  fclose(f);
+  INFScriptRelease(&script);
+  if (!ok) {
+    free(out);
+    return NULL;
+  }
+  return out;
+}
+
+// the last instruction must not fall into the 'default' case, which runs the
+// function again from its entry
+static void testLastInstructionFallsThrough(void) {
+  const uint16_t code[] = {
+      0X4301, // PUSH 1
+      0X4302, // PUSH 2
+      0X4C02, // STACK_REWIND 2
+  };
+  char *out = compile(code, 3);
+  CHECK(out != NULL);
+  if (!out) {
+    return;
+  }
+  CHECK(strstr(out, "      s->sp += 2;\n"
+                    "      FALLBACK(0x0003);\n"
+                    "    default:\n") != NULL);
+  free(out);
+}
+
+// a 2 words instruction at the end
+static void testLastInstructionWithWordParam(void) {
+  const uint16_t code[] = {
+      0X2300, 0X1234, // PUSH 0x1234
+      0X4C01,         // STACK_REWIND 1
+      0X2300, 0X0001, // PUSH 1
+  };
+  char *out = compile(code, 5);
+  CHECK(out != NULL);
+  if (!out) {
+    return;
+  }
+  CHECK(strstr(out, "FALLBACK(0x0005);\n"
+                    "    default:\n") != NULL);
+  free(out);
+}
+
+// a loop without builtin calls must give the control back to the scheduler
+static void testInstructionBudget(void) {
+  const uint16_t code[] = {
+      0X4301, // PUSH 1
+      0X4C01, // STACK_REWIND 1
+      0X4000, // JUMP 0
+  };
+  INFScript script;
+  CHECK(load(&script, code, 3));
+  EMCInterpreter interp = {.instructionBudget = 10};
+  EMCState state;
+  EMCStateInit(&state, &script);
+  CHECK(EMCStateStart(&state, 0));
+  CHECK(EMCInterpreterRun(&interp, &state) == 1);
+  // the function starts after its first word, 10 instructions later: on the
+  // JUMP, then on the PUSH
+  CHECK(state.ip == script.scriptData + 2);
+  CHECK(EMCInterpreterRun(&interp, &state) == 1);
+  CHECK(state.ip == script.scriptData + 0);
+  INFScriptRelease(&script);
+
+  char *out = compile(code, 3);
+  CHECK(out != NULL);
+  if (!out) {
+    return;
+  }
+  CHECK(strstr(out, "  if (budget-- == 0) {\n"
+                    "          YIELD(0x0000);\n") != NULL);
+  free(out);
+}
+
+// a builtin call as the last instruction saves ip after it
+static void testSerializeIpAtEnd(void) {
+  const uint16_t code[] = {
+      0X4301, // PUSH 1
+      0X4C01, // STACK_REWIND 1
+  };
+  INFScript script;
+  CHECK(load(&script, code, 2));
+  EMCState state;
+  EMCStateInit(&state, &script);
+  state.ip = script.scriptData + 2;
+  uint8_t buffer[EMC_STATE_SERIALIZED_MAX_SIZE];
+  size_t size = EMCStateSerialize(&state, buffer, sizeof(buffer));
+  CHECK(size > 0);
+  EMCState restored;
+  CHECK(EMCStateDeserialize(&restored, &script, buffer, size));
+  CHECK(restored.ip == script.scriptData + 2);
+  INFScriptRelease(&script);
+}
+
+int main(void) {
+  testLastInstructionFallsThrough();
+  testLastInstructionWithWordParam();
+  testInstructionBudget();
+  testSerializeIpAtEnd();
+  if (numFailed) {
+    printf("script_compiler_test: %i checks failed\n", numFailed);
+    return 1;
+  }
+  printf("script_compiler_test: ok\n");
+  return 0;
+}
@@ -19,6 +19,9 @@ class DBGMsgType(IntEnum):
     SetLoggerResponse = 13
     SetVarRequest = 14
     SetVarResponse = 15
+    LogMessage = 16
+    EMCProfileRequest = 17
+    EMCProfileResponse = 18
 
 
 msg_header_struct = "@BI"